@@ -27,9 +27,16 @@
 //	ILI9341 Driver library for STM32
 //-----------------------------------
 //
-//	While there are other libraries for ILI9341 they mostly require either interrupts, DMA or both for fast drawing
-//	The intent of this library is to offer a simple yet still reasonably fast alternatives for those that
-//	do not wish to use interrupts or DMA in their projects.
+//	Register writes are blocking HAL_SPI_Transmit calls, but pixel data goes out through SPI1 TX DMA
+//	(DMA1 channel 1) from two ping-pong line buffers that HAL_SPI_TxCpltCallback refills, so
+//	ILI9341_Draw_Colour_Burst, ILI9341_Burst_Stream and ILI9341_Burst_Direct return while the burst
+//	is still in flight. The DMA interrupt has to be enabled for a burst to finish.
+//
+//	Every drawing and command call waits for the previous burst first. Anything else that touches
+//	the SPI bus, CS/DC or a buffer handed to ILI9341_Burst_Direct, ILI9341_SPI_Send included, calls
+//	ILI9341_Burst_Wait() before it does; ILI9341_Burst_Busy() tells whether a burst is running
+//	without blocking. While ILI9341_Framebuffer_Enable(true) is set, drawing lands in RAM instead and
+//	only ILI9341_Flush() sends it.
 //
 //	Library is written for STM32 HAL library and supports STM32CUBEMX. To use the library with Cube software
 //	you need to tick the box that generates peripheral initialization code in their own respective .c and .h file
@@ -75,6 +82,7 @@
 //	-define your CS, DC and RST outputs in ILI9341_STM32_Driver.h
 //	-check if ILI9341_SCREEN_HEIGHT and ILI9341_SCREEN_WIDTH match your LCD size
 //			++Library was written and tested for 320x240 screen size. Other sizes might have issues**
+//	-enable SPI TX DMA (DMA1 channel 1 here) and its interrupt, HAL_SPI_TxCpltCallback is defined by this library
 //	-in your main program initialize LCD with ILI9341_Init();
 //	-library is now ready to be used. Driver library has only basic functions, for more advanced functions see ILI9341_GFX library
 //
@@ -99,6 +107,10 @@
 #define LCD_HEIGHT_1 320
 #define LCD_WIDTH_1	240
 #define BURST_MAX_SIZE 	500
+#define ILI9341_LINE_BUFFER_SIZE	(320*2)	//one RGB565 line per DMA ping-pong buffer
+#define ILI9341_MAX_DIRTY	8	//dirty rects tracked by the framebuffer before they get merged
+#define ILI9341_TEXT_RUN_MAX	64	//longest string drawn as a single text run
+#define RENDER_BUDGET_MS	2	//time Render_Task may spend per main loop pass
 #define LCD_BACKLIGHT_PORT GPIOB
 #define LCD_BACKLIGHT_PIN GPIO_PIN_10
 
@@ -135,6 +147,26 @@
 #define SCREEN_VERTICAL_2			2
 #define SCREEN_HORIZONTAL_2		3
 
+//Produces the next Length bytes of a DMA burst into Buffer, may run in interrupt context
+typedef void (*ILI9341_Fill_Callback)(uint8_t *Buffer, uint32_t Length, void *Context);
+
+//Packed RGB565 image, produced by tools/rgb565_pack.py
+typedef struct {
+	uint16_t width;
+	uint16_t height;
+	uint32_t size;			//bytes in data
+	const uint8_t *data;
+} ILI9341_Packed_Image;
+
+//Panel traffic counters, see ILI9341_Get_Stats
+typedef struct {
+	uint32_t transactions;	//blocking and DMA SPI transfers
+	uint32_t cs_frames;		//CS assertions
+	uint32_t bytes;
+	uint32_t caset_skipped;	//windows that reused the column range already on the panel
+	uint32_t paset_skipped;	//windows that reused the row range
+} ILI9341_Stats;
+
 void ILI9341_SPI_Init(void);
 
 void ILI9341_SPI_Send(unsigned char SPI_Data);
@@ -153,6 +185,16 @@ void ILI9341_Enable(void);
 void ILI9341_Init(void);
 void ILI9341_Fill_Screen(uint16_t Colour);
 void ILI9341_Draw_Colour(uint16_t Colour);
+void ILI9341_Draw_Colour_Burst(uint16_t Colour, uint32_t Size);
+void ILI9341_Burst_Stream(ILI9341_Fill_Callback Fill, void *Context, uint32_t Size);
+void ILI9341_Burst_Direct(const uint8_t *Data, uint32_t Row_Bytes, uint32_t Stride, uint32_t Rows);
+bool ILI9341_Burst_Busy(void);
+void ILI9341_Burst_Wait(void);
+void ILI9341_Framebuffer_Enable(bool enable);
+bool ILI9341_Framebuffer_Enabled(void);
+void ILI9341_Flush(void);
+const ILI9341_Stats *ILI9341_Get_Stats(void);
+void ILI9341_Clear_Stats(void);
 void ILI9341_Draw_Pixel(uint16_t X,uint16_t Y,uint16_t Colour);
 
 void ILI9341_Draw_Rectangle(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t Colour);
@@ -166,13 +208,18 @@ void ILI9341_Draw_FilledRectangleCoord(uint16_t X0, uint16_t Y0, uint16_t X1, ui
 void ILI9341_Draw_Char(char ch, const uint8_t font[], uint16_t X, uint16_t Y, uint16_t color, uint16_t bgcolor);
 void ILI9341_Draw_Text(const char* str, const uint8_t font[], uint16_t X, uint16_t Y, uint16_t color, uint16_t bgcolor);
 void ILI9341_Draw_Image(const char* Image_Array, uint8_t Orientation);
+void ILI9341_Draw_Packed_Image(const ILI9341_Packed_Image *Image, uint16_t X, uint16_t Y);
+void ILI9341_Draw_Image_Rect(const uint8_t *Image, uint16_t Image_Width, uint16_t Src_X, uint16_t Src_Y, uint16_t Width, uint16_t Height, uint16_t X, uint16_t Y);
 int get_text_width(const char* str, const uint8_t font[]);
 int get_text_height(const uint8_t font[]);
 void ILI9341_Draw_RingSector(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius, float angle_deg, uint16_t color);
 void ILI9341_Draw_FilledCircle_Sector(uint16_t X, uint16_t Y, uint16_t radius, float angle_deg, uint16_t color);
 void ILI9341_Draw_Lock(uint16_t X, uint16_t Y, uint16_t Size, uint16_t Colour,bool locked);
 void ILI9341_Draw_RingSector_v2(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius, float start_angle_deg, float end_angle_deg, uint16_t color);
+void ILI9341_Draw_Arc(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius, float start_angle_deg, float end_angle_deg, uint16_t color);
 void ILI9341_DisplayPower(bool on);
 void UEA_Timer_Update();
 void Ring_Update();
+void Render_Task(uint32_t budget_ms);
+bool Render_Pending(void);
 #endif
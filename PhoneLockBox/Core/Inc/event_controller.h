@@ -5,6 +5,7 @@
  *      Author: colinriker
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "shared.h"
@@ -13,13 +14,17 @@
 #ifndef INC_EVENT_CONTROLLER_H_
 #define INC_EVENT_CONTROLLER_H_
 
-#define MAX_EVENT_COUNT 16 /* MUST BE LESS THAN 256 */
+#ifndef MAX_EVENT_COUNT
+#define MAX_EVENT_COUNT 16 /* MUST BE LESS THAN 255 */
+#endif
 #define MAX_TIME 0xFFFFFFFF
+#define EVENT_IDLE_MAX_MS 500 /* longest tickless sleep, must fit TIM3 at 16 bits */
+#define EVENT_SIGNAL_RING 16  /* ISR signal slots, power of two up to 128 */
+#define EVENT_CATCHUP_MAX 4   /* periods an EVENT_PERIODIC_CATCHUP event may fall behind before it skips */
 
 typedef enum {
 	EVENT_SUCCESS,
-	EVENT_LABEL_NOT_FOUND,
-	EVENT_LABEL_ALREADY_USED,
+	EVENT_HANDLE_NOT_FOUND,
 	EVENT_INIT_FAILED,
 	EVENT_QUEUE_FULL,
 	EVENT_GENERIC_ERROR //Lowk evil to have this but I am lazy
@@ -35,6 +40,7 @@ typedef enum {
 	EVENT_TIMER,
 	EVENT_ACCELEROMETER,
 	EVENT_MAGNOMETER,
+	EVENT_LABEL_COUNT
 } EventLabel;
 
 typedef enum {
@@ -44,37 +50,162 @@ typedef enum {
 	EVENT_DELTA,
 	EVENT_DELTA_IMMEDIATE,
 	EVENT_N_REPEAT,
-	EVENT_N_REPEAT_IMMEDIATE
+	EVENT_N_REPEAT_IMMEDIATE,
+	EVENT_PERIODIC,
+	EVENT_PERIODIC_CATCHUP
 } EventFlag;
 
-/* EVENT STRUCT INFO
- * Context Field:
- * N_REPEAT, 	[15:8] Times to repeat
- * 			 	[7:0]  Delta
- * DELTA, 		[15:0] Delta
+/* Dispatch classes, a due event in a higher class always runs first */
+typedef enum {
+	EVENT_PRIORITY_HIGH,
+	EVENT_PRIORITY_NORMAL,
+	EVENT_PRIORITY_LOW,
+	EVENT_PRIORITY_COUNT
+} EventPriority;
+
+/* Interrupt sources that post to the signal ring */
+typedef enum {
+	EVENT_SIGNAL_AUDIO,         /* KY-037 D0 edge, arg is the state at the edge */
+	EVENT_SIGNAL_ROTENC_SWITCH  /* rotary encoder push button */
+} EventSignalSource;
+
+typedef struct {
+	uint8_t source;    /* EventSignalSource */
+	uint8_t arg;
+	uint32_t time_ms;  /* time_ms when the interrupt fired */
+} EventSignal;
+
+/* COROUTINE INFO
+ * A coroutine is an event callback whose body sits between CO_BEGIN and
+ * CO_END. CO_YIELD_MS and the CO_WAIT_UNTIL forms hand control back to
+ * eventRunner and put the event back on the schedule; its next run picks
+ * up after the yield instead of at the top. The body is re-entered
+ * through a switch on the saved line, so:
+ *	- locals don't survive a yield, keep them in static storage next to
+ *	  the Coroutine
+ *	- only one CO_ macro per source line
+ *	- no yielding from inside a switch of the body's own
+ * Removing the event (eventCancel, eventClear on a state change) rewinds
+ * the coroutine, so the next registration starts from the top. Reaching
+ * CO_END reschedules the event by its flag as usual: an EVENT_DELTA
+ * coroutine reruns its sequence every delta, a single one is removed.
+ * */
+typedef struct {
+	uint16_t line;     /* resume point, 0 starts from the top */
+	uint32_t deadline; /* time_ms the current timed wait gives up at */
+} Coroutine;
+
+#define CO_BEGIN(co) eventBindCoroutine(co); switch ((co)->line) { case 0:
+#define CO_END(co) } (co)->line = 0; return
+
+/* Finish the sequence early, the next run starts from the top */
+#define CO_EXIT(co) do { (co)->line = 0; return; } while (0)
+
+/* Resume no sooner than ms from now, 0 lets the rest of the loop run first */
+#define CO_YIELD_MS(co, ms) \
+	do { (co)->line = __LINE__; eventYield(ms); return; case __LINE__:; } while (0)
+
+/* Test cond every poll_ms until it holds */
+#define CO_WAIT_UNTIL(co, cond, poll_ms) \
+	do { (co)->line = __LINE__; case __LINE__: \
+		if (!(cond)) { eventYield(poll_ms); return; } } while (0)
+
+/* As CO_WAIT_UNTIL, giving up after timeout_ms. Test cond again afterwards
+ * to tell success from a timeout.
+ */
+#define CO_WAIT_UNTIL_TIMEOUT(co, cond, poll_ms, timeout_ms) \
+	do { (co)->deadline = time_ms + (timeout_ms); (co)->line = __LINE__; case __LINE__: \
+		if (!(cond) && (int32_t)(time_ms - (co)->deadline) < 0) { eventYield(poll_ms); return; } } while (0)
+
+/* EVENT JITTER INFO
+ * How late each activation started against its deadline, in us, and
+ * how many periods a periodic event has dropped after an overrun.
+ * Kept for every event, a coroutine's resumptions don't count
  * */
 typedef struct {
-	void (*callback) (void);
-	EventLabel label;
-	EventFlag flag;
-	uint32_t schedule_time;
-	uint16_t context;
-} Event;
-
-uint16_t eventContextFormat();
-EventReturnCode eventRegister(void *callback, EventLabel label, EventFlag flag, uint16_t delta, uint8_t n_runs);
+	uint32_t runs;
+	uint32_t max_late_us;
+	uint64_t total_late_us;
+	uint32_t skipped;
+} EventJitter;
+
+/* EVENT HANDLE INFO
+ * Returned by eventRegister, names one registration for eventCancel and
+ * eventReschedule. Treat it as opaque; once the event is removed the
+ * handle no longer matches anything, even after its slot is reused.
+ *
+ * Period and repeat arguments:
+ * SINGLE,		delay before the run
+ * DELTA, 		delta between the end of a run and the next
+ * N_REPEAT,	delta, and n_runs runs in total
+ * PERIODIC,	period
+ *
+ * DELTA counts its delta from when the callback returned, so it drifts
+ * by the callback's run time. PERIODIC counts from the deadline the run
+ * was released for and keeps its phase: after an overrun it skips the
+ * periods it missed, PERIODIC_CATCHUP runs them back to back unless it
+ * is more than EVENT_CATCHUP_MAX behind.
+ * */
+typedef uint16_t EventHandle;
+#define EVENT_HANDLE_NONE 0
+
+extern uint32_t time_ms;
+
+EventHandle eventRegister(void *callback, EventLabel label, EventFlag flag, uint32_t delta, uint32_t n_runs);
+EventHandle eventRegisterPriority(void *callback, EventLabel label, EventFlag flag, uint32_t delta, uint32_t n_runs, EventPriority priority);
+EventReturnCode eventCancel(EventHandle handle);
+EventReturnCode eventReschedule(EventHandle handle, uint32_t delay_ms);
+bool eventValid(EventHandle handle);
+bool eventNextDeadline(uint32_t *next);
+EventHandle eventCurrent(void);
+EventLabel eventCurrentLabel(void);
 void eventClear();
 EventReturnCode eventControllerInit(void);
-EventReturnCode eventSchedule(uint8_t idx);
+
+void eventYield(uint32_t delay_ms);
+void eventBindCoroutine(Coroutine *co);
+
+const EventJitter* eventJitterGet(EventLabel label);
+void eventJitterReset(void);
+
+bool eventSignalPost(EventSignalSource source, uint8_t arg);
+bool eventSignalPop(EventSignal *out);
+uint32_t eventSignalDropped(void);
 
 void eventRunner(void);
+void eventTick(void);
+void eventIdle(uint32_t max_ms, bool (*pending)(void));
 void eventDefaultCallback(void);
 void eventTimerCallback(void);
 
+#ifdef PROFILE_EVENTS
+#define EVENT_PROFILE_BUCKETS 32 /* log2 cycle buckets, bucket n holds [2^(n-1), 2^n) */
+
+/* EVENT PROFILE INFO
+ * Per label callback cost in core cycles and how late each run
+ * started relative to its schedule_time
+ * */
+typedef struct {
+	uint32_t runs;
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+	uint32_t max_late_ms;
+	uint64_t total_late_ms;
+	uint32_t histogram[EVENT_PROFILE_BUCKETS];
+} EventProfile;
+
+const EventProfile* eventProfileGet(EventLabel label);
+void eventProfileReset(void);
+void eventProfileDump(void);
+#endif
+
+#if defined(DEBUG_EVENT_CONTROLLER) || defined(PROFILE_EVENTS)
+const char* EventLabelToStr(EventLabel label);
+#endif
+
 #ifdef DEBUG_EVENT_CONTROLLER
-void eventPrint(Event *event);
 const char* EventReturnCodeToStr(EventReturnCode code);
-const char* EventLabelToStr(EventLabel label);
 const char* EventFlagToStr(EventFlag flag);
 #endif
 
@@ -0,0 +1,62 @@
+/*
+ * input_log.h
+ *
+ *	Recording of the raw inputs the state machine reacts to, built with
+ *	RECORD_INPUTS, so a session from the field can be replayed on the
+ *	host through tools/sim --replay.
+ */
+
+#ifndef INC_INPUT_LOG_H_
+#define INC_INPUT_LOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "shared.h"
+#include "event_controller.h"
+
+#define INPUT_LOG_BLOCK 256    /* bytes per block, a keyframe and the records after it */
+#define INPUT_LOG_BLOCKS 128   /* blocks kept, the oldest is dropped for a new one */
+#define INPUT_LOG_KEYFRAME 24  /* bytes of block header */
+#define INPUT_LOG_DUMP_CMD 'I' /* LPUART byte that asks for a dump, see tracePoll */
+#define INPUT_LOG_VERSION 1
+
+#define INPUT_KEY_LOCK_TIMER 0x01  /* keyframe flags: the lock timer interrupt is armed */
+
+/* INPUT LOG INFO
+ * The log is a ring of fixed blocks so a dump can start decoding at any
+ * block. Each block opens with a keyframe, little-endian:
+ *
+ *	time_ms:u32 lock_ms:u32 state:u8 flags:u8 dial:u16 acc:i16[3] mag:i16[3]
+ *
+ * holding time_ms, lockTimerGetTime(), the BoxState, INPUT_KEY_* flags
+ * and the last dial count, accelerometer and magnetometer samples as the
+ * block starts.
+ * Records follow, one byte of kind << 5 | dt, then the payload. dt is
+ * ms since the record before (or the keyframe), 31 means a varint dt
+ * follows. Payloads are zigzag varints of the change from the last value
+ * of the same kind: three for a sample, one for the dial. A sample equal
+ * to the one before is left out, it reads the same on replay. A 0 byte or
+ * the end of the block ends it. tools/sim reads this layout, bump
+ * INPUT_LOG_VERSION when it changes.
+ * */
+typedef enum {
+	INPUT_NONE,         /* ends a block */
+	INPUT_ACC,          /* accelerometer sample */
+	INPUT_MAG,          /* magnetometer sample */
+	INPUT_PHONE_OUT,    /* NFC found no phone */
+	INPUT_PHONE_IN,     /* NFC found a phone */
+	INPUT_DIAL,         /* TIM1 encoder count changed */
+	INPUT_EDGE_AUDIO,   /* KY-037 D0 edge on EXTI0 */
+	INPUT_EDGE_BUTTON   /* rotary encoder push on EXTI10 */
+} InputKind;
+
+#ifdef RECORD_INPUTS
+void inputLogSample(InputKind kind, const Vector3D *sample);
+void inputLogPhone(bool present);
+void inputLogDial(uint16_t count);
+void inputLogEdge(EventSignalSource source, uint32_t at_ms);
+void inputLogDump(void);
+#endif
+
+#endif /* INC_INPUT_LOG_H_ */
@@ -11,14 +11,12 @@
 #include <stdbool.h>
 #include "pn532.h"
 
-#define MAX_POLL 100
+#define NFC_POLL_MS 10      /* ready byte poll period while an exchange is pending */
+#define NFC_TIMEOUT_MS 1000 /* longest wait for the ACK or the target list */
 
 void nfcInit(void);
 bool nfcHasTarget(void);
 
 void nfcEventCallbackSlow(void);
-void nfcEventCallbackStart(void);
-void nfcEventCallbackPoll(void);
-void nfcEventCallbackRead(void);
 
 #endif /* INC_NFC_H_ */
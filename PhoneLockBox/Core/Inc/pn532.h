@@ -191,6 +191,7 @@ void PN532_Log(const char* log);
 // Comm Functions
 int PN532_I2C_ReadData(uint8_t* data, uint16_t count);
 int PN532_I2C_WriteData(uint8_t *data, uint16_t count);
+bool PN532_I2C_IsReady(void);
 bool PN532_I2C_WaitReady(uint32_t timeout);
 int PN532_I2C_Wakeup(void);
 void PN532_I2C_Init(PN532* dev);
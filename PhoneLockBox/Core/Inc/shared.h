@@ -11,6 +11,8 @@
 
 #define I2C_TIMEOUT 1000
 //#define DEBUG_OUT //Comment out to not compile debug functions and statement
+//#define PROFILE_EVENTS //Uncomment to time every event callback with the DWT cycle counter
+//#define RECORD_INPUTS //Uncomment to log raw sensor and button input for replay in tools/sim, see input_log.h
 
 #ifdef DEBUG_OUT
 #define DEBUG_EVENT_CONTROLLER
@@ -25,23 +27,51 @@
 #include <string.h>
 #include <stdint.h>
 
+/* Box States
+ *	Every state is listed once here with its display name, the BoxState
+ *	enum and stateToStr are both expanded from the list so they can't
+ *	disagree. state_machine.c builds its state table from the same list.
+ */
+#define BOX_STATES(X) \
+	X(UNLOCKED_EMPTY_ASLEEP, "Unlocked Empty Asleep") \
+	X(UNLOCKED_ASLEEP_TO_AWAKE, "Unlocked Asleep to Awake") \
+	X(UNLOCKED_EMPTY_AWAKE, "Unlocked Empty Awake") \
+	X(UNLOCKED_FULL_AWAKE_FUNC_A, "Unlocked Full Awake Function A") \
+	X(UNLOCKED_FULL_AWAKE_FUNC_B, "Unlocked Full Awake Function B") \
+	X(UNLOCKED_FULL_ASLEEP, "Unlocked Full Asleep") \
+	X(UNLOCKED_TO_LOCKED_AWAKE, "Unlocked to Locked Awake") \
+	X(LOCKED_FULL_AWAKE, "Locked Full Awake") \
+	X(LOCKED_FULL_ASLEEP, "Locked Full Asleep") \
+	X(LOCKED_MONITOR_AWAKE, "Locked Monitor Awake") \
+	X(LOCKED_MONITOR_ASLEEP, "Locked Monitor Asleep") \
+	X(LOCKED_FULL_NOTIFICATION_FUNC_A, "Locked Full Notification Function A") \
+	X(LOCKED_FULL_NOTIFICATION_FUNC_B, "Locked Full Notification Function B") \
+	X(EMERGENCY_OPEN, "Emergency Open")
+
+#define BOX_STATE_ENUM(id, name) id,
+#define BOX_STATE_NAME(id, name) [id] = name,
+
 enum {
-	UNLOCKED_EMPTY_ASLEEP,
-	UNLOCKED_ASLEEP_TO_AWAKE,
-	UNLOCKED_EMPTY_AWAKE,
-	UNLOCKED_FULL_AWAKE_FUNC_A,
-	UNLOCKED_FULL_AWAKE_FUNC_B,
-	UNLOCKED_FULL_ASLEEP,
-	UNLOCKED_TO_LOCKED_AWAKE,
-	LOCKED_FULL_AWAKE,
-	LOCKED_FULL_ASLEEP,
-	LOCKED_MONITOR_AWAKE,
-	LOCKED_MONITOR_ASLEEP,
-	LOCKED_FULL_NOTIFICATION_FUNC_A,
-	LOCKED_FULL_NOTIFICATION_FUNC_B,
-	EMERGENCY_OPEN
+	BOX_STATES(BOX_STATE_ENUM)
+	BOX_STATE_COUNT
 } typedef BoxState;
 
+// screens the display can show, each state names one in its table entry
+enum {
+	SCREEN_ASLEEP,
+	SCREEN_POWERING_ON,
+	SCREEN_EMPTY_AWAKE,
+	SCREEN_FULL_AWAKE_A,
+	SCREEN_FULL_AWAKE_B,
+	SCREEN_LOCKING,
+	SCREEN_LOCKED_AWAKE,
+	SCREEN_MONITOR_AWAKE,
+	SCREEN_NOTIFICATION_A,
+	SCREEN_NOTIFICATION_B,
+	SCREEN_EMERGENCY_OPEN,
+	SCREEN_COUNT
+} typedef ScreenId;
+
 
 typedef struct {
 	BoxState mode;
@@ -67,38 +97,10 @@ static inline uint16_t VectorDelta(Vector3D *vec, Vector3D *prev_vec){
 
 
 static inline const char* stateToStr(BoxState boxstate) {
+	static const char *const names[BOX_STATE_COUNT] = { BOX_STATES(BOX_STATE_NAME) };
 
-	switch (boxstate) {
-	case UNLOCKED_EMPTY_ASLEEP: return "Unlocked Empty Asleep";
-
-	case UNLOCKED_ASLEEP_TO_AWAKE: return "Unlocked Asleep to Awake";
-
-	case UNLOCKED_EMPTY_AWAKE: return "Unlocked Empty Awake";
-
-	case UNLOCKED_FULL_AWAKE_FUNC_A: return "Unlocked Full Awake Function A";
-
-	case UNLOCKED_FULL_AWAKE_FUNC_B: return "Unlocked Full Awake Function B";
-
-	case UNLOCKED_FULL_ASLEEP: return "Unlocked Full Asleep";
-
-	case UNLOCKED_TO_LOCKED_AWAKE: return "Unlocked to Locked Awake";
-
-	case LOCKED_FULL_AWAKE: return "Locked Full Awake";
-
-	case LOCKED_FULL_ASLEEP: return "Locked Full Asleep";
-
-	case LOCKED_MONITOR_AWAKE: return "Locked Monitor Awake";
-
-	case LOCKED_MONITOR_ASLEEP: return "Locked Monitor Asleep";
-
-	case LOCKED_FULL_NOTIFICATION_FUNC_A: return "Locked Full Notification Function A";
-
-	case LOCKED_FULL_NOTIFICATION_FUNC_B: return "Locked Full Notification Function B";
-
-	case EMERGENCY_OPEN: return "Emergency Open";
-
-	default: return "[ERROR] Undefined State";
-	}
+	if (boxstate >= BOX_STATE_COUNT) return "[ERROR] Undefined State";
+	return names[boxstate];
 }
 
 #endif /* INC_SHARED_H_ */
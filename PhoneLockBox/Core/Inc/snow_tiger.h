@@ -1,4 +1,15 @@
-#include "stm32f7xx_hal.h"
+/*
+ * snow_tiger.h
+ *
+ *  320x240 raw RGB565 test image, big-endian (panel byte order).
+ *  Draw with ILI9341_Draw_Image or ILI9341_Draw_Image_Rect; new art should
+ *  go through tools/rgb565_pack.py instead.
+ */
+
+#ifndef INC_SNOW_TIGER_H_
+#define INC_SNOW_TIGER_H_
+
+#include <stdint.h>
 
 const uint8_t snow_tiger[320*240*2] = {0x10,0xc4,0x18,0xc4,0x08,0x83,0x08,0x83,0x21,0x46,0x3a,0x09,0x29,0x67,0x00,0x22,0x00,0x83,0x00,0x83,0x08,0xa4,0x19,0x05,0x19,0x47,0x21,0x88,0x31,0xea,0x42,0x4b,0x3a,0x09,0x39,0xe8,0x19,0x04,0x00,0x41,0x08,0x62,0x10,0xa3,0x08,0x82,0x10,0xa3,0x08,0x62,0x08,0x62,0x18,0xa3,0x08,0x42,0x10,0xa3,0x10,0x62,0x10,0xa3,0x08,0x62,0x10,0x83,0x10,0xa3,0x08,0x42,0x08,0x62,0x10,0x83,0x29,0x66,0x21,0x25,0x10,0xc4,0x00,0x63,0x10,0xe5,0x08,0xa3,0x00,0x62,0x10,0xc4,0x00,0x83,0x00,0x42,0x10,0xe5,0x19,0x06,0x21,0x67,0x21,0x47,0x19,0x05,0x10,0xc4,0x10,0xa3,0x18,0xe4,0x29,0x66,0x29,0x25,0x10,0x83,0x08,0x83,0x08,0xa4,0x29,0xa8,0x29,0xc9,0x00,0xa4,0x00,0xc5,0x00,0xe6,0x00,0xa5,0x09,0x07,0x19,0xca,0x2a,0x0b,0x32,0x4d,0x2a,0x2c,0x11,0x8a,0x19,0xeb,0x00,0xe7,0x09,0x28,0x2a,0x2b,0x11,0x88,0x63,0xf2,0xd7,0x5f,0x95,0x57,0x42,0x6b,0x63,0x8f,0xe7,0x7e,0xef,0xdf,0xef,0x9e,0xf7,0xdf,0xef,0x9e,0xff,0xff,0xce,0x99,0xa5,0x55,0xce,0x9a,0xc6,0x79,0xce,0x9a,0xd6,0xfc,0xd7,0x1d,0x8c,0xd4,0x7c,0x73,0x95,0x16,0x95,0x36,0x9d,0x77,0xae,0x1a,0xa6,0x1a,0xae,0x5b,0xc7,0x3f,0xae,0x7c,0xa6,0x1a,0x9d,0xb8,0x9d,0xb7,0xa5,0xf8,0xb6,0x59,0xc6,0xba,0xce,0xfc,0xdf,0x9f,0xcf,0x3e,0xb6,0x5b,0x9d,0x98,0x8d,0x36,0x8d,0x16,0x8d,0x36,0x9d,0x98,0x9d,0x98,0x9d,0x98,0xa5,0xd9,0xb6,0x5b,0xbe,0x7c,0xb6,0x5b,0xc6,0xbd,0xd7,0x5f,0xc6,0xde,0xae,0x1b,0x95,0x78,0x95,0x58,0x95,0x78,0x9d,0x78,0xa5,0xda,0xae,0x3b,0xae,0x1b,0xa5,0xda,0x95,0x79,0x8d,0x17,0x84,0xf6,0x8d,0x17,0x95,0x58,0x95,0x79,0x85,0x17,0x7c,0xf6,0x7c,0xf7,0x8d,0x58,0x95,0x99,0x95,0xba,0xa6,0x1b,0xb6,0x9d,0xcf,0x5f,0xcf,0x7f,0xc6,0xfe,0xa5,0xfa,0x95,0x98,0x9d,0xd9,0xae,0x3a,0xae,0x3a,0xc7,0x1e,0xb6,0x9c,0x9d,0xd9,0x85,0x17,0x7c,0xb5,0x74,0x94,0x7c,0xb5,0x7c,0xd6,0x95,0x78,0x95,0x99,0x95,0x79,0x85,0x17,0x74,0xb6,0x74,0x95,0x7c,0xb6,0x85,0x17,0x8d,0x99,0x85,0x58,0x74,0xd6,0x64,0x54,0x5b,0xf3,0x5b,0xf3,0x64,0x34,0x6c,0x75,0x53,0xd2,0x5b,0xf3,0x5b,0xf3,0x5c,0x13,0x64,0x34,0x6c,0x55,0x74,0x96,0x74,0xd6,0x74,0xb6,0x74,0x75,0x74,0xb6,0x8d,0x38,0x95,0x99,0x8d,0x38,0x74,0x95,0x63,0xf2,0x6c,0x33,0x74,0x95,0x84,0xf6,0x84,0xf6,0x7c,0xb5,0x7c,0xd5,0x95,0x98,0xb6,0x5b,0x9d,0xb9,0x7c,0xb5,0x63,0xf2,0x6c,0x53,0x85,0x16,0x95,0x78,0x95,0x57,0x8d,0x36,0xa5,0xf9,0xae,0x1a,0x9d,0x98,0x8d,0x37,0x95,0x78,0x8d,0x17,0x74,0x74,0x6c,0x34,0x5b,0xf3,0x5c,0x14,0x64,0x14,0x64,0x15,0x6c,0x56,0x6c,0x77,0x64,0x16,0x4b,0x93,0x53,0xf5,0x5c,0x15,0x5c,0x15,0x53,0xf5,0x53,0xf5,0x5c,0x15,0x5c,0x35,0x54,0x15
 ,0x18,0xe5,0x19,0x05,0x10,0xc4,0x10,0xa4,0x21,0x25,0x31,0xa8,0x29,0xa7,0x19,0x25,0x19,0x05,0x08,0xa4,0x00,0x42,0x08,0x83,0x29,0x88,0x3a,0x4b,0x29,0xa9,0x08,0xa4,0x19,0x25,0x21,0x25,0x10,0xa3,0x08,0x62,0x18,0xc4,0x18,0xe4,0x08,0x82,0x10,0x83,0x08,0x62,0x08,0x62,0x10,0xa3,0x08,0x42,0x10,0xa3,0x08,0x62,0x10,0x83,0x08,0x62,0x10,0x83,0x10,0xa3,0x08,0x42,0x08,0x62,0x08,0x62,0x21,0x25,0x18,0xe5,0x10,0xa3,0x08,0x83,0x08,0xa3,0x08,0x63,0x00,0x62,0x08,0xa4,0x08,0xc4,0x19,0x05,0x29,0xa8,0x29,0x88,0x21,0x67,0x21,0x26,0x18,0xe5,0x10,0xa3,0x08,0x62,0x10,0xa3,0x29,0x66,0x31,0x86,0x18,0xc4,0x10,0xc4,0x19,0x05,0x29,0xc8,0x21,0xa8,0x00,0x84,0x08,0xc5,0x09,0x27,0x09,0x07,0x19,0x89,0x2a,0x0b,0x22,0x0b,0x2a,0x2c,0x2a,0x4d,0x19,0xcb,0x11,0x8a,0x22,0x0c,0x21,0xeb,0x3a,0xce,0x19,0xca,0x2a,0x0b,0x8d,0x37,0xdf,0x7f,0x84,0x93,0x5b,0x2e,0xce,0xbb,0xff,0xff,0xef,0xbf,0xef,0x9e,0xdf,0x1b,0xf7,0xbe,0xef,0xbe,0xbe,0x38,0xe7,0x9d,0xc6,0x59,0xb5,0xd7,0xc6,0x7a,0xe7,0x5e,0x8c,0xd4,0x84,0x93,0x94,0xf5,0x95,0x36,0x9d,0x57,0xa5,0xd9,0xa5,0xfa,0xb6,0x7c,0xcf,0x5f,0xbe,0xdd,0xb6,0x7b,0xa6,0x19,0xa5,0xf8,0xa5,0xf8,0xae,0x39,0xb6,0x79,0xbe,0xbb,0xc6,0xfd,0xcf,0x1e,0xb6,0x5b,0x8d,0x36,0x84,0xd5,0x85,0x16,0x8d,0x16,0x8d,0x16,0x8d,0x36,0x8d,0x16,0x95,0x58,0xa5,0xfa,0xae,0x1a,0xa5,0xfa,0xb6,0x5b,0xc6,0xfe,0xc6,0xfe,0xad,0xfa,0x8d,0x37,0x8d,0x17,0x95,0x58,0x95,0x78,0x9d,0x99,0xa5,0xda,0xa5,0xfa,0x9d,0x99,0x8d,0x37,0x84,0xd6,0x84,0xd6,0x84,0xf6,0x84,0xf7,0x85,0x17,0x7c,0xb6,0x74,0x95,0x74,0xb5,0x85,0x17,0x85,0x38,0x8d,0x58,0x8d,0x99,0x9d,0xda,0xae,0x5c,0xae,0x7c,0xa6,0x3b,0x9d,0xb9,0x95,0x98,0xa5,0xfa,0xb6,0x5b,0xb6,0x7c,0xae,0x5c,0xa6,0x3b,0x9d,0xfa,0x95,0xb9,0x8d,0x78,0x8d,0x58,0x8d,0x37,0x85,0x37,0x8d,0x78,0x95,0x99,0x95,0xba,0x95,0x99,0x8d,0x58,0x85,0x17,0x7c,0xf7,0x7c,0xf7,0x95,0xda,0x95,0xba,0x85,0x78,0x7d,0x17,0x74,0xb6,0x6c,0x95,0x74,0x95,0x74,0xb6,0x7d,0x17,0x85,0x38,0x85,0x38,0x85,0x38,0x7d,0x17,0x7d,0x17,0x85,0x38,0x8d,0x79,0x8d,0x59,0x85,0x17,0x7c,0xf7,0x8d,0x79,0x9d,0xda,0x9d,0xda,0x8d,0x58,0x84,0xf6,0x7c,0xb5,0x7c,0xb5,0x7c,0xb5,0x7c,0xd6,0x84,0xd6,0x8d,0x37,0x9d,0xb9,0xae,0x3b,0xae,0x3b,0x8d,0x58,0x7c,0xb5,0x7c,0xb5,0x8d,0x37,0x95,0x78,0x95,0x98,0x9d,0xb8,0xae,0x3a,0xb6,0x9c,0xa6,0x1a,0x95,0x98,0x9d,0xda,0xa5,0xfa,0x8d,0x58,0x7c,0xd6,0x6c,0x55,0x64,0x55,0x64,0x35,0x6c,0x76,0x7c,0xf9,0x8d,0x7a,0x85,0x1a,0x6c,0x97,0x5c,0x36,0x64,0x56,0x64,0x56,0x5c,0x36,0x53,0xf5,0x53,0xf4,0x53,0xf5,0x54,0x15
@@ -321,4 +332,4 @@ const uint8_t snow_tiger[320*240*2] = {0x10,0xc4,0x18,0xc4,0x08,0x83,0x08,0x83,0
 ,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xde,0xf7,0xde,0xf7,0xde,0xf7,0xdf,0xf7,0xdf,0xf7,0xdf,0xef,0xbe,0xef,0xbe,0xe7,0xbf,0xdf,0x9f,0xdf,0x7e,0xd7,0x5e,0xce,0xfd,0xc6,0x9b,0xb6,0x3a,0xb6,0x1a,0xad,0xfa,0xad,0xd9,0x9d,0x99,0x9d,0x78,0x9d,0x79,0x9d,0x79,0x9d,0x78,0x95,0x58,0x95,0x79,0x95,0x78,0x95,0x58,0x8d,0x58,0x8d,0x38,0x8d,0x38,0x8d,0x38,0x8d,0x38,0x8d,0x58,0x8d,0x58,0x8d,0x58,0x8d,0x58,0x8d,0x38,0x8d,0x38,0x8d,0x38,0x8d,0x37,0x95,0x58,0x95,0x37,0x95,0x37,0x95,0x58,0x95,0x78,0x95,0x58,0x95,0x58,0x95,0x58,0x95,0x58,0x95,0x78,0x95,0x78,0x95,0x78,0x95,0x78,0x95,0x78,0x95,0x78,0x9d,0x78,0x9d,0x99,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0xb9,0x9d,0xb9,0x9d,0x99,0x9d,0xb9,0xa5,0xd9,0xa5,0xda,0xa5,0xfa,0xa5,0xfa,0xa5,0xda,0xa5,0xda,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xae,0x1a,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x3a,0xae,0x1a,0xae,0x1a,0xb6,0x5b,0xb6,0x5b,0xb6,0x5b,0xb6,0x5b,0xb6,0x7b,0xb6,0x7b,0xb6,0x7b,0xbe,0x7b,0xbe,0x7b,0xb6,0x7b,0xb6,0x7b,0xb6,0x7b,0xbe,0x7b,0xbe,0x9c,0xbe,0x9c,0xbe,0x9c,0xbe,0x7b,0xbe,0x7b,0xbe,0x5b,0xb6,0x5b,0xb6,0x3a,0xb6,0x1a,0xae,0x1a,0xad,0xf9,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xd9,0xa5,0xd9,0xa5,0xb9,0xa5,0xb9,0xa5,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x99,0xa5,0xb9,0xa5,0xb9,0xa5,0xb9,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x78,0x9d,0x78,0x9d,0x78,0x9d,0x78,0x9d,0x98,0x9d,0x98,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x98,0x9d,0x98,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x78,0x9d,0x98,0x9d,0x99,0xa5,0xb9,0xa5,0xfa,0xa5,0xfa,0xa5,0xfa,0xa5,0xfa,0xa5,0xfa,0xa5,0xfa,0xa5,0xfa,0xa5,0xfa,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xfa,0xa5,0xfa,0xa5,0xfa,0xa5,0xfa,0xa5,0xda,0xa5,0xfa,0xad,0xfa,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1b,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x3b,0xb6,0x3b,0xb6,0x5b,0xb6,0x5b,0xb6,0x7b,0xbe,0x9b,0xbe,0x9c,0xbe,0x9c,0xbe,0x9c,0xbe,0x9c,0xbe,0x9c,0xc6,0xdc,0xc6,0xdd,0xc6,0xfd,0xc6,0xfd,0xce,0xfd,0xcf,0x1d,0xcf,0x1e,0xcf,0x1e,0xcf,0x3e,0xc7,0x3e,0xc7,0x1e,0xc7,0x1e,0xc7,0x1e,0xcf,0x3e,0xcf,0x3e,0xcf,0x3e,0xd7,0x7f,0xd7,0x7f,0xd7,0x5e,0xd7,0x7e,0xdf,0x7f,0xdf,0x7f,0xdf,0x7e,0xdf,0x7e
 ,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xff,0xf7,0xde,0xf7,0xde,0xf7,0xde,0xf7,0xff,0xf7,0xdf,0xf7,0xdf,0xef,0xde,0xef,0xbe,0xe7,0xbf,0xdf,0x9e,0xdf,0x7e,0xd7,0x5e,0xd7,0x1d,0xc6,0xbc,0xb6,0x5a,0xae,0x1a,0xad,0xfa,0xa5,0xd9,0x9d,0x99,0x9d,0x78,0x9d,0x79,0x9d,0x79,0x9d,0x79,0x9d,0x79,0x95,0x79,0x95,0x78,0x95,0x58,0x8d,0x58,0x8d,0x38,0x8d,0x38,0x8d,0x38,0x8d,0x38,0x8d,0x58,0x8d,0x58,0x8d,0x58,0x8d,0x58,0x8d,0x38,0x8d,0x38,0x8d,0x38,0x8d,0x37,0x95,0x38,0x8d,0x37,0x95,0x37,0x95,0x58,0x95,0x78,0x95,0x58,0x95,0x58,0x95,0x58,0x95,0x78,0x95,0x78,0x95,0x78,0x95,0x78,0x95,0x78,0x95,0x78,0x95,0x78,0x95,0x78,0x9d,0x99,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0x98,0x9d,0x99,0x9d,0x98,0x9d,0x98,0x9d,0x99,0xa5,0xb9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xda,0xa5,0xda,0xa5,0xda,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xa5,0xfa,0xad,0xfa,0xad,0xfa,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x3a,0xae,0x3a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xae,0x3a,0xae,0x3a,0xb6,0x3a,0xb6,0x5b,0xb6,0x5b,0xb6,0x5b,0xb6,0x7b,0xb6,0x5b,0xb6,0x5b,0xb6,0x7b,0xb6,0x7b,0xb6,0x7b,0xb6,0x7b,0xbe,0x7b,0xbe,0x9c,0xbe,0x7b,0xbe,0x7b,0xb6,0x5b,0xb6,0x5b,0xb6,0x3a,0xae,0x1a,0xad,0xf9,0xad,0xf9,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xad,0xd9,0xa5,0xd9,0xa5,0xb9,0x9d,0x98,0x9d,0x78,0xa5,0xb9,0x9d,0x99,0x9d,0x99,0x9d,0x78,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x78,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x78,0x9d,0x78,0x9d,0x78,0x9d,0x78,0x9d,0x78,0x9d,0x78,0x9d,0x98,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x98,0x9d,0x98,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x99,0x9d,0x78,0x9d,0x78,0x9d,0x99,0x9d,0xb9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0x9d,0xb9,0x9d,0xb9,0x9d,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xd9,0xa5,0xda,0xa5,0xfa,0xad,0xfa,0xad,0xfa,0xae,0x1a,0xae,0x1a,0xae,0x1a,0xad,0xfa,0xad,0xfa,0xad,0xfa,0xa5,0xfa,0xa5,0xfa,0xad,0xfa,0xae,0x1a,0xae,0x3b,0xb6,0x5b,0xb6,0x5b,0xb6,0x7b,0xbe,0x9b,0xbe,0x9c,0xbe,0x9c,0xbe,0x9b,0xbe,0x9b,0xbe,0x9c,0xc6,0xdc,0xc6,0xdc,0xc6,0xdd,0xc6,0xdd,0xc6,0xfd,0xce,0xfd,0xcf,0x1d,0xcf,0x1d,0xcf,0x1e,0xc7,0x1e,0xc7,0x1e,0xc7,0x1e,0xc7,0x1d,0xc7,0x1e,0xcf,0x1e,0xcf,0x3e,0xd7,0x5e,0xd7,0x5e,0xd7,0x5e,0xd7,0x5e,0xd7,0x5e,0xd7,0x5e,0xd7,0x5e,0xd7,0x5e};
 
-
+#endif /* INC_SNOW_TIGER_H_ */
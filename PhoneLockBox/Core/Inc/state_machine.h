@@ -10,8 +10,7 @@
 #define INC_STATE_MACHINE_H_
 
 #include <stdbool.h>
-
-#define MAX_FLAGS 10
+#include <stdint.h>
 
 typedef enum {
 	SFLAG_NULL,
@@ -27,18 +26,34 @@ typedef enum {
 	SFLAG_BOX_OPEN, //consider this lol
 	SFLAG_AUDIO_VOL_HIGH, //is audio volume high
 	SFLAG_AUDIO_MATCH, //is there an audio match
-	SFLAG_AUDIO_NO_MATCH
+	SFLAG_AUDIO_NO_MATCH,
+	SFLAG_COUNT
 } SFlag;
 
+/* Flag Set
+ *	The flags are held as one bit per SFlag in a single word, so a test
+ *	of several flags at once is one AND and compare on a snapshot from
+ *	stateFlags(). Insert and remove are atomic read-modify-writes and
+ *	can be used from interrupt context. SFLAG_NULL is never set.
+ */
+typedef uint32_t SFlagSet;
+#define SFLAG_BIT(flag) ((SFlagSet)1 << (flag))
+#define SFLAG_ANY(set, mask) (((set) & (mask)) != 0)
+#define SFLAG_ALL(set, mask) (((set) & (mask)) == (mask))
+
 
 void stateMachineInit(void);
 void runStateMachine(void);
-void stateTransitionCleanup(BoxState next);
+ScreenId stateScreen(void);
+bool hasFlag(SFlag flag);
 bool stateInsertFlag(SFlag flag);
 void stateRemoveFlag(SFlag flag);
+SFlagSet stateFlags(void);
 void stateScheduleEvents(void);
 void clearFlags(void);
 void inturruptControl(void);
+void stateDrainSignals(void);
+bool stateWorkPending(void);
 
 #ifdef DEBUG_STATE_CONTROLLER
 	const char* SFlagToStr(SFlag flag);
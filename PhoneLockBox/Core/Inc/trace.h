@@ -0,0 +1,46 @@
+/*
+ * trace.h
+ *
+ *	Always-on record of state transitions, kept in RAM so a box that
+ *	misbehaved can be asked what it did without DEBUG_OUT builds.
+ */
+
+#ifndef INC_TRACE_H_
+#define INC_TRACE_H_
+
+#include <stdint.h>
+
+#include "shared.h"
+#include "state_machine.h"
+#include "event_controller.h"
+
+#define TRACE_RING 128       /* entries kept, power of two */
+#define TRACE_DUMP_CMD 'T'   /* LPUART byte that asks for a dump */
+#define TRACE_VERSION 1
+
+typedef enum {
+	TRACE_CAUSE_FLAGS,        /* a transition row matched, flags holds the bits it tested */
+	TRACE_CAUSE_MASTER_TIMER  /* the lock timer ran out, flags is 0 */
+} TraceCause;
+
+/* TRACE ENTRY INFO
+ * One per transition, 12 bytes, dumped as is (little-endian). label is
+ * the event whose callback set the first of the triggering flags,
+ * EVENT_EMPTY when an interrupt signal set it. tools/trace/trace_decode.py
+ * reads this layout, bump TRACE_VERSION when it changes.
+ * */
+typedef struct {
+	uint32_t time_ms;
+	SFlagSet flags;
+	uint8_t from;   /* BoxState */
+	uint8_t to;     /* BoxState */
+	uint8_t label;  /* EventLabel */
+	uint8_t cause;  /* TraceCause */
+} TraceEntry;
+
+void traceTransition(BoxState from, BoxState to, SFlagSet flags, EventLabel label, TraceCause cause);
+uint32_t traceCount(void);
+void traceDump(void);
+void tracePoll(void);
+
+#endif /* INC_TRACE_H_ */
@@ -2,10 +2,11 @@
 #include "shared.h"
 #include "stm32l4xx_hal.h"
 #include <stdio.h>
-#include <math.h> // for atan2f and M_PI
+#include <math.h> // for cosf/sinf and M_PI
 #include <stdbool.h>
 #include "font.h"
 #include "lock_timer.h"
+#include "state_machine.h"
 //Driver for screen functions
 
 
@@ -24,27 +25,42 @@ extern uint32_t max_time_ms;
 int LCD_HEIGHT = LCD_HEIGHT_1;
 int LCD_WIDTH = LCD_WIDTH_1;
 
+//framebuffer hooks, the drawing primitives below divert into RAM while it is enabled
+static bool fb_enabled;
+static void ILI9341_Set_Address_Panel(uint16_t X1, uint16_t Y1, uint16_t X2, uint16_t Y2);
+static void ILI9341_FB_Set_Window(uint16_t X1, uint16_t Y1, uint16_t X2, uint16_t Y2);
+static void ILI9341_FB_Write_Colour(uint16_t Colour, uint32_t Size);
+static void ILI9341_FB_Write_Bytes(const uint8_t *Data, uint32_t Length);
+static void ILI9341_FB_Draw_Pixel(uint16_t X, uint16_t Y, uint16_t Colour);
 
+//countdown ring: remembers the angle on the panel so Ring_Update only paints the change
+#define RING_X		(320/2)
+#define RING_Y		(240/2)
+#define RING_RAD	80
+#define RING_WIDTH	3
 
+static struct {
+	float deg;		// angle currently drawn
+	bool drawn;		// false once the screen has been redrawn underneath it
+} countdown_ring;
+static void ILI9341_Arc_Fill(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius,
+		float start_angle_deg, float end_angle_deg, bool open_start, bool open_end, uint16_t color);
+static void Ring_Draw_Full(void);
 
+//timer readout: HH:MM:SS in fixed cells, only cells whose character changed are sent
+#define TIMER_CELLS		8
+
+static struct {
+	char shown[TIMER_CELLS];	// characters on the panel
+	bool drawn;			// false once the screen has been redrawn underneath it
+} timer_readout;
+static void Timer_Readout_Update(uint32_t ms_time);
 
 
 
-// function to get formatted time string from timer time
-char* get_time_str(uint32_t ms_time) {
-	static char time_str[16]; // static buffer for the time string
 
-	// convert milliseconds to hours, minutes, and seconds
-	uint32_t total_seconds = ms_time / 1000;
-	uint32_t hours = total_seconds / 3600;
-	uint32_t minutes = (total_seconds % 3600) / 60;
-	uint32_t seconds = total_seconds % 60;
 
-	// format the time as "HH:MM:SS"
-	sprintf(time_str, "%02lu:%02lu:%02lu", hours, minutes, seconds);
-	return time_str;
 
-}
 
 //implicitly get time string
 char* get_time() {
@@ -64,312 +80,318 @@ char* get_time() {
 
 
 
-//Set screen according to current state
-void screenResolve(void) {
-	int w = 0;
-	int h=0;
-	int time_width;
-	int time_height;
-	int rad;
-	int time_x;
-	int time_y;
-
-	//Switch case for every state
-	switch (state) {
-
-
-
-	case UNLOCKED_EMPTY_ASLEEP:
-
-		// turn OFF
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_RESET);
-		ILI9341_Fill_Screen(BACKG);
-		//nothing to display when we are sleep
-		break;
-
-
-	case UNLOCKED_ASLEEP_TO_AWAKE:
-		//turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-		ILI9341_Fill_Screen(BACKG);
-
-		w = (320 - get_text_width("Powering On", FONT4))/2;
-		h = (240 - get_text_height(FONT4))/2;
-		//trying to initialize this to the middle of the screen
-		ILI9341_Draw_Text("Powering On", FONT4, w, h, WHITE, BACKG);
-		break;
-
-
-	case UNLOCKED_EMPTY_AWAKE:
-
-		//turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-		ILI9341_Fill_Screen(BACKG);
-
-		//Draw text on screen
-		w = (320 - get_text_width("Press Button To Power Off", FONT4))/2;
-		ILI9341_Draw_Text("Press Button To Power Off", FONT4, w, 10, WHITE, BACKG);
-
-		//level 2
-		w = (320 - get_text_width("Turn Dial to Set time", FONT4))/2;
-		ILI9341_Draw_Text("Turn Dial to Set time", FONT4, w, 30, WHITE, BACKG);
-
-		//level 4 (moved from level 3)
-		w = (320 - get_text_width("Put phone in box to enable locking", FONT3))/2;
-		ILI9341_Draw_Text("Put phone in box to enable locking", FONT3, w, 220, WHITE, BACKG);
-
-		// draw lock and phone icons
-		ILI9341_Draw_Lock(290, 20, 20, YELLOW, false); // Unlocked
-		ILI9341_Draw_Phone(10, 10, 20, false); // No phone
-
-		time_width = get_text_width("00:00:00", FONT4);
-		time_height = get_text_height(FONT4);
-		time_x = (320 - time_width)/2;
-		time_y = (240 - time_height)/2; // Position below "Current Time:" label
-
-		// clear old time area
-		// draw new time
-		ILI9341_Draw_Text("00:00:00", FONT4, time_x, time_y, WHITE, BACKG);
-		break;
-
-
-	case UNLOCKED_FULL_AWAKE_FUNC_A:
-
-		//turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-		ILI9341_Fill_Screen(BACKG);
-
-		//draw text
-		w = (320 - get_text_width("Charge Phone", FONT4))/2;
-		ILI9341_Draw_Text("Charge Phone", FONT4, w, 80, GREEN, BACKG);
-
-		//level 2
-		w = (320 - get_text_width("Lock", FONT4))/2;
-		ILI9341_Draw_Text("Lock", FONT4, w, 120, RED, BACKG);
-
-		// Draw lock and phone icons
-		ILI9341_Draw_Lock(280, 20, 20, YELLOW, false); // Unlocked
-		ILI9341_Draw_Phone(10, 10, 20, true); // Phone present
-
-		break;
-
-	case UNLOCKED_FULL_AWAKE_FUNC_B:
-
-		// turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-		ILI9341_Fill_Screen(BACKG);
-
-		//level 1
-		w = (320 - get_text_width("Charge Phone", FONT4))/2;
-		ILI9341_Draw_Text("Charge Phone", FONT4, w, 80, RED, BACKG);
-
-		//level 2
-		w = (320 - get_text_width("Lock", FONT4))/2;
-		ILI9341_Draw_Text("Lock", FONT4, w, 120, GREEN, BACKG);
-
-		//level 3: display time but it is not changing
-		w = (320 - get_text_width(get_time(), FONT4))/2;
-		ILI9341_Draw_Text(get_time(), FONT4, w, 160, GREEN, BACKG);
-		// draw lock and phone icons
-		ILI9341_Draw_Lock(280, 20, 20, YELLOW, false); // Unlocked
-		ILI9341_Draw_Phone(10, 10, 20, true); // Phone present
-		break;
-
-	case UNLOCKED_FULL_ASLEEP:
-
-		//turn OFF
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_RESET);
-		ILI9341_Fill_Screen(BACKG);
-		// nothing to display when we are sleep
-		break;
-
-	case UNLOCKED_TO_LOCKED_AWAKE:
-
-		//turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-		ILI9341_Fill_Screen(BACKG);
-		//level 1
-		w = (320 - get_text_width("Locking, press button to cancel", FONT4))/2;
-		ILI9341_Draw_Text("Locking, press button to cancel", FONT4, w, 120, WHITE, BACKG);
-
-		// show transitioning lock icon
-		ILI9341_Draw_Lock(160, 60, 40, YELLOW, true); // Locked
-		break;
-
-	case LOCKED_FULL_AWAKE:
-
-		//turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-		ILI9341_Fill_Screen(BACKG);
-
-		//level 1
-		w = (320 - get_text_width("Time Remaining", FONT4))/2;
-		ILI9341_Draw_Text("Time Remaining", FONT4, w, 10, WHITE, BACKG);
-
-		// draw lock and phone icons
-		ILI9341_Draw_Lock(280, 20, 20, YELLOW, true); // Locked
-		ILI9341_Draw_Phone(10, 10, 20, true); // Phone present
+/*
+ * Render queue
+ *	Screen work asked for by the state machine and the main loop is queued
+ *	here rather than drawn on the spot. Render_Task() drains it a step at a
+ *	time and hands control back once its budget is spent or the panel DMA
+ *	is still busy, so a full repaint never holds up eventRunner. Each
+ *	state's screen is a const list of draw ops and a repaint runs one op
+ *	per step. Requests coalesce: a new screenResolve restarts the repaint
+ *	for the latest state and drops ring/timer updates meant for the screen
+ *	it replaces, and repeated ring or timer requests collapse into a single
+ *	update that reads the lock timer when it runs.
+ */
+#define SCREEN_CENTRE	(-1)	//centre text along this axis
+
+typedef enum {
+	SCREEN_OP_END,
+	SCREEN_OP_BACKLIGHT,	//on: backlight lit
+	SCREEN_OP_FILL,			//clear to BACKG
+	SCREEN_OP_TEXT,
+	SCREEN_OP_TIME,			//lock timer value as HH:MM:SS text
+	SCREEN_OP_LOCK,			//on: shackle closed
+	SCREEN_OP_PHONE,		//on: phone present
+	SCREEN_OP_RING			//full countdown ring
+} Screen_Op_Kind;
+
+typedef struct {
+	Screen_Op_Kind op;
+	int16_t x, y;
+	const char *text;
+	const uint8_t *font;
+	uint16_t colour;
+	uint8_t size;
+	bool on;
+} Screen_Op;
+
+#define OP_BACKLIGHT(ON)					{ .op = SCREEN_OP_BACKLIGHT, .on = (ON) }
+#define OP_FILL								{ .op = SCREEN_OP_FILL }
+#define OP_TEXT(STR, FONT, X, Y, COLOUR)	{ .op = SCREEN_OP_TEXT, .text = (STR), .font = (FONT), .x = (X), .y = (Y), .colour = (COLOUR) }
+#define OP_TIME(FONT, X, Y, COLOUR)			{ .op = SCREEN_OP_TIME, .font = (FONT), .x = (X), .y = (Y), .colour = (COLOUR) }
+#define OP_LOCK(X, Y, SIZE, COLOUR, LOCKED)	{ .op = SCREEN_OP_LOCK, .x = (X), .y = (Y), .size = (SIZE), .colour = (COLOUR), .on = (LOCKED) }
+#define OP_PHONE(X, Y, SIZE, PRESENT)		{ .op = SCREEN_OP_PHONE, .x = (X), .y = (Y), .size = (SIZE), .on = (PRESENT) }
+#define OP_RING								{ .op = SCREEN_OP_RING }
+#define OP_END								{ .op = SCREEN_OP_END }
+
+//nothing to display when we are asleep
+static const Screen_Op screen_asleep[] = {
+	OP_BACKLIGHT(false),
+	OP_FILL,
+	OP_END
+};
+
+static const Screen_Op screen_powering_on[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Powering On", FONT4, SCREEN_CENTRE, SCREEN_CENTRE, WHITE),
+	OP_END
+};
+
+static const Screen_Op screen_empty_awake[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Press Button To Power Off", FONT4, SCREEN_CENTRE, 10, WHITE),
+	OP_TEXT("Turn Dial to Set time", FONT4, SCREEN_CENTRE, 30, WHITE),
+	OP_TEXT("Put phone in box to enable locking", FONT3, SCREEN_CENTRE, 220, WHITE),
+	OP_LOCK(290, 20, 20, YELLOW, false),
+	OP_PHONE(10, 10, 20, false),
+	OP_TEXT("00:00:00", FONT4, SCREEN_CENTRE, SCREEN_CENTRE, WHITE),	//replaced by the timer readout once the dial turns
+	OP_END
+};
+
+static const Screen_Op screen_full_awake_a[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Charge Phone", FONT4, SCREEN_CENTRE, 80, GREEN),
+	OP_TEXT("Lock", FONT4, SCREEN_CENTRE, 120, RED),
+	OP_LOCK(280, 20, 20, YELLOW, false),
+	OP_PHONE(10, 10, 20, true),
+	OP_END
+};
+
+static const Screen_Op screen_full_awake_b[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Charge Phone", FONT4, SCREEN_CENTRE, 80, RED),
+	OP_TEXT("Lock", FONT4, SCREEN_CENTRE, 120, GREEN),
+	OP_TIME(FONT4, SCREEN_CENTRE, 160, GREEN),	//time is shown but not updated here
+	OP_LOCK(280, 20, 20, YELLOW, false),
+	OP_PHONE(10, 10, 20, true),
+	OP_END
+};
+
+static const Screen_Op screen_locking[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Locking, press button to cancel", FONT4, SCREEN_CENTRE, 120, WHITE),
+	OP_LOCK(160, 60, 40, YELLOW, true),
+	OP_END
+};
+
+static const Screen_Op screen_locked_awake[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Time Remaining", FONT4, SCREEN_CENTRE, 10, WHITE),
+	OP_LOCK(280, 20, 20, YELLOW, true),
+	OP_PHONE(10, 10, 20, true),
+	OP_RING,
+	OP_END
+};
+
+static const Screen_Op screen_monitor_awake[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Time Remaining", FONT4, SCREEN_CENTRE, 10, WHITE),
+	OP_LOCK(280, 20, 20, YELLOW, true),
+	OP_RING,
+	OP_END
+};
+
+static const Screen_Op screen_notification_a[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Incoming call!!", FONT4, SCREEN_CENTRE, 70, WHITE),
+	OP_TEXT("Do you want to unlock?", FONT4, SCREEN_CENTRE, 100, WHITE),
+	OP_TEXT("Unlock", FONT4, SCREEN_CENTRE, 130, GREEN),
+	OP_TEXT("Ignore", FONT4, SCREEN_CENTRE, 160, RED),
+	OP_END
+};
+
+static const Screen_Op screen_notification_b[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Incoming call!!", FONT4, SCREEN_CENTRE, 70, WHITE),
+	OP_TEXT("Do you want to unlock?", FONT4, SCREEN_CENTRE, 100, WHITE),
+	OP_TEXT("Unlock", FONT4, SCREEN_CENTRE, 130, RED),
+	OP_TEXT("Ignore", FONT4, SCREEN_CENTRE, 160, GREEN),
+	OP_END
+};
+
+static const Screen_Op screen_emergency_open[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("Box Forced Open", FONT4, SCREEN_CENTRE, 120, RED),
+	OP_END
+};
+
+static const Screen_Op screen_default[] = {
+	OP_BACKLIGHT(true),
+	OP_FILL,
+	OP_TEXT("default", FONT4, SCREEN_CENTRE, 120, WHITE),
+	OP_END
+};
+
+static const Screen_Op *const screens[SCREEN_COUNT] = {
+	[SCREEN_ASLEEP] = screen_asleep,
+	[SCREEN_POWERING_ON] = screen_powering_on,
+	[SCREEN_EMPTY_AWAKE] = screen_empty_awake,
+	[SCREEN_FULL_AWAKE_A] = screen_full_awake_a,
+	[SCREEN_FULL_AWAKE_B] = screen_full_awake_b,
+	[SCREEN_LOCKING] = screen_locking,
+	[SCREEN_LOCKED_AWAKE] = screen_locked_awake,
+	[SCREEN_MONITOR_AWAKE] = screen_monitor_awake,
+	[SCREEN_NOTIFICATION_A] = screen_notification_a,
+	[SCREEN_NOTIFICATION_B] = screen_notification_b,
+	[SCREEN_EMERGENCY_OPEN] = screen_emergency_open,
+};
+
+#define RENDER_SCREEN	0x01
+#define RENDER_RING		0x02
+#define RENDER_TIMER	0x04
+
+static struct {
+	uint8_t pending;		//RENDER_* work still queued
+	const Screen_Op *op;	//next op of the screen being painted
+} render;
+
+static void Ring_Draw_Update(void);
+
+static void Screen_Op_Draw(const Screen_Op *op)
+{
+	int16_t x = op->x;
+	int16_t y = op->y;
 
-		//Draw the ring around the time left
-		int rad = 80;
-		ILI9341_Draw_RingSector(320/2, 240/2, rad-3, rad, 360, RED);
+	switch (op->op) {
+	case SCREEN_OP_BACKLIGHT:
+		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, op->on ? GPIO_PIN_SET : GPIO_PIN_RESET);
 		break;
 
-
-	case LOCKED_FULL_ASLEEP:
-		//turn OFF
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_RESET);
+	case SCREEN_OP_FILL:
 		ILI9341_Fill_Screen(BACKG);
-		// no text is displayed when screen is off
 		break;
 
-	case LOCKED_MONITOR_AWAKE:
-		// turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-//		if (full_refresh) {
-			ILI9341_Fill_Screen(BACKG);
-			//level 1
-			w = (320 - get_text_width("Time Remaining", FONT4))/2;
-			ILI9341_Draw_Text("Time Remaining", FONT4, w, 10, WHITE, BACKG);
-			// Draw lock icon
-			ILI9341_Draw_Lock(280, 20, 20, YELLOW, true); // Locked
-			rad = 80;
-			//draw ring around text
-			ILI9341_Draw_RingSector(320/2, 240/2, rad-3, rad, 360, RED);
-			// save current time for next comparison
-		break;
-
-	case LOCKED_MONITOR_ASLEEP:
-		// MOSFET: ON, SCREEN: OFF
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_RESET);
-		ILI9341_Fill_Screen(BACKG);
-		//nothing to display when we are sleep
+	case SCREEN_OP_TEXT:
+	case SCREEN_OP_TIME: {
+		const char *text = (op->op == SCREEN_OP_TIME) ? get_time() : op->text;
+		if (x == SCREEN_CENTRE) x = (320 - get_text_width(text, op->font))/2;
+		if (y == SCREEN_CENTRE) y = (240 - get_text_height(op->font))/2;
+		ILI9341_Draw_Text(text, op->font, x, y, op->colour, BACKG);
 		break;
+	}
 
-
-	case LOCKED_FULL_NOTIFICATION_FUNC_A:
-		// turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-		ILI9341_Fill_Screen(BACKG);
-
-		//level 1
-		w = (320 - get_text_width("Incoming call!!", FONT4))/2;
-		ILI9341_Draw_Text("Incoming call!!", FONT4, w, 70, WHITE, BACKG);
-
-		//level 2
-		w = (320 - get_text_width("Do you want to unlock?", FONT4))/2;
-		ILI9341_Draw_Text("Do you want to unlock?", FONT4, w, 100, WHITE, BACKG);
-
-		//level 3
-		w = (320 - get_text_width("Unlock", FONT4))/2;
-		ILI9341_Draw_Text("Unlock", FONT4, w, 130, GREEN, BACKG);
-
-		//level 4
-		w = (320 - get_text_width("Ignore", FONT4))/2;
-		ILI9341_Draw_Text("Ignore", FONT4, w, 160, RED, BACKG);
+	case SCREEN_OP_LOCK:
+		ILI9341_Draw_Lock(x, y, op->size, op->colour, op->on);
 		break;
 
-
-	case LOCKED_FULL_NOTIFICATION_FUNC_B:
-		// turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-			ILI9341_Fill_Screen(BACKG);
-
-			//level 1
-			w = (320 - get_text_width("Incoming call!!", FONT4))/2;
-			ILI9341_Draw_Text("Incoming call!!", FONT4, w, 70, WHITE, BACKG);
-
-			//level 2
-			w = (320 - get_text_width("Do you want to unlock?", FONT4))/2;
-			ILI9341_Draw_Text("Do you want to unlock?", FONT4, w, 100, WHITE, BACKG);
-
-			//level 3
-			w = (320 - get_text_width("Unlock", FONT4))/2;
-			ILI9341_Draw_Text("Unlock", FONT4, w, 130, RED, BACKG);
-
-			//level 4
-			w = (320 - get_text_width("Ignore", FONT4))/2;
-			ILI9341_Draw_Text("Ignore", FONT4, w, 160, GREEN, BACKG);
-			rad = 80;
-
-
+	case SCREEN_OP_PHONE:
+		ILI9341_Draw_Phone(x, y, op->size, op->on);
 		break;
 
-
-	case EMERGENCY_OPEN:
-		// turn on
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-			ILI9341_Fill_Screen(BACKG);
-			w = (320 - get_text_width("Box Forced Open", FONT4))/2;
-			ILI9341_Draw_Text("Box Forced Open", FONT4, w, 120, RED, BACKG);
+	case SCREEN_OP_RING:
+		Ring_Draw_Full();
 		break;
 
-
 	default:
-
-		HAL_GPIO_WritePin(LCD_BACKLIGHT_PORT, LCD_BACKLIGHT_PIN, GPIO_PIN_SET);
-		ILI9341_Fill_Screen(BACKG);
-		w = (320 - get_text_width("default", FONT4))/2;
-		ILI9341_Draw_Text("default", FONT4, w, 120, WHITE, BACKG);
 		break;
-
 	}
+}
+
+//Queue a repaint of the screen the current state shows
+void screenResolve(void) {
+	const Screen_Op *ops = screen_default;
+	ScreenId id = stateScreen();
+	if (id < SCREEN_COUNT && screens[id]) ops = screens[id];
 
+	//every state repaints the screen, so the ring and timer have to be drawn again before they can be updated
+	countdown_ring.drawn = false;
+	timer_readout.drawn = false;
+
+	//whatever was queued for the previous screen is stale, a half painted one is simply restarted
+	render.op = ops;
+	render.pending = RENDER_SCREEN;
 }
 
-//Screen update where we draw the time left
+//Queue a redraw of the time left, only the digits that changed since the last one are sent
 void UEA_Timer_Update(){
-	//get time
-	uint32_t time_ms = lockTimerGetTime();
-		// clear previous time area
-		char* time_str = get_time_str(time_ms);
-		int time_width = get_text_width(time_str, FONT4);
-		int time_height = get_text_height(FONT4);
-		int time_x = (320 - time_width)/2;
-		int time_y = (240 - time_height)/2; // Position below "Current Time:" label
-
-		// clear old time area
-		// draw new time
-		uint8_t pad=3;
+	render.pending |= RENDER_TIMER;
+}
 
-		//clear area behind text and write the time
-		ILI9341_Draw_FilledRectangleCoord(time_x-pad, time_y-pad, time_x + time_width + pad, time_y + time_height + pad, BACKG);
+//Queue a redraw of the countdown ring at the current time
+void Ring_Update(){
+	render.pending |= RENDER_RING;
+}
 
-		ILI9341_Draw_Text(time_str, FONT4, time_x, time_y, WHITE, BACKG);
-		// save current time for next comparison
+bool Render_Pending(void)
+{
+	return render.pending != 0;
 }
 
+//Work through queued screen updates for up to budget_ms, at least one step runs per call
+void Render_Task(uint32_t budget_ms)
+{
+	uint32_t start = HAL_GetTick();
+
+	while (render.pending) {
+		//the next step would only sit in Burst_Wait, let the event loop have the time instead
+		if (ILI9341_Burst_Busy()) return;
+
+		if (render.pending & RENDER_SCREEN) {
+			if (render.op->op != SCREEN_OP_END) {
+				Screen_Op_Draw(render.op++);
+			} else {
+				//push whatever the state drew to the panel in one burst per changed region
+				render.pending &= ~RENDER_SCREEN;
+				ILI9341_Flush();
+			}
+		} else if (render.pending & RENDER_RING) {
+			render.pending &= ~RENDER_RING;
+			Ring_Draw_Update();
+			ILI9341_Flush();
+		} else {
+			render.pending &= ~RENDER_TIMER;
+			Timer_Readout_Update(lockTimerGetTime());
+			ILI9341_Flush();
+		}
+
+		if (HAL_GetTick() - start >= budget_ms) return;
+	}
+}
 
-//Function to draw updated ring angle based on time
-void Ring_Update(){
+//Draw the updated ring angle based on time
+static void Ring_Draw_Update(void){
 	//get time
 	uint32_t time_ms = lockTimerGetTime();
-	// clear previous time area
-
-	// clear old time area
-	// draw new time
-	int rad = 80;
 
 	float frac = (float)time_ms/max_time_ms;
 	//convert time remaining to percentage and use it as degrees of ring
 	float deg = frac * 360.0;
+	if (deg > 360.0f) deg = 360.0f;
+	if (deg < 0.0f) deg = 0.0f;
+
+	if (!countdown_ring.drawn) {
+		//panel contents unknown: clear the whole band once and draw from 0
+		ILI9341_Draw_Arc(RING_X, RING_Y, RING_RAD - RING_WIDTH, RING_RAD, 0.0f, 360.0f, BACKG);
+		ILI9341_Draw_Arc(RING_X, RING_Y, RING_RAD - RING_WIDTH, RING_RAD, 0.0f, deg, RED);
+	} else if (deg < countdown_ring.deg) {
+		//time ran down: erase only the swept arc, keeping the pixels on the new edge
+		//(and on the 0 degree edge, which a full ring's 360 end shares)
+		ILI9341_Arc_Fill(RING_X, RING_Y, RING_RAD - RING_WIDTH, RING_RAD, deg, countdown_ring.deg,
+				true, countdown_ring.deg >= 360.0f, BACKG);
+	} else if (deg > countdown_ring.deg) {
+		//timer was extended: paint the arc gained since the last update
+		ILI9341_Draw_Arc(RING_X, RING_Y, RING_RAD - RING_WIDTH, RING_RAD, countdown_ring.deg, deg, RED);
+	}
 
-	//ILI9341_Draw_Rectangle(320/2 - rad,240/2 - rad,2 * rad,2 * rad,BACKG);
-
-	//bounding rectangles that cover entire ring to clear old ring
-	ILI9341_Draw_Rectangle(320/2 - rad,240/2 - rad,2 * rad ,rad - (get_text_height(FONT4)),BACKG);
-	ILI9341_Draw_Rectangle(320/2 - rad,240/2 + get_text_height(FONT4),2 * rad ,rad - (get_text_height(FONT4)),BACKG);
-
-	ILI9341_Draw_Rectangle(320/2 - rad -40,240/2 - 40 - get_text_height(FONT4),  rad,2 * rad,BACKG);
-	ILI9341_Draw_Rectangle(320/2 - rad + 80 + 40, 240/2 - 40 - get_text_height(FONT4),rad,2 * rad,BACKG);
-
-
-//	ILI9341_Draw_Rectangle(320/2 - rad,240/2 - rad,2 * rad,2 * rad,BACKG);
-	//draw new ring with calculated degrees
-	ILI9341_Draw_RingSector(320/2, 240/2, rad-3, rad, deg, RED);
-
-		// save current time for next comparison
+	countdown_ring.deg = deg;
+	countdown_ring.drawn = true;
+}
 
+//Draw the complete ring on a freshly cleared screen and remember it for Ring_Update
+static void Ring_Draw_Full(void){
+	ILI9341_Draw_Arc(RING_X, RING_Y, RING_RAD - RING_WIDTH, RING_RAD, 0.0f, 360.0f, RED);
+	countdown_ring.deg = 360.0f;
+	countdown_ring.drawn = true;
 }
 
 //debug version that just shows state name on screen
@@ -495,13 +517,17 @@ void screenResolveDebug(void) {
 
 		break;
 	}
+	ILI9341_Flush();
 }
 
-//general function to send a char via SPI
-void ILI9341_SPI_Send(unsigned char SPI_Data)
+static ILI9341_Stats stats;
+
+//blocking transmit of a few bytes, every non-DMA panel write goes through here
+static void ILI9341_SPI_Write(const uint8_t *Data, uint16_t Length)
 {
-	//transmit via our SPI instance
-	HAL_StatusTypeDef rc = HAL_SPI_Transmit(HSPI_INSTANCE, &SPI_Data, 1, 1);
+	HAL_StatusTypeDef rc = HAL_SPI_Transmit(HSPI_INSTANCE, (uint8_t *)Data, Length, 1);
+	stats.transactions++;
+	stats.bytes += Length;
 #ifdef DEBUG_DISPLAY
 	switch(rc) {
 	case HAL_OK:
@@ -516,48 +542,158 @@ void ILI9341_SPI_Send(unsigned char SPI_Data)
 		printf("[ERROR] SPI send failed to ILI9341, timeout occurred\n\r");
 		break;
 	}
+#else
+	(void)rc;
 #endif /*END DEBUG_DISPLAY*/
 }
 
+//general function to send a char via SPI
+void ILI9341_SPI_Send(unsigned char SPI_Data)
+{
+	//transmit via our SPI instance
+	ILI9341_SPI_Write(&SPI_Data, 1);
+}
+
+/*
+ * Command list
+ *	Register writes are queued as command + parameter entries and sent
+ *	under one CS assertion: DC low for each command byte, DC high and a
+ *	single transmit for its parameters, instead of a CS toggle and a
+ *	transmit per byte. The last CASET/PASET ranges sent are remembered so
+ *	a window that reuses the same columns or rows skips that command.
+ *	Raw ILI9341_Write_Command calls forget the window, since they may move
+ *	it or change how it is interpreted (MADCTL).
+ */
+#define ILI9341_CMD_LIST_MAX	4	//CASET, PASET, RAMWR and a spare
+#define ILI9341_CMD_PARAM_MAX	4
+
+typedef struct {
+	uint8_t command;
+	uint8_t length;
+	uint8_t param[ILI9341_CMD_PARAM_MAX];
+} ILI9341_Cmd;
+
+typedef struct {
+	ILI9341_Cmd entry[ILI9341_CMD_LIST_MAX];
+	uint8_t count;
+} ILI9341_Cmd_List;
+
+static struct {
+	uint16_t x1, x2, y1, y2;
+	bool cols_valid;
+	bool rows_valid;
+} panel_window;
+
+static void ILI9341_Cmd_Add(ILI9341_Cmd_List *list, uint8_t command, const uint8_t *param, uint8_t length)
+{
+	ILI9341_Cmd *cmd = &list->entry[list->count++];
+
+	cmd->command = command;
+	cmd->length = length;
+	if (length) memcpy(cmd->param, param, length);
+}
+
+//queue CASET/PASET for a window, leaving out whichever range the panel already has
+static void ILI9341_Cmd_Window(ILI9341_Cmd_List *list, uint16_t X1, uint16_t Y1, uint16_t X2, uint16_t Y2)
+{
+	if (!panel_window.cols_valid || panel_window.x1 != X1 || panel_window.x2 != X2) {
+		uint8_t cols[4] = {X1>>8, X1, X2>>8, X2};
+		ILI9341_Cmd_Add(list, 0x2A, cols, 4);
+		panel_window.x1 = X1;
+		panel_window.x2 = X2;
+		panel_window.cols_valid = true;
+	} else {
+		stats.caset_skipped++;
+	}
+
+	if (!panel_window.rows_valid || panel_window.y1 != Y1 || panel_window.y2 != Y2) {
+		uint8_t rows[4] = {Y1>>8, Y1, Y2>>8, Y2};
+		ILI9341_Cmd_Add(list, 0x2B, rows, 4);
+		panel_window.y1 = Y1;
+		panel_window.y2 = Y2;
+		panel_window.rows_valid = true;
+	} else {
+		stats.paset_skipped++;
+	}
+}
+
+static void ILI9341_Cmd_Send(const ILI9341_Cmd_List *list)
+{
+	ILI9341_Burst_Wait();
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	for (uint8_t i = 0; i < list->count; i++) {
+		const ILI9341_Cmd *cmd = &list->entry[i];
+		HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_RESET);
+		ILI9341_SPI_Write(&cmd->command, 1);
+		if (cmd->length) {
+			HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
+			ILI9341_SPI_Write(cmd->param, cmd->length);
+		}
+	}
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+	stats.cs_frames++;
+}
+
+const ILI9341_Stats *ILI9341_Get_Stats(void)
+{
+	return &stats;
+}
+
+void ILI9341_Clear_Stats(void)
+{
+	ILI9341_Burst_Wait();
+	memset(&stats, 0, sizeof(stats));
+}
+
 //function to sent one command via SPI
 void ILI9341_Write_Command(uint8_t Command)
 {
+	ILI9341_Burst_Wait();
+	panel_window.cols_valid = false;
+	panel_window.rows_valid = false;
 	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
 	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_RESET);
 	ILI9341_SPI_Send(Command);
 	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+	stats.cs_frames++;
 }
 
 //function to send one 8 bit int via SPI
 void ILI9341_Write_Data(uint8_t Data)
 {
+	ILI9341_Burst_Wait();
 	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
 	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
 	ILI9341_SPI_Send(Data);
 	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+	stats.cs_frames++;
 }
 
 //function to set address range to draw in
 void ILI9341_Set_Address(uint16_t X1, uint16_t Y1, uint16_t X2, uint16_t Y2)
 {
-	ILI9341_Write_Command(0x2A);
-	ILI9341_Write_Data(X1>>8);
-	ILI9341_Write_Data(X1);
-	ILI9341_Write_Data(X2>>8);
-	ILI9341_Write_Data(X2);
+	if (fb_enabled) {
+		ILI9341_FB_Set_Window(X1, Y1, X2, Y2);
+		return;
+	}
+	ILI9341_Set_Address_Panel(X1, Y1, X2, Y2);
+}
 
-	ILI9341_Write_Command(0x2B);
-	ILI9341_Write_Data(Y1>>8);
-	ILI9341_Write_Data(Y1);
-	ILI9341_Write_Data(Y2>>8);
-	ILI9341_Write_Data(Y2);
+//sends the CASET/PASET/RAMWR window straight to the panel as one command list
+static void ILI9341_Set_Address_Panel(uint16_t X1, uint16_t Y1, uint16_t X2, uint16_t Y2)
+{
+	ILI9341_Cmd_List list = { .count = 0 };
 
-	ILI9341_Write_Command(0x2C);
+	ILI9341_Cmd_Window(&list, X1, Y1, X2, Y2);
+	ILI9341_Cmd_Add(&list, 0x2C, NULL, 0);
+	ILI9341_Cmd_Send(&list);
 }
 
 /*HARDWARE RESET function*/
 void ILI9341_Reset(void)
 {
+	panel_window.cols_valid = false;
+	panel_window.rows_valid = false;
 	HAL_GPIO_WritePin(LCD_RST_PORT, LCD_RST_PIN, GPIO_PIN_RESET);
 	HAL_Delay(200);
 	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
@@ -598,47 +734,438 @@ void ILI9341_Set_Rotation(uint8_t rotation)
 	}
 }
 
-//Draw burst of color by setting address then providing the size and colors to fill
-void ILI9341_Draw_Colour_Burst(uint16_t Colour, uint32_t Size)
+/*
+ * DMA burst engine
+ *	Pixel data is streamed to the panel through two ping-pong line buffers.
+ *	While the DMA drains one buffer the other is refilled from the SPI TX
+ *	complete callback, so the main loop is free to keep running the event
+ *	system while a large fill is in flight. Anything else that talks to the
+ *	panel calls ILI9341_Burst_Wait() first so CS/DC are never touched mid burst.
+ *	Data that already sits in memory in panel order (flash images) skips the
+ *	buffers: the DMA reads it in place, one transfer per source row or per
+ *	ILI9341_DMA_MAX_TRANSFER bytes of a contiguous run.
+ */
+#define ILI9341_DMA_MAX_TRANSFER	0xFFFE	//HAL DMA length is 16 bit, kept pixel aligned
+
+typedef struct {
+	uint8_t buffer[2][ILI9341_LINE_BUFFER_SIZE];
+	volatile uint32_t staged[2];	//bytes ready to send in each buffer
+	volatile uint32_t pending;		//bytes not yet copied into a buffer
+	volatile uint8_t active;		//buffer the DMA is currently sending
+	volatile bool busy;
+	ILI9341_Fill_Callback fill;
+	void *context;
+	uint16_t colour;				//pattern held in the buffers when fill is NULL
+	bool colour_valid;
+	const uint8_t *src;				//direct mode: current source row, NULL otherwise
+	uint32_t src_row;				//bytes per source row
+	uint32_t src_stride;			//distance between source rows
+	uint32_t src_offset;			//bytes of the current row already sent
+	uint32_t src_rows;				//rows left, including the current one
+} ILI9341_Burst;
+
+static ILI9341_Burst burst;
+
+//copy the next chunk of the stream into buffer idx
+static void ILI9341_Burst_Stage(uint8_t idx)
 {
-	//SENDS COLOUR
-	uint32_t Buffer_Size = 0;
-	if((Size*2) < BURST_MAX_SIZE)
-	{
-		Buffer_Size = Size;
+	uint32_t len = burst.pending;
+	if (len > ILI9341_LINE_BUFFER_SIZE) len = ILI9341_LINE_BUFFER_SIZE;
+
+	if (len && burst.fill) {
+		burst.fill(burst.buffer[idx], len, burst.context);
 	}
-	else
-	{
-		Buffer_Size = BURST_MAX_SIZE;
+
+	burst.staged[idx] = len;
+	burst.pending -= len;
+}
+
+//release the panel once the last buffer has gone out
+static void ILI9341_Burst_Finish(void)
+{
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+	burst.busy = false;
+}
+
+static void ILI9341_Burst_Send(uint8_t idx)
+{
+	burst.active = idx;
+	stats.transactions++;
+	stats.bytes += burst.staged[idx];
+	if (HAL_SPI_Transmit_DMA(HSPI_INSTANCE, burst.buffer[idx], burst.staged[idx]) != HAL_OK) {
+#ifdef DEBUG_DISPLAY
+		printf("[ERROR] SPI DMA burst to ILI9341 failed to start\n\r");
+#endif /*END DEBUG_DISPLAY*/
+		burst.pending = 0;
+		ILI9341_Burst_Finish();
 	}
+}
+
+//DMA the next piece of the direct source, stepping to the next row once this one is out
+static void ILI9341_Burst_Send_Direct(void)
+{
+	const uint8_t *data = burst.src + burst.src_offset;
+	uint32_t len = burst.src_row - burst.src_offset;
+	if (len > ILI9341_DMA_MAX_TRANSFER) len = ILI9341_DMA_MAX_TRANSFER;
+
+	burst.src_offset += len;
+	if (burst.src_offset == burst.src_row) {
+		burst.src += burst.src_stride;
+		burst.src_offset = 0;
+		burst.src_rows--;
+	}
+
+	stats.transactions++;
+	stats.bytes += len;
+	if (HAL_SPI_Transmit_DMA(HSPI_INSTANCE, (uint8_t *)data, len) != HAL_OK) {
+#ifdef DEBUG_DISPLAY
+		printf("[ERROR] SPI DMA burst to ILI9341 failed to start\n\r");
+#endif /*END DEBUG_DISPLAY*/
+		burst.src = NULL;
+		ILI9341_Burst_Finish();
+	}
+}
+
+//start streaming Size bytes to the panel, fill is called to produce each chunk
+void ILI9341_Burst_Stream(ILI9341_Fill_Callback fill, void *context, uint32_t Size)
+{
+	ILI9341_Burst_Wait();
+	if (Size == 0) return;
+
+	//framebuffer mode runs the same producer but lands the bytes in RAM
+	if (fb_enabled && fill) {
+		burst.colour_valid = false;
+		while (Size) {
+			uint32_t len = Size > ILI9341_LINE_BUFFER_SIZE ? ILI9341_LINE_BUFFER_SIZE : Size;
+			fill(burst.buffer[0], len, context);
+			ILI9341_FB_Write_Bytes(burst.buffer[0], len);
+			Size -= len;
+		}
+		return;
+	}
+
+	burst.fill = fill;
+	burst.context = context;
+	burst.pending = Size;
+	if (fill) burst.colour_valid = false;
+
+	//both buffers are staged before the first transfer so the callback never sees an empty next buffer early
+	ILI9341_Burst_Stage(0);
+	ILI9341_Burst_Stage(1);
 
 	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
 	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
 
-	unsigned char chifted = 	Colour>>8;;
-	unsigned char burst_buffer[Buffer_Size];
-	for(uint32_t j = 0; j < Buffer_Size; j+=2)
-	{
-		burst_buffer[j] = 	chifted;
-		burst_buffer[j+1] = Colour;
+	burst.busy = true;
+	stats.cs_frames++;
+	ILI9341_Burst_Send(0);
+}
+
+//stream Rows rows of Row_Bytes each straight from Data, rows Stride bytes apart
+//Data is read by the DMA after this returns, so it has to stay put (flash assets always do)
+void ILI9341_Burst_Direct(const uint8_t *Data, uint32_t Row_Bytes, uint32_t Stride, uint32_t Rows)
+{
+	ILI9341_Burst_Wait();
+	if (Row_Bytes == 0 || Rows == 0) return;
+
+	if (fb_enabled) {
+		while (Rows--) {
+			ILI9341_FB_Write_Bytes(Data, Row_Bytes);
+			Data += Stride;
+		}
+		return;
+	}
+
+	//whole rows back to back are one contiguous run
+	if (Stride == Row_Bytes) {
+		Row_Bytes *= Rows;
+		Rows = 1;
 	}
 
-	uint32_t Sending_Size = Size*2;
-	uint32_t Sending_in_Block = Sending_Size/Buffer_Size;
-	uint32_t Remainder_from_block = Sending_Size%Buffer_Size;
+	burst.src = Data;
+	burst.src_row = Row_Bytes;
+	burst.src_stride = Stride;
+	burst.src_offset = 0;
+	burst.src_rows = Rows;
 
-	if(Sending_in_Block != 0)
-	{
-		for(uint32_t j = 0; j < (Sending_in_Block); j++)
-		{
-			HAL_SPI_Transmit(HSPI_INSTANCE, (unsigned char *)burst_buffer, Buffer_Size, 10);
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+
+	burst.busy = true;
+	stats.cs_frames++;
+	ILI9341_Burst_Send_Direct();
+}
+
+bool ILI9341_Burst_Busy(void)
+{
+	return burst.busy;
+}
+
+void ILI9341_Burst_Wait(void)
+{
+	while (burst.busy) {
+	}
+}
+
+//SPI TX complete: swap to the other buffer and refill the one that just drained
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi != HSPI_INSTANCE || !burst.busy) return;
+
+	if (burst.src) {
+		if (burst.src_rows) {
+			ILI9341_Burst_Send_Direct();
+		} else {
+			burst.src = NULL;
+			ILI9341_Burst_Finish();
 		}
+		return;
 	}
 
-	//REMAINDER!
-	HAL_SPI_Transmit(HSPI_INSTANCE, (unsigned char *)burst_buffer, Remainder_from_block, 10);
+	uint8_t done = burst.active;
+	uint8_t next = done ^ 1;
 
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+	if (burst.staged[next] == 0) {
+		ILI9341_Burst_Finish();
+		return;
+	}
+
+	burst.staged[done] = 0;
+	ILI9341_Burst_Send(next);
+	ILI9341_Burst_Stage(done);
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi != HSPI_INSTANCE) return;
+#ifdef DEBUG_DISPLAY
+	printf("[ERROR] SPI DMA burst to ILI9341 aborted, code %lu\n\r", hspi->ErrorCode);
+#endif /*END DEBUG_DISPLAY*/
+	burst.pending = 0;
+	burst.src = NULL;
+	ILI9341_Burst_Finish();
+}
+
+//Draw burst of color by setting address then providing the size and colors to fill
+void ILI9341_Draw_Colour_Burst(uint16_t Colour, uint32_t Size)
+{
+	if (fb_enabled) {
+		ILI9341_FB_Write_Colour(Colour, Size);
+		return;
+	}
+
+	ILI9341_Burst_Wait();
+
+	//a solid colour only needs the pattern written once, both buffers are then resent as is
+	if (!burst.colour_valid || burst.colour != Colour) {
+		for (uint32_t j = 0; j < ILI9341_LINE_BUFFER_SIZE; j += 2) {
+			burst.buffer[0][j] = Colour >> 8;
+			burst.buffer[0][j+1] = Colour;
+		}
+		memcpy(burst.buffer[1], burst.buffer[0], ILI9341_LINE_BUFFER_SIZE);
+		burst.colour = Colour;
+		burst.colour_valid = true;
+	}
+
+	ILI9341_Burst_Stream(NULL, NULL, Size * 2);
+}
+
+/*
+ * Off-screen framebuffer
+ *	A full RGB565 frame lives in the otherwise unused SRAM1 bank (see the
+ *	.framebuffer section in the linker scripts). While enabled, Set_Address
+ *	opens a window in RAM that walks like the panel's GRAM and every burst
+ *	lands there instead of on the SPI bus. Touched windows are recorded as
+ *	dirty rectangles and ILI9341_Flush() sends each one with a single
+ *	address window and burst. Pixels are stored in panel byte order so a
+ *	row can be copied to the SPI buffers without swapping.
+ */
+#define FB_PIXELS (LCD_WIDTH_1 * LCD_HEIGHT_1)
+#define FB_SWAP(c) ((uint16_t)(((c) >> 8) | ((c) << 8)))
+
+typedef struct {
+	uint16_t x1, y1, x2, y2;
+} ILI9341_Rect;
+
+static uint16_t framebuffer[FB_PIXELS] __attribute__((section(".framebuffer"), aligned(4)));
+
+static struct {
+	ILI9341_Rect area;
+	uint16_t x, y;	//GRAM style write cursor
+	bool valid;
+} fb_window;
+
+static ILI9341_Rect fb_dirty[ILI9341_MAX_DIRTY];
+static uint8_t fb_dirty_count;
+
+static uint32_t ILI9341_Rect_Area(const ILI9341_Rect *r)
+{
+	return (uint32_t)(r->x2 - r->x1 + 1) * (r->y2 - r->y1 + 1);
+}
+
+static ILI9341_Rect ILI9341_Rect_Union(const ILI9341_Rect *a, const ILI9341_Rect *b)
+{
+	ILI9341_Rect u;
+	u.x1 = a->x1 < b->x1 ? a->x1 : b->x1;
+	u.y1 = a->y1 < b->y1 ? a->y1 : b->y1;
+	u.x2 = a->x2 > b->x2 ? a->x2 : b->x2;
+	u.y2 = a->y2 > b->y2 ? a->y2 : b->y2;
+	return u;
+}
+
+//records a changed region, merging overlaps and folding into the cheapest rect once the list is full
+static void ILI9341_FB_Mark_Dirty(ILI9341_Rect rect)
+{
+	for (uint8_t i = 0; i < fb_dirty_count; ++i) {
+		ILI9341_Rect *d = &fb_dirty[i];
+		if (rect.x1 <= d->x2 + 1 && rect.x2 + 1 >= d->x1 && rect.y1 <= d->y2 + 1 && rect.y2 + 1 >= d->y1) {
+			*d = ILI9341_Rect_Union(d, &rect);
+			return;
+		}
+	}
+
+	if (fb_dirty_count < ILI9341_MAX_DIRTY) {
+		fb_dirty[fb_dirty_count++] = rect;
+		return;
+	}
+
+	uint8_t best = 0;
+	uint32_t best_growth = UINT32_MAX;
+	for (uint8_t i = 0; i < fb_dirty_count; ++i) {
+		ILI9341_Rect u = ILI9341_Rect_Union(&fb_dirty[i], &rect);
+		uint32_t growth = ILI9341_Rect_Area(&u) - ILI9341_Rect_Area(&fb_dirty[i]);
+		if (growth < best_growth) {
+			best_growth = growth;
+			best = i;
+		}
+	}
+	fb_dirty[best] = ILI9341_Rect_Union(&fb_dirty[best], &rect);
+}
+
+static void ILI9341_FB_Set_Window(uint16_t X1, uint16_t Y1, uint16_t X2, uint16_t Y2)
+{
+	if (X2 >= LCD_WIDTH) X2 = LCD_WIDTH - 1;
+	if (Y2 >= LCD_HEIGHT) Y2 = LCD_HEIGHT - 1;
+
+	fb_window.valid = (X1 <= X2) && (Y1 <= Y2);
+	if (!fb_window.valid) return;
+
+	fb_window.area = (ILI9341_Rect){X1, Y1, X2, Y2};
+	fb_window.x = X1;
+	fb_window.y = Y1;
+	ILI9341_FB_Mark_Dirty(fb_window.area);
+}
+
+//moves the window cursor forward n pixels along the current row, wrapping like GRAM
+static inline void ILI9341_FB_Advance(uint32_t n)
+{
+	fb_window.x += n;
+	if (fb_window.x > fb_window.area.x2) {
+		fb_window.x = fb_window.area.x1;
+		if (++fb_window.y > fb_window.area.y2) fb_window.y = fb_window.area.y1;
+	}
+}
+
+static void ILI9341_FB_Write_Colour(uint16_t Colour, uint32_t Size)
+{
+	if (!fb_window.valid) return;
+	uint16_t c = FB_SWAP(Colour);
+
+	while (Size) {
+		uint32_t n = fb_window.area.x2 - fb_window.x + 1;
+		if (n > Size) n = Size;
+
+		uint16_t *dst = &framebuffer[fb_window.y * LCD_WIDTH + fb_window.x];
+		for (uint32_t i = 0; i < n; ++i) dst[i] = c;
+
+		ILI9341_FB_Advance(n);
+		Size -= n;
+	}
+}
+
+//Data is a panel ordered byte stream (MSB first), Length is always whole pixels
+static void ILI9341_FB_Write_Bytes(const uint8_t *Data, uint32_t Length)
+{
+	if (!fb_window.valid) return;
+
+	while (Length >= 2) {
+		uint32_t n = fb_window.area.x2 - fb_window.x + 1;
+		if (n > Length / 2) n = Length / 2;
+
+		memcpy(&framebuffer[fb_window.y * LCD_WIDTH + fb_window.x], Data, n * 2);
+
+		ILI9341_FB_Advance(n);
+		Data += n * 2;
+		Length -= n * 2;
+	}
+}
+
+static void ILI9341_FB_Draw_Pixel(uint16_t X, uint16_t Y, uint16_t Colour)
+{
+	framebuffer[Y * LCD_WIDTH + X] = FB_SWAP(Colour);
+	ILI9341_FB_Mark_Dirty((ILI9341_Rect){X, Y, X, Y});
+}
+
+//walks one dirty rect row by row for the burst engine
+static struct {
+	ILI9341_Rect rect;
+	uint32_t offset;	//bytes already produced
+} fb_reader;
+
+static void ILI9341_FB_Fill(uint8_t *Buffer, uint32_t Length, void *Context)
+{
+	(void)Context;
+	uint32_t row_bytes = (fb_reader.rect.x2 - fb_reader.rect.x1 + 1) * 2;
+
+	while (Length) {
+		uint32_t row = fb_reader.offset / row_bytes;
+		uint32_t col = fb_reader.offset % row_bytes;
+		uint32_t n = row_bytes - col;
+		if (n > Length) n = Length;
+
+		const uint8_t *src = (const uint8_t *)&framebuffer[(fb_reader.rect.y1 + row) * LCD_WIDTH + fb_reader.rect.x1];
+		memcpy(Buffer, src + col, n);
+
+		Buffer += n;
+		Length -= n;
+		fb_reader.offset += n;
+	}
+}
+
+void ILI9341_Framebuffer_Enable(bool enable)
+{
+	if (enable == fb_enabled) return;
+
+	//anything drawn before switching off must reach the panel first
+	if (!enable) ILI9341_Flush();
+
+	fb_enabled = enable;
+	fb_window.valid = false;
+}
+
+bool ILI9341_Framebuffer_Enabled(void)
+{
+	return fb_enabled;
+}
+
+//streams every dirty rect to the panel, the last burst is left running on the DMA
+void ILI9341_Flush(void)
+{
+	for (uint8_t i = 0; i < fb_dirty_count; ++i) {
+		ILI9341_Rect *r = &fb_dirty[i];
+
+		//the next Set_Address waits for the previous burst, so the reader is free to reuse
+		ILI9341_Set_Address_Panel(r->x1, r->y1, r->x2, r->y2);
+		fb_reader.rect = *r;
+		fb_reader.offset = 0;
+
+		bool was_enabled = fb_enabled;
+		fb_enabled = false;
+		ILI9341_Burst_Stream(ILI9341_FB_Fill, NULL, ILI9341_Rect_Area(r) * 2);
+		fb_enabled = was_enabled;
+	}
+
+	fb_dirty_count = 0;
 }
 
 
@@ -792,11 +1319,18 @@ void ILI9341_Init(void)
 void ILI9341_Draw_Colour(uint16_t Colour)
 {
 	//SENDS COLOUR
+	if (fb_enabled) {
+		ILI9341_FB_Write_Colour(Colour, 1);
+		return;
+	}
+
+	ILI9341_Burst_Wait();
 	unsigned char TempBuffer[2] = {Colour>>8, Colour};
 	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
 	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
-	HAL_SPI_Transmit(HSPI_INSTANCE, TempBuffer, 2, 1);
+	ILI9341_SPI_Write(TempBuffer, 2);
 	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+	stats.cs_frames++;
 }
 
 void ILI9341_Fill_Screen(uint16_t Colour)
@@ -808,45 +1342,17 @@ void ILI9341_Fill_Screen(uint16_t Colour)
 void ILI9341_Draw_Pixel(uint16_t X,uint16_t Y,uint16_t Colour)
 {
 	if((X >=LCD_WIDTH) || (Y >=LCD_HEIGHT)) return;	//OUT OF BOUNDS!
+	if (fb_enabled) {
+		ILI9341_FB_Draw_Pixel(X, Y, Colour);
+		return;
+	}
 
-	//ADDRESS
-	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_RESET);
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
-	ILI9341_SPI_Send(0x2A);
-	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
-
-	//XDATA
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
-	unsigned char Temp_Buffer[4] = {X>>8,X, (X+1)>>8, (X+1)};
-	HAL_SPI_Transmit(HSPI_INSTANCE, Temp_Buffer, 4, 1);
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
-
-	//ADDRESS
-	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_RESET);
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
-	ILI9341_SPI_Send(0x2B);
-	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
-
-	//YDATA
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
-	unsigned char Temp_Buffer1[4] = {Y>>8,Y, (Y+1)>>8, (Y+1)};
-	HAL_SPI_Transmit(HSPI_INSTANCE, Temp_Buffer1, 4, 1);
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
-
-	//ADDRESS
-	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_RESET);
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
-	ILI9341_SPI_Send(0x2C);
-	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
-
-	//COLOUR
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
-	unsigned char Temp_Buffer2[2] = {Colour>>8, Colour};
-	HAL_SPI_Transmit(HSPI_INSTANCE, Temp_Buffer2, 2, 1);
-	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+	//window, RAMWR and the pixel itself go out in one CS frame
+	ILI9341_Cmd_List list = { .count = 0 };
+	unsigned char Temp_Buffer[2] = {Colour>>8, Colour};
+	ILI9341_Cmd_Window(&list, X, Y, X, Y);
+	ILI9341_Cmd_Add(&list, 0x2C, Temp_Buffer, 2);
+	ILI9341_Cmd_Send(&list);
 
 }
 
@@ -920,92 +1426,142 @@ void ILI9341_Draw_Lock(uint16_t X, uint16_t Y, uint16_t Size, uint16_t Colour,bo
 
 
 
-//Draw singular char
-void ILI9341_Draw_Char(char ch, const uint8_t font[], uint16_t X, uint16_t Y, uint16_t color, uint16_t bgcolor)
+/*
+ * Text runs
+ *	Glyphs are rasterized straight into the burst line buffers: a whole
+ *	string gets one address window and the fill callback expands the font
+ *	bitmap row by row into RGB565 (background included), so a text run costs
+ *	one CASET/PASET/RAMWR and one burst instead of a window per pixel.
+ */
+static struct {
+	char str[ILI9341_TEXT_RUN_MAX];	//private copy, callers may reuse their buffer while the burst runs
+	uint8_t len;
+	const uint8_t *font;
+	uint16_t width;		//window width in pixels
+	uint16_t color;
+	uint16_t bgcolor;
+	uint32_t pixel;		//next pixel of the window to produce
+} text_run;
+
+//horizontal advance of a character, matches the spacing Draw_Text has always used
+static uint8_t ILI9341_Char_Advance(char ch, const uint8_t font[])
 {
-	if ((ch < 31) || (ch > 127)) return;
+	uint8_t fOffset = font[0];	/* Offset of character */
+	uint8_t fWidth = font[1];	/* Width of font */
+	uint8_t charWidth = font[((ch - 0x20) * fOffset) + 4];	/* Width of character */
 
-	uint8_t fOffset, fWidth, fHeight, fBPL;
-	uint8_t *tempChar;
+	/* If character width is smaller than font width */
+	return (charWidth + 2 < fWidth) ? charWidth + 2 : fWidth;
+}
 
-	fOffset = font[0];
-	fWidth = font[1];
-	fHeight = font[2];
-	fBPL = font[3];
+//true when column i, row j of the glyph for ch is set
+static bool ILI9341_Glyph_Bit(char ch, const uint8_t font[], uint16_t i, uint16_t j)
+{
+	uint8_t fOffset = font[0];	/* Offset of character */
+	uint8_t fBPL = font[3];		/* Bytes per line */
 
-	tempChar = (uint8_t*)&font[((ch - 0x20) * fOffset) + 4]; /* Current Character = Meta + (Character Index * Offset) */
+	if (ch < 0x20 || ch > 127 || i >= font[1]) return false;
+	const uint8_t *tempChar = &font[((ch - 0x20) * fOffset) + 4];
+	uint8_t z = tempChar[fBPL * i + ((j & 0xF8) >> 3) + 1]; /* (j & 0xF8) >> 3, increase one by 8-bits */
+	return (z & (1 << (j & 0x07))) != 0;
+}
 
-	/* Clear background first */
-	ILI9341_Draw_Rectangle(X, Y, fWidth, fHeight, bgcolor);
+static void ILI9341_Text_Fill(uint8_t *Buffer, uint32_t Length, void *Context)
+{
+	(void)Context;
+
+	while (Length >= 2) {
+		uint16_t j = text_run.pixel / text_run.width;	//row inside the run
+		uint16_t x = text_run.pixel % text_run.width;	//column inside the run
+		uint16_t row_end = text_run.width;
+		if (row_end - x > Length / 2) row_end = x + Length / 2;
+
+		//find the glyph under x, then emit pixels until the row or chunk ends
+		uint8_t c = 0;
+		uint16_t ch_x = 0;
+		while (c < text_run.len && x >= ch_x + ILI9341_Char_Advance(text_run.str[c], text_run.font)) {
+			ch_x += ILI9341_Char_Advance(text_run.str[c], text_run.font);
+			++c;
+		}
 
-	for (int j=0; j < fHeight; j++)
-	{
-		for (int i=0; i < fWidth; i++)
-		{
-			uint8_t z =  tempChar[fBPL * i + ((j & 0xF8) >> 3) + 1]; /* (j & 0xF8) >> 3, increase one by 8-bits */
-			uint8_t b = 1 << (j & 0x07);
-			if (( z & b ) != 0x00)
-			{
-				ILI9341_Draw_Pixel(X+i, Y+j, color);
+		while (x < row_end) {
+			uint16_t colour = text_run.bgcolor;
+
+			if (c < text_run.len) {
+				char ch = text_run.str[c];
+				uint8_t advance = ILI9341_Char_Advance(ch, text_run.font);
+
+				if (x >= ch_x + advance && c + 1 < text_run.len) {
+					ch_x += advance;
+					ch = text_run.str[++c];
+				}
+
+				if (ILI9341_Glyph_Bit(ch, text_run.font, x - ch_x, j)) colour = text_run.color;
 			}
+
+			*Buffer++ = colour >> 8;
+			*Buffer++ = colour;
+			++x;
+			++text_run.pixel;
+			Length -= 2;
 		}
 	}
 }
 
-//function to draw text via calls of draw char
-void ILI9341_Draw_Text(const char* str, const uint8_t font[], uint16_t X, uint16_t Y, uint16_t color, uint16_t bgcolor)
+//opens one window for the run and streams it, clipped to the screen
+static void ILI9341_Draw_Text_Run(const char* str, uint8_t len, uint16_t width, const uint8_t font[], uint16_t X, uint16_t Y, uint16_t color, uint16_t bgcolor)
 {
-	uint8_t charWidth;			/* Width of character */
-	uint8_t fOffset = font[0];	/* Offset of character */
-	uint8_t fWidth = font[1];	/* Width of font */
+	uint16_t height = font[2];
+
+	if ((X >= LCD_WIDTH) || (Y >= LCD_HEIGHT) || len == 0 || width == 0) return;
+	if (X + width > LCD_WIDTH) width = LCD_WIDTH - X;
+	if (Y + height > LCD_HEIGHT) height = LCD_HEIGHT - Y;
+
+	//the run state is read from the DMA callback, wait until the previous run is out
+	ILI9341_Burst_Wait();
+	if (len > ILI9341_TEXT_RUN_MAX) len = ILI9341_TEXT_RUN_MAX;
+	memcpy(text_run.str, str, len);
+	text_run.len = len;
+	text_run.font = font;
+	text_run.width = width;
+	text_run.color = color;
+	text_run.bgcolor = bgcolor;
+	text_run.pixel = 0;
+
+	ILI9341_Set_Address(X, Y, X + width - 1, Y + height - 1);
+	ILI9341_Burst_Stream(ILI9341_Text_Fill, NULL, (uint32_t)width * height * 2);
+}
 
-	while (*str)
-	{
-		ILI9341_Draw_Char(*str, font, X, Y, color, bgcolor);
+//Draw singular char, the whole font cell is painted so the background is cleared too
+void ILI9341_Draw_Char(char ch, const uint8_t font[], uint16_t X, uint16_t Y, uint16_t color, uint16_t bgcolor)
+{
+	if ((ch < 31) || (ch > 127)) return;
 
-		/* Check character width and calculate proper position */
-		uint8_t *tempChar = (uint8_t*)&font[((*str - 0x20) * fOffset) + 4];
-		charWidth = tempChar[0];
+	ILI9341_Draw_Text_Run(&ch, 1, font[1], font, X, Y, color, bgcolor);
+}
 
-		if(charWidth + 2 < fWidth)
-		{
-			/* If character width is smaller than font width */
-			X += (charWidth + 2);
-		}
-		else
-		{
-			X += fWidth;
-		}
+//function to draw a string as a single text run
+void ILI9341_Draw_Text(const char* str, const uint8_t font[], uint16_t X, uint16_t Y, uint16_t color, uint16_t bgcolor)
+{
+	size_t len = strlen(str);
+	uint16_t width = 0;
 
-		str++;
+	if (len > ILI9341_TEXT_RUN_MAX) len = ILI9341_TEXT_RUN_MAX;
+	for (size_t i = 0; i < len; ++i) {
+		width += ILI9341_Char_Advance(str[i], font);
 	}
+
+	ILI9341_Draw_Text_Run(str, len, width, font, X, Y, color, bgcolor);
 }
 
 //simulate string draw to get width
 int get_text_width(const char* str, const uint8_t font[])
 {
 	int width = 0;
-	uint8_t charWidth;			/* Width of character */
-	uint8_t fOffset = font[0];	/* Offset of character */
-	uint8_t fWidth = font[1];	/* Width of font */
 
 	while (*str)
 	{
-
-		/* Check character width and calculate proper position */
-		uint8_t *tempChar = (uint8_t*)&font[((*str - 0x20) * fOffset) + 4];
-		charWidth = tempChar[0];
-
-		if(charWidth + 2 < fWidth)
-		{
-			/* If character width is smaller than font width */
-			width += (charWidth + 2);
-		}
-		else
-		{
-			width += fWidth;
-		}
-
+		width += ILI9341_Char_Advance(*str, font);
 		str++;
 	}
 	return width;
@@ -1016,95 +1572,394 @@ int get_text_height(const uint8_t font[]){
 	return font[2];
 }
 
+/*
+ * Glyph atlas for the timer readout: 0-9 and ':' in FONT4, pre-rendered to
+ * RGB565 in panel byte order the first time the readout is drawn. Every
+ * digit gets the same cell width so a changing digit never moves its
+ * neighbours; a cell is then one window and one streamed copy.
+ */
+#define ATLAS_FONT		FONT4
+#define ATLAS_HEIGHT		19				// FONT4 height
+#define ATLAS_DIGIT_W		10				// widest FONT4 digit advance
+#define ATLAS_COLON_W		4				// FONT4 ':' advance
+#define ATLAS_DIGIT_BYTES	(ATLAS_DIGIT_W * ATLAS_HEIGHT * 2)
+#define ATLAS_COLON_BYTES	(ATLAS_COLON_W * ATLAS_HEIGHT * 2)
+#define TIMER_WIDTH		(6 * ATLAS_DIGIT_W + 2 * ATLAS_COLON_W)
+#define TIMER_X			((320 - TIMER_WIDTH) / 2)
+#define TIMER_Y			((240 - ATLAS_HEIGHT) / 2)
+
+static struct {
+	uint8_t digit[10][ATLAS_DIGIT_BYTES];
+	uint8_t colon[ATLAS_COLON_BYTES];
+	uint16_t color;
+	uint16_t bgcolor;
+	bool ready;
+} glyph_atlas;
+
+//source for the cell being streamed, read from the DMA callback
+static const uint8_t *atlas_src;
+
+//render one glyph into a cell, centred on its advance
+static void Atlas_Render(uint8_t *cell, uint16_t cell_w, char ch)
+{
+	uint16_t off = (cell_w - ILI9341_Char_Advance(ch, ATLAS_FONT)) / 2;
+
+	for (uint16_t j = 0; j < ATLAS_HEIGHT; j++) {
+		for (uint16_t x = 0; x < cell_w; x++) {
+			uint16_t colour = glyph_atlas.bgcolor;
+			if (x >= off && ILI9341_Glyph_Bit(ch, ATLAS_FONT, x - off, j)) colour = glyph_atlas.color;
+			*cell++ = colour >> 8;
+			*cell++ = colour;
+		}
+	}
+}
+
+static void Atlas_Build(uint16_t color, uint16_t bgcolor)
+{
+	if (glyph_atlas.ready && glyph_atlas.color == color && glyph_atlas.bgcolor == bgcolor) return;
+
+	//a cell may still be streaming out of the old atlas
+	ILI9341_Burst_Wait();
+	glyph_atlas.color = color;
+	glyph_atlas.bgcolor = bgcolor;
+	for (uint8_t d = 0; d < 10; d++) {
+		Atlas_Render(glyph_atlas.digit[d], ATLAS_DIGIT_W, '0' + d);
+	}
+	Atlas_Render(glyph_atlas.colon, ATLAS_COLON_W, ':');
+	glyph_atlas.ready = true;
+}
+
+static void Atlas_Fill(uint8_t *Buffer, uint32_t Length, void *Context)
+{
+	(void)Context;
+	memcpy(Buffer, atlas_src, Length);
+	atlas_src += Length;
+}
+
+static void Atlas_Blit(char ch, uint16_t X, uint16_t Y)
+{
+	uint16_t w = (ch == ':') ? ATLAS_COLON_W : ATLAS_DIGIT_W;
+
+	ILI9341_Burst_Wait();
+	atlas_src = (ch == ':') ? glyph_atlas.colon : glyph_atlas.digit[ch - '0'];
+	ILI9341_Set_Address(X, Y, X + w - 1, Y + ATLAS_HEIGHT - 1);
+	ILI9341_Burst_Stream(Atlas_Fill, NULL, (uint32_t)w * ATLAS_HEIGHT * 2);
+}
+
+//draw the remaining time as HH:MM:SS, sending only the cells that changed
+static void Timer_Readout_Update(uint32_t ms_time)
+{
+	char cells[TIMER_CELLS];
+	uint32_t total_seconds = ms_time / 1000;
+	uint32_t hours = total_seconds / 3600;
+	uint32_t minutes = (total_seconds % 3600) / 60;
+	uint32_t seconds = total_seconds % 60;
+	uint16_t x = TIMER_X;
+
+	if (hours > 99) hours = 99;
+	cells[0] = '0' + hours / 10;
+	cells[1] = '0' + hours % 10;
+	cells[2] = ':';
+	cells[3] = '0' + minutes / 10;
+	cells[4] = '0' + minutes % 10;
+	cells[5] = ':';
+	cells[6] = '0' + seconds / 10;
+	cells[7] = '0' + seconds % 10;
+
+	Atlas_Build(WHITE, BACKG);
+	for (uint8_t c = 0; c < TIMER_CELLS; c++) {
+		if (!timer_readout.drawn || cells[c] != timer_readout.shown[c]) {
+			Atlas_Blit(cells[c], x, TIMER_Y);
+			timer_readout.shown[c] = cells[c];
+		}
+		x += (cells[c] == ':') ? ATLAS_COLON_W : ATLAS_DIGIT_W;
+	}
+	timer_readout.drawn = true;
+}
+
 /*Draws a full screen picture from flash. Image converted from RGB .jpeg/other to C array using online converter*/
 //USING CONVERTER: http://www.digole.com/tools/PicturetoC_Hex_converter.php
 //65K colour (2Bytes / Pixel)
 void ILI9341_Draw_Image(const char* Image_Array, uint8_t Orientation)
 {
-	if(Orientation == SCREEN_HORIZONTAL_1)
-	{
-		ILI9341_Set_Rotation(SCREEN_HORIZONTAL_1);
-		ILI9341_Set_Address(0,0,LCD_WIDTH,LCD_HEIGHT);
-
-		HAL_GPIO_WritePin(LCD_DC_PORT,LCD_DC_PIN, GPIO_PIN_SET);
-		HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
-		unsigned char Temp_small_buffer[BURST_MAX_SIZE];
-		uint32_t counter = 0;
-		for(uint32_t i = 0; i < LCD_WIDTH*LCD_HEIGHT*2/BURST_MAX_SIZE; i++)
-		{
-			for(uint32_t k = 0; k< BURST_MAX_SIZE; k++)
-			{
-				Temp_small_buffer[k]	= Image_Array[counter+k];
+	//a full screen image is just a blit of the whole thing in the requested rotation
+	ILI9341_Set_Rotation(Orientation);
+	ILI9341_Draw_Image_Rect((const uint8_t *)Image_Array, LCD_WIDTH, 0, 0, LCD_WIDTH, LCD_HEIGHT, 0, 0);
+}
+
+//blit Width x Height pixels from (Src_X,Src_Y) of an Image_Width wide RGB565 image to X,Y
+//the pixels are DMA'd straight out of Image, one transfer per row (or one for full rows)
+void ILI9341_Draw_Image_Rect(const uint8_t *Image, uint16_t Image_Width, uint16_t Src_X, uint16_t Src_Y, uint16_t Width, uint16_t Height, uint16_t X, uint16_t Y)
+{
+	if ((X >= LCD_WIDTH) || (Y >= LCD_HEIGHT) || Width == 0 || Height == 0) return;
+	if ((X+Width-1) >= LCD_WIDTH) Width = LCD_WIDTH - X;
+	if ((Y+Height-1) >= LCD_HEIGHT) Height = LCD_HEIGHT - Y;
+
+	ILI9341_Set_Address(X, Y, X+Width-1, Y+Height-1);
+	ILI9341_Burst_Direct(&Image[((uint32_t)Src_Y * Image_Width + Src_X) * 2], (uint32_t)Width * 2, (uint32_t)Image_Width * 2, Height);
+}
+
+/*
+ * Packed images
+ *	Assets packed by tools/rgb565_pack.py (op layout documented there) are
+ *	decoded while they stream: the burst fill callback expands the next
+ *	line of pixels straight into the DMA buffer, so the only RAM this needs
+ *	is the decoder state below on top of the existing line buffers.
+ */
+#define PACKED_R(px)	(((px) >> 11) & 0x1F)
+#define PACKED_G(px)	(((px) >> 5) & 0x3F)
+#define PACKED_B(px)	((px) & 0x1F)
+#define PACKED_RGB(r, g, b)	((uint16_t)((((r) & 0x1F) << 11) | (((g) & 0x3F) << 5) | ((b) & 0x1F)))
+#define PACKED_HASH(px)	((PACKED_R(px) * 3 + PACKED_G(px) * 5 + PACKED_B(px) * 7) & 63)
+
+static struct {
+	const uint8_t *src;
+	const uint8_t *end;
+	uint16_t prev;
+	uint16_t index[64];
+	uint8_t run;		//repeats of prev still owed
+	uint8_t literals;	//raw pixels still to read
+} packed;
+
+static uint16_t ILI9341_Packed_Next(void)
+{
+	uint16_t px;
+
+	if (packed.run) {
+		packed.run--;
+		return packed.prev;
+	}
+
+	if (packed.literals) {
+		if (packed.end - packed.src < 2) return packed.prev;	//truncated, hold the last colour
+		packed.literals--;
+		px = (packed.src[0] << 8) | packed.src[1];
+		packed.src += 2;
+	} else {
+		if (packed.src >= packed.end) return packed.prev;
+		uint8_t op = *packed.src++;
+		uint16_t prev = packed.prev;
+
+		switch (op >> 6) {
+		case 0:	//RUN
+			packed.run = op & 0x3F;
+			return prev;
+		case 1:	//INDEX
+			px = packed.index[op & 0x3F];
+			break;
+		case 2:	//DIFF
+			px = PACKED_RGB(PACKED_R(prev) + ((op >> 4) & 3) - 2,
+					PACKED_G(prev) + ((op >> 2) & 3) - 2,
+					PACKED_B(prev) + (op & 3) - 2);
+			break;
+		default:
+			if ((op & 0xE0) == 0xE0) {	//LITERAL
+				packed.literals = (op & 0x1F) + 1;
+				return ILI9341_Packed_Next();
 			}
-			HAL_SPI_Transmit(&hspi1, (unsigned char*)Temp_small_buffer, BURST_MAX_SIZE, 10);
-			counter += BURST_MAX_SIZE;
+			//LUMA
+			if (packed.src >= packed.end) return prev;
+			int8_t dg = (op & 0x1F) - 16;
+			uint8_t rb = *packed.src++;
+			px = PACKED_RGB(PACKED_R(prev) + dg + (rb >> 4) - 8,
+					PACKED_G(prev) + dg,
+					PACKED_B(prev) + dg + (rb & 0x0F) - 8);
+			break;
 		}
-		HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
 	}
-	else if(Orientation == SCREEN_HORIZONTAL_2)
-	{
-		ILI9341_Set_Rotation(SCREEN_HORIZONTAL_2);
-		ILI9341_Set_Address(0,0,LCD_WIDTH,LCD_HEIGHT);
 
-		HAL_GPIO_WritePin(LCD_DC_PORT,LCD_DC_PIN, GPIO_PIN_SET);
-		HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	packed.index[PACKED_HASH(px)] = px;
+	packed.prev = px;
+	return px;
+}
 
-		unsigned char Temp_small_buffer[BURST_MAX_SIZE];
-		uint32_t counter = 0;
-		for(uint32_t i = 0; i < LCD_WIDTH*LCD_HEIGHT*2/BURST_MAX_SIZE; i++)
-		{
-			for(uint32_t k = 0; k< BURST_MAX_SIZE; k++)
-			{
-				Temp_small_buffer[k]	= Image_Array[counter+k];
-			}
-			HAL_SPI_Transmit(&hspi1, (unsigned char*)Temp_small_buffer, BURST_MAX_SIZE, 10);
-			counter += BURST_MAX_SIZE;
-		}
-		HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+static void ILI9341_Packed_Fill(uint8_t *Buffer, uint32_t Length, void *Context)
+{
+	(void)Context;
+	for (; Length >= 2; Length -= 2) {
+		uint16_t px = ILI9341_Packed_Next();
+		*Buffer++ = px >> 8;
+		*Buffer++ = px;
 	}
-	else if(Orientation == SCREEN_VERTICAL_2)
-	{
-		ILI9341_Set_Rotation(SCREEN_VERTICAL_2);
-		ILI9341_Set_Address(0,0,LCD_HEIGHT,LCD_WIDTH);
+}
 
-		HAL_GPIO_WritePin(LCD_DC_PORT,LCD_DC_PIN, GPIO_PIN_SET);
-		HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+//decode and stream a packed image with its top left corner at X,Y
+void ILI9341_Draw_Packed_Image(const ILI9341_Packed_Image *Image, uint16_t X, uint16_t Y)
+{
+	uint16_t height = Image->height;
+
+	//rows follow each other in the stream, so only the bottom can be clipped
+	if ((X + Image->width > LCD_WIDTH) || (Y >= LCD_HEIGHT) || Image->width == 0) return;
+	if (Y + height > LCD_HEIGHT) height = LCD_HEIGHT - Y;
+
+	//the decoder state is read from the DMA callback, wait until the previous burst is out
+	ILI9341_Burst_Wait();
+	packed.src = Image->data;
+	packed.end = Image->data + Image->size;
+	packed.prev = 0;
+	packed.run = 0;
+	packed.literals = 0;
+	memset(packed.index, 0, sizeof(packed.index));
+
+	ILI9341_Set_Address(X, Y, X + Image->width - 1, Y + height - 1);
+	ILI9341_Burst_Stream(ILI9341_Packed_Fill, NULL, (uint32_t)Image->width * height * 2);
+}
+/*
+ * Span rasterizer. Discs, rings and arcs are emitted as horizontal spans,
+ * one address window and one burst per run of pixels on a scanline, all
+ * through ILI9341_Emit_Span. Arc membership is the pair of half-plane tests
+ * cross(A,P) >= 0 and cross(P,B) >= 0 against the start and end direction
+ * vectors; on a fixed scanline each test is linear in x, so it is solved
+ * once per row for the x range it admits instead of being evaluated (or
+ * atan2f'd) per pixel. Angles are measured counter-clockwise from +x with
+ * screen y flipped, as the old per-pixel versions did.
+ */
+#define ILI9341_ARC_ONE		(1 << 20)	// fixed-point unit for the angle vectors, radius * ONE must fit int32
+#define ILI9341_ARC_FULL	0
+#define ILI9341_ARC_CONVEX	1
+#define ILI9341_ARC_REFLEX	2
+
+typedef struct {
+	int32_t lo;
+	int32_t hi;
+} ILI9341_Span;
+
+typedef struct {
+	int32_t a[2];		// start direction, ILI9341_ARC_ONE units
+	int32_t b[2];		// end direction
+	int32_t a_min;		// 0 closes the start edge, 1 opens it
+	int32_t b_min;
+	uint8_t wedge;		// ILI9341_ARC_FULL / _CONVEX (sweep <= 180) / _REFLEX
+	uint16_t color;
+} ILI9341_Arc;
+
+static void ILI9341_Emit_Span(int32_t X0, int32_t X1, int32_t Y, uint16_t Colour)
+{
+	if ((Y < 0) || (Y >= LCD_HEIGHT)) return;
+	if (X0 < 0) X0 = 0;
+	if (X1 >= LCD_WIDTH) X1 = LCD_WIDTH - 1;
+	if (X0 > X1) return;
+	ILI9341_Set_Address(X0, Y, X1, Y);
+	ILI9341_Draw_Colour_Burst(Colour, X1 - X0 + 1);
+}
 
-		unsigned char Temp_small_buffer[BURST_MAX_SIZE];
-		uint32_t counter = 0;
-		for(uint32_t i = 0; i < LCD_WIDTH*LCD_HEIGHT*2/BURST_MAX_SIZE; i++)
-		{
-			for(uint32_t k = 0; k< BURST_MAX_SIZE; k++)
-			{
-				Temp_small_buffer[k]	= Image_Array[counter+k];
-			}
-			HAL_SPI_Transmit(&hspi1, (unsigned char*)Temp_small_buffer, BURST_MAX_SIZE, 10);
-			counter += BURST_MAX_SIZE;
+static int32_t ILI9341_Isqrt(int32_t n)
+{
+	uint32_t op = n, res = 0, one = 1UL << 30;
+
+	if (n <= 0) return 0;
+	while (one > op) one >>= 2;
+	while (one) {
+		if (op >= res + one) {
+			op -= res + one;
+			res += one << 1;
 		}
-		HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+		res >>= 1;
+		one >>= 2;
 	}
-	else if(Orientation == SCREEN_VERTICAL_1)
-	{
-		ILI9341_Set_Rotation(SCREEN_VERTICAL_1);
-		ILI9341_Set_Address(0,0,LCD_HEIGHT,LCD_WIDTH);
+	return res;
+}
 
-		HAL_GPIO_WritePin(LCD_DC_PORT,LCD_DC_PIN, GPIO_PIN_SET);
-		HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+static int32_t ILI9341_Floor_Div(int32_t a, int32_t b)	// b > 0
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
 
-		unsigned char Temp_small_buffer[BURST_MAX_SIZE];
-		uint32_t counter = 0;
-		for(uint32_t i = 0; i < LCD_WIDTH*LCD_HEIGHT*2/BURST_MAX_SIZE; i++)
-		{
-			for(uint32_t k = 0; k< BURST_MAX_SIZE; k++)
-			{
-				Temp_small_buffer[k]	= Image_Array[counter+k];
-			}
-			HAL_SPI_Transmit(&hspi1, (unsigned char*)Temp_small_buffer, BURST_MAX_SIZE, 10);
-			counter += BURST_MAX_SIZE;
+/* Narrow the span to the x for which c0 + c1*x >= 0. */
+static void ILI9341_Span_Clip(ILI9341_Span *s, int32_t c0, int32_t c1)
+{
+	int32_t bound;
+
+	if (c1 > 0) {
+		bound = -ILI9341_Floor_Div(c0, c1);	// ceil(-c0 / c1)
+		if (bound > s->lo) s->lo = bound;
+	} else if (c1 < 0) {
+		bound = ILI9341_Floor_Div(c0, -c1);
+		if (bound < s->hi) s->hi = bound;
+	} else if (c0 < 0) {
+		s->hi = s->lo - 1;
+	}
+}
+
+/* Emit the part of one ring row [lo,hi] (relative to the centre) inside the arc. */
+static void ILI9341_Arc_Row(const ILI9341_Arc *arc, int32_t X, int32_t Y, int32_t y, int32_t lo, int32_t hi)
+{
+	int32_t py = -y;	// math y for this row
+	ILI9341_Span sa = { lo, hi };
+	ILI9341_Span sb = { lo, hi };
+
+	if (arc->wedge == ILI9341_ARC_FULL) {
+		ILI9341_Emit_Span(X + lo, X + hi, Y + y, arc->color);
+		return;
+	}
+
+	ILI9341_Span_Clip(&sa, arc->a[0] * py - arc->a_min, -arc->a[1]);	// cross(A,P) >= a_min
+	ILI9341_Span_Clip(&sb, -arc->b[0] * py - arc->b_min, arc->b[1]);	// cross(P,B) >= b_min
+
+	if (arc->wedge == ILI9341_ARC_CONVEX) {
+		// convex wedge: both tests must hold
+		if (sb.lo > sa.lo) sa.lo = sb.lo;
+		if (sb.hi < sa.hi) sa.hi = sb.hi;
+		if (sa.lo <= sa.hi) ILI9341_Emit_Span(X + sa.lo, X + sa.hi, Y + y, arc->color);
+		return;
+	}
+
+	// reflex wedge: either test admits the pixel
+	if ((sa.lo <= sa.hi) && (sb.lo <= sb.hi) && (sa.lo <= sb.hi + 1) && (sb.lo <= sa.hi + 1)) {
+		ILI9341_Emit_Span(X + (sa.lo < sb.lo ? sa.lo : sb.lo), X + (sa.hi > sb.hi ? sa.hi : sb.hi), Y + y, arc->color);
+		return;
+	}
+	if (sa.lo <= sa.hi) ILI9341_Emit_Span(X + sa.lo, X + sa.hi, Y + y, arc->color);
+	if (sb.lo <= sb.hi) ILI9341_Emit_Span(X + sb.lo, X + sb.hi, Y + y, arc->color);
+}
+
+/* Rasterize an arc; open_start/open_end leave the pixels exactly on that edge ray alone. */
+static void ILI9341_Arc_Fill(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius,
+		float start_angle_deg, float end_angle_deg, bool open_start, bool open_end, uint16_t color)
+{
+	float sweep_deg = end_angle_deg - start_angle_deg;
+	int32_t r2 = (int32_t)outer_radius * outer_radius;
+	int32_t i2 = (int32_t)inner_radius * inner_radius;
+	ILI9341_Arc arc;
+
+	if (sweep_deg <= 0.0f) return;
+	arc.wedge = (sweep_deg >= 360.0f) ? ILI9341_ARC_FULL :
+			(sweep_deg > 180.0f) ? ILI9341_ARC_REFLEX : ILI9341_ARC_CONVEX;
+	arc.a_min = open_start ? 1 : 0;
+	arc.b_min = open_end ? 1 : 0;
+	arc.color = color;
+
+	float start_rad = DEG_TO_RAD(start_angle_deg);
+	float end_rad = DEG_TO_RAD(end_angle_deg);
+	arc.a[0] = lroundf(cosf(start_rad) * ILI9341_ARC_ONE);
+	arc.a[1] = lroundf(sinf(start_rad) * ILI9341_ARC_ONE);
+	arc.b[0] = lroundf(cosf(end_rad) * ILI9341_ARC_ONE);
+	arc.b[1] = lroundf(sinf(end_rad) * ILI9341_ARC_ONE);
+
+	for (int32_t y = -(int32_t)outer_radius; y <= outer_radius; y++) {
+		int32_t xo = ILI9341_Isqrt(r2 - y * y);
+		int32_t d = i2 - y * y;
+
+		if (d <= 0) {
+			ILI9341_Arc_Row(&arc, X, Y, y, -xo, xo);
+			continue;
 		}
-		HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+
+		// row crosses the hole: two runs, |x| >= ceil(sqrt(d))
+		int32_t xi = ILI9341_Isqrt(d);
+		if (xi * xi < d) xi++;
+		if (xi > xo) continue;
+		ILI9341_Arc_Row(&arc, X, Y, y, -xo, -xi);
+		ILI9341_Arc_Row(&arc, X, Y, y, xi, xo);
 	}
 }
+
+//draw the part of the ring inner_radius..outer_radius between two angles (degrees)
+void ILI9341_Draw_Arc(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius, float start_angle_deg, float end_angle_deg, uint16_t color)
+{
+	ILI9341_Arc_Fill(X, Y, inner_radius, outer_radius, start_angle_deg, end_angle_deg, false, false, color);
+}
+
 //use dtaw pixel function to draw hollow circle
 void ILI9341_Draw_HollowCircle(uint16_t X, uint16_t Y, uint16_t radius, uint16_t color)
 {
@@ -1141,7 +1996,7 @@ void ILI9341_Draw_HollowCircle(uint16_t X, uint16_t Y, uint16_t radius, uint16_t
 	}
 }
 
-//Draw a filled circle via draw pixel
+//Draw a filled circle, one span per scanline
 void ILI9341_Draw_FilledCircle(uint16_t X, uint16_t Y, uint16_t radius, uint16_t color)
 {
 
@@ -1157,17 +2012,10 @@ void ILI9341_Draw_FilledCircle(uint16_t X, uint16_t Y, uint16_t radius, uint16_t
 
 	while (x >= y)
 	{
-		for (int i = X - x; i <= X + x; i++)
-		{
-			ILI9341_Draw_Pixel(i, Y + y,color);
-			ILI9341_Draw_Pixel(i, Y - y,color);
-		}
-
-		for (int i = X - y; i <= X + y; i++)
-		{
-			ILI9341_Draw_Pixel(i, Y + x,color);
-			ILI9341_Draw_Pixel(i, Y - x,color);
-		}
+		ILI9341_Emit_Span(X - x, X + x, Y + y, color);
+		ILI9341_Emit_Span(X - x, X + x, Y - y, color);
+		ILI9341_Emit_Span(X - y, X + y, Y + x, color);
+		ILI9341_Emit_Span(X - y, X + y, Y - x, color);
 
 		y++;
 		radiusError += yChange;
@@ -1272,160 +2120,32 @@ void ILI9341_Draw_FilledRectangleCoord(uint16_t X0, uint16_t Y0, uint16_t X1, ui
 	ILI9341_Draw_Rectangle(X0True, Y0True, xLen, yLen, color);
 }
 
-//draw filled circle attempt via color burst
+//draw filled circle sector, swept counter-clockwise from +x
 void ILI9341_Draw_FilledCircle_Sector(uint16_t X, uint16_t Y, uint16_t radius, float angle_deg, uint16_t color)
 {
     if (angle_deg > 360.0f) angle_deg = 360.0f;
     if (angle_deg < 0.0f) angle_deg = 0.0f;
 
-    float angle_rad = angle_deg * (M_PI / 180.0f);
-    int r2 = radius * radius;
-
-    for (int y = -radius; y <= radius; y++) {
-        int x_start = -1;
-        for (int x = -radius; x <= radius; x++) {
-            int dx = x;
-            int dy = y;
-            int dist2 = dx * dx + dy * dy;
-
-            if (dist2 <= r2) {
-                float angle = atan2f((float)-dy, (float)dx); // Y axis flipped
-                if (angle < 0) angle += 2.0f * M_PI;
-
-                if (angle <= angle_rad) {
-                    if (x_start == -1) {
-                        x_start = x;
-                    }
-                } else {
-                    if (x_start != -1) {
-                        int x_end = x - 1;
-                        int len = x_end - x_start + 1;
-                        ILI9341_Set_Address(X + x_start, Y + y, X + x_end, Y + y);
-                        ILI9341_Draw_Colour_Burst(color, len);
-                        x_start = -1;
-                    }
-                }
-            } else {
-                if (x_start != -1) {
-                    int x_end = x - 1;
-                    int len = x_end - x_start + 1;
-                    ILI9341_Set_Address(X + x_start, Y + y, X + x_end, Y + y);
-                    ILI9341_Draw_Colour_Burst(color, len);
-                    x_start = -1;
-                }
-            }
-        }
-
-        // Final span if the row ends with a valid range
-        if (x_start != -1) {
-            int x_end = radius;
-            int len = x_end - x_start + 1;
-            ILI9341_Set_Address(X + x_start, Y + y, X + x_end, Y + y);
-            ILI9341_Draw_Colour_Burst(color, len);
-        }
-    }
+    ILI9341_Draw_Arc(X, Y, 0, radius, 0.0f, angle_deg, color);
 }
 
-//void ILI9341_Draw_RingSector(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius, float angle_deg, uint16_t color)
-//{
-//    if (angle_deg > 360.0f) angle_deg = 360.0f;
-//    if (angle_deg < 0.0f) angle_deg = 0.0f;
-//
-//    float angle_rad = angle_deg * (M_PI / 180.0f);
-//
-//    int outer_r2 = outer_radius * outer_radius;
-//    int inner_r2 = inner_radius * inner_radius;
-//
-//    // Scan through bounding box
-//    for (int y = -outer_radius; y <= outer_radius; y++) {
-//        int draw_started = 0;
-//        int x_start = 0;
-//        for (int x = -outer_radius; x <= outer_radius; x++) {
-//            int dx = x;
-//            int dy = y;
-//            int dist2 = dx * dx + dy * dy;
-//
-//            if (dist2 >= inner_r2 && dist2 <= outer_r2) {
-//                float angle = atan2f((float)-dy, (float)dx);
-//                if (angle < 0) angle += 2.0f * M_PI;
-//
-//                if (angle <= angle_rad) {
-//                    if (!draw_started) {
-//                        x_start = x;
-//                        draw_started = 1;
-//                    }
-//                } else {
-//                    if (draw_started) {
-//                        // Draw burst from x_start to x-1
-//                        int len = x - x_start;
-//                        ILI9341_Set_Address(X + x_start, Y + y, X + x - 1, Y + y);
-//                        ILI9341_Draw_Colour_Burst(color, len);
-//                        draw_started = 0;
-//                    }
-//                }
-//            } else {
-//                if (draw_started) {
-//                    int len = x - x_start;
-//                    ILI9341_Set_Address(X + x_start, Y + y, X + x - 1, Y + y);
-//                    ILI9341_Draw_Colour_Burst(color, len);
-//                    draw_started = 0;
-//                }
-//            }
-//        }
-//        if (draw_started) {
-//            int len = outer_radius * 2 + 1 - x_start;
-//            ILI9341_Set_Address(X + x_start, Y + y, X + outer_radius, Y + y);
-//            ILI9341_Draw_Colour_Burst(color, len);
-//        }
-//    }
-//}
-
-//draw ring sector attempt 1
+//draw ring sector from 0 to angle_deg
 void ILI9341_Draw_RingSector(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius, float angle_deg, uint16_t color)
 {
     if (angle_deg > 360.0f) angle_deg = 360.0f;
     if (angle_deg < 0.0f) angle_deg = 0.0f;
 
-    float angle_rad = angle_deg * (M_PI / 180.0f);
-
-    for (int y = -outer_radius; y <= outer_radius; y++) {
-        for (int x = -outer_radius; x <= outer_radius; x++) {
-            int dist_sq = x * x + y * y;
-            if (dist_sq >= inner_radius * inner_radius && dist_sq <= outer_radius * outer_radius) {
-                float theta = atan2f((float)-y, (float)x); // y is negative because screen y grows downward
-                if (theta < 0) theta += 2.0f * M_PI;
-
-                if (theta <= angle_rad) {
-                    ILI9341_Draw_Pixel(X + x, Y + y, color);
-                }
-            }
-        }
-    }
+    ILI9341_Draw_Arc(X, Y, inner_radius, outer_radius, 0.0f, angle_deg, color);
 }
 
-//draw ring sector attempt 2
+//draw ring sector between two angles
 void ILI9341_Draw_RingSector_v2(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius, float start_angle_deg, float end_angle_deg, uint16_t color)
 {
     if (start_angle_deg < 0.0f) start_angle_deg = 0.0f;
     if (end_angle_deg > 360.0f) end_angle_deg = 360.0f;
     if (start_angle_deg > end_angle_deg) return; // invalid range
 
-    float start_rad = start_angle_deg * (M_PI / 180.0f);
-    float end_rad = end_angle_deg * (M_PI / 180.0f);
-
-    for (int y = -outer_radius; y <= outer_radius; y++) {
-        for (int x = -outer_radius; x <= outer_radius; x++) {
-            int dist_sq = x * x + y * y;
-            if (dist_sq >= inner_radius * inner_radius && dist_sq <= outer_radius * outer_radius) {
-                float theta = atan2f((float)-y, (float)x);  // screen y grows downward
-                if (theta < 0) theta += 2.0f * M_PI;
-
-                if (theta >= start_rad && theta <= end_rad) {
-                    ILI9341_Draw_Pixel(X + x, Y + y, color);
-                }
-            }
-        }
-    }
+    ILI9341_Draw_Arc(X, Y, inner_radius, outer_radius, start_angle_deg, end_angle_deg, color);
 }
 
 
@@ -14,13 +14,60 @@
 #include "stm32l4xx_hal.h"
 #include "shared.h"
 #include "state_machine.h"
+#include "event_controller.h"
+#include "input_log.h"
 
 extern I2C_HandleTypeDef hi2c1;
 
 Vector3D accelerometer_state;
 Vector3D prev_accelerometer_state;
 
+/* Sensor Reads
+ *	accDeltaEvent and magBoxStatusEvent are coroutines: they start an
+ *	interrupt driven register read and yield until the bus hands the
+ *	result back, instead of holding the main loop for both halves of a
+ *	blocking transfer every 10 ms. The receive buffers outlive the yield
+ *	so they are static. accRead and magRead stay blocking for init.
+ */
+static struct {
+	Coroutine co;
+	uint8_t raw[6];
+} acc_read;
+
+static struct {
+	Coroutine co;
+	uint8_t raw[6];
+} mag_read;
+
+static bool i2cIdle(void) {
+	return HAL_I2C_GetState(&hi2c1) == HAL_I2C_STATE_READY;
+}
 
+// a transfer that never finished leaves the peripheral busy, start it over
+static void i2cRecover(void) {
+	HAL_I2C_DeInit(&hi2c1);
+	HAL_I2C_Init(&hi2c1);
+}
+
+// Stores a raw little endian sample as the new accelerometer state
+static void accStore(const uint8_t *raw) {
+	prev_accelerometer_state = accelerometer_state;
+	accelerometer_state.x_componenet = (raw[1] << 8) | raw[0];
+	accelerometer_state.y_componenet = (raw[3] << 8) | raw[2];
+	accelerometer_state.z_componenet = (raw[5] << 8) | raw[4];
+#ifdef RECORD_INPUTS
+	inputLogSample(INPUT_ACC, &accelerometer_state);
+#endif
+}
+
+static void magStore(Vector3D *vec, const uint8_t *raw) {
+	vec->x_componenet = (raw[1] << 8) | raw[0];
+	vec->y_componenet =	(raw[3] << 8) | raw[2];
+	vec->z_componenet = (raw[5] << 8) | raw[4];
+#ifdef RECORD_INPUTS
+	inputLogSample(INPUT_MAG, vec);
+#endif
+}
 
 //Function to init accelerometer and init accelerometer_state vector components
 void accInit(void){
@@ -61,11 +108,7 @@ void accRead(){
 #endif
 	}
 	//change state of accelerometer vector to new values
-
-	prev_accelerometer_state = accelerometer_state;
-	accelerometer_state.x_componenet = (out_buf_8[1] << 8) | out_buf_8[0];
-	accelerometer_state.y_componenet = (out_buf_8[3] << 8) | out_buf_8[2];
-	accelerometer_state.z_componenet = (out_buf_8[5] << 8) | out_buf_8[4];
+	accStore(out_buf_8);
 
 #ifdef DEBUG_ACC_MAG
 		printf("[INFO] Accelerometer Read result, x: %d, y: %d, z: %d\n\r",
@@ -75,7 +118,32 @@ void accRead(){
 
 
 void accDeltaEvent(void) {
-	accRead();  // updates current_state and last_state
+	Coroutine *co = &acc_read.co;
+
+	CO_BEGIN(co);
+
+	//request data from accelerometer address allowing autoshift of pointer
+	CO_WAIT_UNTIL(co, i2cIdle(), 1);
+	if (HAL_I2C_Mem_Read_IT(&hi2c1, ACC_WRITE, ACC_FIRST_ADDR | (1 << 7), I2C_MEMADD_SIZE_8BIT,
+			acc_read.raw, sizeof(acc_read.raw)) != HAL_OK) {
+#ifdef DEBUG_ACC_MAG
+		printf("[ERROR] Accelerometer Data I2C read failed to start\n\r");
+#endif
+		CO_EXIT(co);
+	}
+
+	CO_WAIT_UNTIL_TIMEOUT(co, i2cIdle(), 1, I2C_TIMEOUT);
+	if (!i2cIdle()) {
+		i2cRecover();
+		CO_EXIT(co);
+	}
+	if (HAL_I2C_GetError(&hi2c1) != HAL_I2C_ERROR_NONE) {
+#ifdef DEBUG_ACC_MAG
+		printf("[ERROR] Accelerometer Data I2C read failed\n\r");
+#endif
+		CO_EXIT(co);
+	}
+	accStore(acc_read.raw);  // updates current_state and last_state
 
 	//find a "delta" which is change of values over time
 	int32_t delta = (accelerometer_state.x_componenet - prev_accelerometer_state.x_componenet) +
@@ -91,6 +159,8 @@ void accDeltaEvent(void) {
 		printf("[INFO] Accelerometer detected the box has moved, flag inserted\n\r");
 #endif
 	}
+
+	CO_END(co);
 }
 
 //Function to init magnetometer
@@ -120,10 +190,7 @@ void magRead(Vector3D* vec){
 #endif
 	}
 
-
-	vec->x_componenet = (out_buf_8[1] << 8) | out_buf_8[0];
-	vec->y_componenet =	(out_buf_8[3] << 8) | out_buf_8[2];
-	vec->z_componenet = (out_buf_8[5] << 8) | out_buf_8[4];
+	magStore(vec, out_buf_8);
 
 #ifdef DEBUG_ACC_MAG
 		printf("[INFO] Magnetometer Read result, x: %d, y: %d, z: %d\n\r",
@@ -134,9 +201,33 @@ void magRead(Vector3D* vec){
 
 //Function to check if box is open or closed based on magnet values
 void magBoxStatusEvent(void) {
+	Coroutine *co = &mag_read.co;
 	Vector3D vec;
+
+	CO_BEGIN(co);
+
 	//read values
-	magRead(&vec);
+	CO_WAIT_UNTIL(co, i2cIdle(), 1);
+	if (HAL_I2C_Mem_Read_IT(&hi2c1, MAG_WRITE, MAG_FIRST_ADDR | (1 << 7), I2C_MEMADD_SIZE_8BIT,
+			mag_read.raw, sizeof(mag_read.raw)) != HAL_OK) {
+#ifdef DEBUG_ACC_MAG
+		printf("[ERROR] Magnetometer Data I2C read failed to start\n\r");
+#endif
+		CO_EXIT(co);
+	}
+
+	CO_WAIT_UNTIL_TIMEOUT(co, i2cIdle(), 1, I2C_TIMEOUT);
+	if (!i2cIdle()) {
+		i2cRecover();
+		CO_EXIT(co);
+	}
+	if (HAL_I2C_GetError(&hi2c1) != HAL_I2C_ERROR_NONE) {
+#ifdef DEBUG_ACC_MAG
+		printf("[ERROR] Magnetometer Data I2C read failed\n\r");
+#endif
+		CO_EXIT(co);
+	}
+	magStore(&vec, mag_read.raw);
 
 	//find magnitude of values
 	int magnitude = abs(vec.x_componenet) + abs(vec.y_componenet) + abs(vec.z_componenet);
@@ -158,4 +249,6 @@ void magBoxStatusEvent(void) {
 #endif
 
 	}
+
+	CO_END(co);
 }
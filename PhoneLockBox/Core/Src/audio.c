@@ -16,7 +16,6 @@
 
 extern TIM_HandleTypeDef htim2;  // external timer handle for time management
 extern uint32_t time_ms;         // external time counter (in milliseconds)
-extern SFlag flags[MAX_FLAGS];   // array to store state flags
 
 uint32_t matrix[MAX_ENTRIES] = {0};  // stores the time deltas between audio events (ring buffer)
 uint8_t audio_count;                 // counter for the number of audio interrupts detected
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <string.h>
 
 #include "shared.h"
 #include "state_machine.h"
@@ -12,74 +13,610 @@
 extern TIM_HandleTypeDef htim3;
 
 /* Event Global Declarations
- *	events: stores all active event records currently scheduled
  *	time_ms: is the time reference incremented by the timer interrupt
  */
-Event events[MAX_EVENT_COUNT];
 uint32_t time_ms;
 
-/* eventRegister()
- *  	Creates an event record from the pass paramters and
- *	calls eventSchedule on the new record after adding it to
- *	the events array. Acts as the entry point for interaction
- *	with the event system.
+/* Event Table
+ *	One record per slot, stored as parallel arrays. The heaps only ever
+ *	compare deadlines and the runner only looks at the flag once a
+ *	callback returns, so those sit in their own arrays and a sift or a
+ *	root check stays within a few cache lines. The rest is read once per
+ *	run or less. Outside this file a record is an EventHandle: its slot
+ *	in the low byte, the slot's generation in the high byte. Removal bumps
+ *	the generation, so a handle kept past its event's removal stops
+ *	matching instead of reaching whatever reuses the slot.
+ *
+ *	event_period: delay of singles, delta of deltas, period of periodics
+ *	event_repeat: runs left for N_REPEAT events
+ */
+static uint32_t event_deadline[MAX_EVENT_COUNT];
+static uint8_t event_flag[MAX_EVENT_COUNT];
+static uint8_t event_priority[MAX_EVENT_COUNT];
+
+static void (*event_callback[MAX_EVENT_COUNT])(void);
+static uint8_t event_label[MAX_EVENT_COUNT];
+static uint8_t event_generation[MAX_EVENT_COUNT];
+static uint32_t event_release[MAX_EVENT_COUNT];
+static uint32_t event_period[MAX_EVENT_COUNT];
+static uint32_t event_repeat[MAX_EVENT_COUNT];
+static Coroutine *event_co[MAX_EVENT_COUNT];
+static bool event_yielded[MAX_EVENT_COUNT];
+static EventJitter event_jitter[MAX_EVENT_COUNT];
+
+/* Deadline Heaps
+ *	Every scheduled record sits in the heap of its priority class, a
+ *	binary min-heap on schedule_time, so the next event due in a class is
+ *	always at its root and eventRunner never looks past the roots while
+ *	nothing is ready. heap_pos maps a record back to its heap entry for
+ *	O(log n) reschedule and removal, and free_slots is a stack of unused
+ *	records which makes eventRegister O(1). The record whose callback is
+ *	running sits in neither, so a callback removing it can't hand the
+ *	slot to a new event before the runner is done with it. Records that
+ *	already ran in the current pass wait in deferred until it ends.
+ */
+#define EVENT_NOT_QUEUED 0xFF
+#define EVENT_DEFERRED 0xFE
+
+static uint8_t event_heap[EVENT_PRIORITY_COUNT][MAX_EVENT_COUNT];
+static uint8_t heap_count[EVENT_PRIORITY_COUNT];
+static uint8_t heap_pos[MAX_EVENT_COUNT];
+static uint8_t free_slots[MAX_EVENT_COUNT];
+static uint8_t free_count;
+static uint8_t deferred[MAX_EVENT_COUNT];
+static uint8_t deferred_count;
+static uint8_t running = EVENT_NOT_QUEUED;
+
+/* Class an event gets when registered through eventRegister(). Input
+ * sampling is cheap and needs to stay on time, bus transactions that can
+ * block for a long time go last.
  */
-EventReturnCode eventRegister(void *callback, EventLabel label, EventFlag flag, uint16_t delta, uint8_t n_runs) {
-	uint16_t context = delta;
+static const EventPriority label_priority[EVENT_LABEL_COUNT] = {
+	[EVENT_EMPTY] = EVENT_PRIORITY_NORMAL,
+	[EVENT_NFC_START_READ] = EVENT_PRIORITY_LOW,
+	[EVENT_NFC_POLL] = EVENT_PRIORITY_LOW,
+	[EVENT_NFC_READ] = EVENT_PRIORITY_LOW,
+	[EVENT_ROTARY_ENCODER] = EVENT_PRIORITY_HIGH,
+	[EVENT_AUDIO] = EVENT_PRIORITY_HIGH,
+	[EVENT_TIMER] = EVENT_PRIORITY_NORMAL,
+	[EVENT_ACCELEROMETER] = EVENT_PRIORITY_NORMAL,
+	[EVENT_MAGNOMETER] = EVENT_PRIORITY_LOW,
+};
+
+// true if deadline a comes before b, safe across time_ms wrapping
+static inline bool eventBefore(uint32_t a, uint32_t b) {
+	return (int32_t)(a - b) < 0;
+}
+
+static inline bool heapLess(uint8_t *heap, uint8_t i, uint8_t j) {
+	return eventBefore(event_deadline[heap[i]], event_deadline[heap[j]]);
+}
+
+static void heapSwap(uint8_t *heap, uint8_t i, uint8_t j) {
+	uint8_t tmp = heap[i];
+	heap[i] = heap[j];
+	heap[j] = tmp;
+	heap_pos[heap[i]] = i;
+	heap_pos[heap[j]] = j;
+}
+
+static void heapUp(uint8_t *heap, uint8_t i) {
+	while (i > 0) {
+		uint8_t parent = (i - 1) / 2;
+		if (!heapLess(heap, i, parent)) break;
+		heapSwap(heap, i, parent);
+		i = parent;
+	}
+}
+
+static void heapDown(uint8_t *heap, uint8_t count, uint8_t i) {
+	for (;;) {
+		uint16_t child = 2 * i + 1;
+		if (child >= count) break;
+		if (child + 1 < count && heapLess(heap, child + 1, child)) ++child;
+		if (!heapLess(heap, child, i)) break;
+		heapSwap(heap, i, child);
+		i = child;
+	}
+}
+
+// adds a record to its class heap, or moves it if its schedule_time changed while queued
+static void heapQueue(uint8_t idx) {
+	EventPriority p = event_priority[idx];
+	uint8_t *heap = event_heap[p];
+	uint8_t pos = heap_pos[idx];
+
+	if (pos == EVENT_NOT_QUEUED || pos == EVENT_DEFERRED) {
+		pos = heap_count[p]++;
+		heap[pos] = idx;
+		heap_pos[idx] = pos;
+	}
+
+	heapUp(heap, pos);
+	heapDown(heap, heap_count[p], heap_pos[idx]);
+}
+
+static void heapRemove(uint8_t idx) {
+	EventPriority p = event_priority[idx];
+	uint8_t *heap = event_heap[p];
+	uint8_t pos = heap_pos[idx];
+
+	heap_pos[idx] = EVENT_NOT_QUEUED;
+	if (pos == EVENT_NOT_QUEUED || pos == EVENT_DEFERRED) return;
+	if (pos == --heap_count[p]) return;
+
+	// the last entry fills the hole and is sifted whichever way it belongs
+	heap[pos] = heap[heap_count[p]];
+	heap_pos[heap[pos]] = pos;
+	heapUp(heap, pos);
+	heapDown(heap, heap_count[p], heap_pos[heap[pos]]);
+}
+
+/* eventRequeueAbove()
+ *	puts the records of classes above p that ran this pass back on the
+ *	schedule, the rest stay deferred until the pass ends
+ */
+static void eventRequeueAbove(EventPriority p) {
+	uint8_t kept = 0;
+
+	for (uint8_t i = 0; i < deferred_count; ++i) {
+		uint8_t idx = deferred[i];
+
+		// skip records removed (and maybe reused) since they were deferred
+		if (heap_pos[idx] != EVENT_DEFERRED) continue;
+		if (event_priority[idx] < p) {
+			heapQueue(idx);
+		} else {
+			deferred[kept++] = idx;
+		}
+	}
+	deferred_count = kept;
+}
+
+// puts everything that ran this pass back on the schedule
+static void eventRequeueDeferred(void) {
+	eventRequeueAbove(EVENT_PRIORITY_COUNT);
+}
+
+// holds a record that just ran until the pass ends
+static void eventDefer(uint8_t idx) {
+	// a slot removed and reused within one pass can be listed twice, make room if that fills it
+	if (deferred_count == MAX_EVENT_COUNT) {
+		eventRequeueDeferred();
+	}
+	heap_pos[idx] = EVENT_DEFERRED;
+	deferred[deferred_count++] = idx;
+}
 
-	if (flag == EVENT_N_REPEAT || flag == EVENT_N_REPEAT_IMMEDIATE) {
-		if (delta > 255) {
-			delta = 255;
+// earliest deadline over every class, false when nothing is scheduled
+bool eventNextDeadline(uint32_t *next) {
+	bool found = false;
+
+	for (uint8_t p = 0; p < EVENT_PRIORITY_COUNT; ++p) {
+		if (heap_count[p] == 0) continue;
+		uint32_t t = event_deadline[event_heap[p][0]];
+		if (!found || eventBefore(t, *next)) *next = t;
+		found = true;
+	}
+
+	return found;
+}
+
+static void eventRemove(uint8_t idx);
+static EventReturnCode eventSchedule(uint8_t idx);
 #ifdef DEBUG_EVENT_CONTROLLER
-			printf("[ERROR] Delta too large for repeat event, setting to 255\n\r");
+static void eventPrint(uint8_t idx);
 #endif
-		}
-		context = (n_runs << 8) | (context & 0x00FF);
+
+static inline EventHandle eventHandle(uint8_t idx) {
+	return ((EventHandle)event_generation[idx] << 8) | idx;
+}
+
+// slot a handle refers to, EVENT_NOT_QUEUED if its event is gone
+static uint8_t eventFind(EventHandle handle) {
+	uint8_t idx = handle & 0xFF;
+
+	if (idx >= MAX_EVENT_COUNT || event_label[idx] == EVENT_EMPTY ||
+			event_generation[idx] != (handle >> 8)) {
+		return EVENT_NOT_QUEUED;
 	}
+	return idx;
+}
+
+/* eventRegister()
+ *  	Creates an event record from the pass paramters and
+ *	calls eventSchedule on the new record after taking a free
+ *	slot in the event table. Acts as the entry point for interaction
+ *	with the event system. Returns the new event's handle, or
+ *	EVENT_HANDLE_NONE if the table is full or the flag is bad.
+ */
+EventHandle eventRegister(void *callback, EventLabel label, EventFlag flag, uint32_t delta, uint32_t n_runs) {
+	EventPriority priority = label < EVENT_LABEL_COUNT ? label_priority[label] : EVENT_PRIORITY_NORMAL;
+	return eventRegisterPriority(callback, label, flag, delta, n_runs, priority);
+}
+
+/* eventRegisterPriority()
+ *	eventRegister with an explicit priority class instead of the
+ *	label's default
+ */
+EventHandle eventRegisterPriority(void *callback, EventLabel label, EventFlag flag, uint32_t delta, uint32_t n_runs, EventPriority priority) {
 #ifdef DEBUG_EVENT_CONTROLLER
-	printf("[INFO] event registration called with, %s, %s, %u %u\n\r", EventLabelToStr(label), EventFlagToStr(flag), delta, n_runs);
+	printf("[INFO] event registration called with, %s, %s, %lu %lu\n\r", EventLabelToStr(label), EventFlagToStr(flag), delta, n_runs);
 #endif 
-	for (uint8_t i = 0; i < MAX_EVENT_COUNT; ++i) {
-		if (events[i].label == EVENT_EMPTY) {
-			events[i].callback = callback;
-			events[i].label = label;
-			events[i].flag = flag;
-			events[i].context = context;
-			eventSchedule(i);
-			return EVENT_SUCCESS;
-		}
+	if (free_count == 0) {
+		return EVENT_HANDLE_NONE;
 	}
 
-	return EVENT_QUEUE_FULL;
+	uint8_t i = free_slots[--free_count];
+	event_callback[i] = callback;
+	event_label[i] = label;
+	event_flag[i] = flag;
+	event_period[i] = delta;
+	event_repeat[i] = n_runs;
+	event_priority[i] = priority < EVENT_PRIORITY_COUNT ? priority : EVENT_PRIORITY_NORMAL;
+	event_co[i] = NULL;
+	event_yielded[i] = false;
+	memset(&event_jitter[i], 0, sizeof(event_jitter[i]));
+
+	if (eventSchedule(i) != EVENT_SUCCESS) {
+		eventRemove(i);
+		return EVENT_HANDLE_NONE;
+	}
+	return eventHandle(i);
 }
 
-void eventRemove(uint8_t idx) {
+static void eventRemove(uint8_t idx) {
+	if (event_label[idx] == EVENT_EMPTY) return;
+
 #ifdef DEBUG_EVENT_CONTROLLER
 	printf("[INFO] Removing Event");
-	eventPrint(&events[idx]);
+	eventPrint(idx);
 #endif
 
-	events[idx].callback = eventDefaultCallback;
-	events[idx].label = EVENT_EMPTY;
-	events[idx].flag = EVENT_DISABLED;
-	events[idx].schedule_time = MAX_TIME;
-	events[idx].context = 0;
+	heapRemove(idx);
+	event_callback[idx] = eventDefaultCallback;
+	event_label[idx] = EVENT_EMPTY;
+	event_flag[idx] = EVENT_DISABLED;
+	event_deadline[idx] = MAX_TIME;
+	event_period[idx] = 0;
+	event_repeat[idx] = 0;
+
+	// outstanding handles stop matching, 0 is skipped so no handle is ever EVENT_HANDLE_NONE
+	if (++event_generation[idx] == 0) {
+		event_generation[idx] = 1;
+	}
+
+	// a removed coroutine starts over the next time it is registered
+	if (event_co[idx] != NULL) {
+		event_co[idx]->line = 0;
+	}
+
+	// a running record is released by eventRunner once its callback returns
+	if (idx != running) {
+		event_co[idx] = NULL;
+		free_slots[free_count++] = idx;
+	}
+}
+
+/* eventCancel()
+ *	removes the event behind handle, safe from inside its own callback
+ */
+EventReturnCode eventCancel(EventHandle handle) {
+	uint8_t idx = eventFind(handle);
+	if (idx == EVENT_NOT_QUEUED) return EVENT_HANDLE_NOT_FOUND;
+
+	eventRemove(idx);
+	return EVENT_SUCCESS;
+}
+
+/* eventReschedule()
+ *	moves the next run of the event behind handle to delay_ms from now.
+ *	Its flag is left alone, so a periodic event keeps its period from
+ *	the new deadline on.
+ */
+EventReturnCode eventReschedule(EventHandle handle, uint32_t delay_ms) {
+	uint8_t idx = eventFind(handle);
+	if (idx == EVENT_NOT_QUEUED) return EVENT_HANDLE_NOT_FOUND;
+
+	event_deadline[idx] = time_ms + delay_ms;
+	event_release[idx] = event_deadline[idx];
+	event_yielded[idx] = false;
+	heapQueue(idx);
+	return EVENT_SUCCESS;
+}
+
+// true while the event behind handle is still registered
+bool eventValid(EventHandle handle) {
+	return eventFind(handle) != EVENT_NOT_QUEUED;
+}
+
+// handle of the event whose callback is running, EVENT_HANDLE_NONE outside a callback
+EventHandle eventCurrent(void) {
+	if (running == EVENT_NOT_QUEUED || event_label[running] == EVENT_EMPTY) return EVENT_HANDLE_NONE;
+	return eventHandle(running);
+}
+
+// label of the event whose callback is running, EVENT_EMPTY outside a callback
+EventLabel eventCurrentLabel(void) {
+	if (running == EVENT_NOT_QUEUED) return EVENT_EMPTY;
+	return event_label[running];
+}
+
+/* eventYield()
+ *	called from inside a callback, puts the running event back on the
+ *	schedule delay_ms from now without going through its flag, so a
+ *	resumed coroutine doesn't count as a repeat. It still waits for the
+ *	next pass like any other event that already ran.
+ */
+void eventYield(uint32_t delay_ms) {
+	if (running == EVENT_NOT_QUEUED || event_label[running] == EVENT_EMPTY) return;
+
+	event_deadline[running] = time_ms + delay_ms;
+	event_yielded[running] = true;
+	heapQueue(running);
+}
+
+/* eventBindCoroutine()
+ *	ties a coroutine to the running event so removing the event rewinds
+ *	it, CO_BEGIN calls this on every run
+ */
+void eventBindCoroutine(Coroutine *co) {
+	if (running == EVENT_NOT_QUEUED || event_label[running] == EVENT_EMPTY) return;
+
+	event_co[running] = co;
 }
 
 /* eventClear()
- *	walks the events array removing any events found
+ *	walks the event table removing any events found
  */
 void eventClear(void) {
 	for (uint8_t i = 0; i < MAX_EVENT_COUNT; ++i) {
-		if(events[i].label != EVENT_EMPTY) {
+		if(event_label[i] != EVENT_EMPTY) {
 			eventRemove(i);
 		}
 	}
 }
 
+/* Event Profiler
+ *	Built with PROFILE_EVENTS, eventRunner reads the DWT cycle counter
+ *	around every callback and files the cost and the start lateness
+ *	under the event's label. CYCCNT wraps after about 35 s at 120 MHz,
+ *	the unsigned difference is only wrong for callbacks longer than that.
+ */
+#ifdef PROFILE_EVENTS
+static EventProfile profiles[EVENT_LABEL_COUNT];
+
+static void eventProfileRecord(EventLabel label, uint32_t cycles, uint32_t late_ms) {
+	if (label >= EVENT_LABEL_COUNT) return;
+	EventProfile *p = &profiles[label];
+
+	uint8_t bucket = cycles ? 32 - __builtin_clz(cycles) : 0;
+	if (bucket >= EVENT_PROFILE_BUCKETS) bucket = EVENT_PROFILE_BUCKETS - 1;
+
+	if (p->runs == 0 || cycles < p->min_cycles) p->min_cycles = cycles;
+	if (cycles > p->max_cycles) p->max_cycles = cycles;
+	if (late_ms > p->max_late_ms) p->max_late_ms = late_ms;
+	p->total_cycles += cycles;
+	p->total_late_ms += late_ms;
+	p->histogram[bucket]++;
+	p->runs++;
+}
+
+const EventProfile* eventProfileGet(EventLabel label) {
+	return label < EVENT_LABEL_COUNT ? &profiles[label] : NULL;
+}
+
+void eventProfileReset(void) {
+	memset(profiles, 0, sizeof(profiles));
+}
+
+/* eventProfileDump()
+ *	prints one summary line per label that has run, followed by its
+ *	non-empty histogram buckets as <bucket>:<runs>
+ */
+void eventProfileDump(void) {
+	uint32_t cycles_per_us = SystemCoreClock / 1000000;
+
+	printf("[PROFILE] label runs min/mean/max cycles, mean us, mean/max late ms\n\r");
+	for (uint8_t l = 0; l < EVENT_LABEL_COUNT; ++l) {
+		EventProfile *p = &profiles[l];
+		if (p->runs == 0) continue;
+
+		uint32_t mean = p->total_cycles / p->runs;
+		printf("[PROFILE] %s %lu %lu/%lu/%lu, %lu us, %lu/%lu ms\n\r", EventLabelToStr(l), p->runs,
+				p->min_cycles, mean, p->max_cycles, mean / cycles_per_us,
+				(uint32_t)(p->total_late_ms / p->runs), p->max_late_ms);
+
+		printf("[PROFILE]   log2 hist");
+		for (uint8_t b = 0; b < EVENT_PROFILE_BUCKETS; ++b) {
+			if (p->histogram[b]) printf(" %u:%lu", b, p->histogram[b]);
+		}
+		printf("\n\r");
+	}
+}
+#endif
+
+/* Tickless Idle
+ *	TIM3 normally interrupts once a millisecond to advance time_ms. When
+ *	the main loop has nothing left to do, eventIdle() stretches that
+ *	period out to the next deadline in the heap and sleeps on WFI, so an
+ *	idle box only wakes for its events and for interrupts instead of on
+ *	every tick. The update ending a stretched period advances time_ms by
+ *	the whole span. An earlier wake credits the milliseconds that really
+ *	passed and puts the 1 ms period back, keeping the part of a tick
+ *	already counted.
+ */
+static uint32_t tick_span = 1; /* ms the current TIM3 period stands for */
+
+static bool eventSignalPending(void);
+
+/* TIM3 counts per 1 ms tick, read once at init: __HAL_TIM_SET_AUTORELOAD
+ * writes every stretched period back into htim3.Init.Period */
+static uint32_t tick_counts = 1;
+
+/* eventTick()
+ *	called from the TIM3 update interrupt
+ */
+void eventTick(void) {
+	time_ms += tick_span;
+
+	if (tick_span != 1) {
+		tick_span = 1;
+		__HAL_TIM_SET_AUTORELOAD(&htim3, tick_counts - 1);
+	}
+}
+
+/* eventIdle()
+ *	sleeps until the next event is due, an interrupt arrives or max_ms
+ *	have passed, whichever is first. Returns straight away if an event is
+ *	already due, max_ms is 0, a signal is waiting in the ring or pending
+ *	(may be NULL) reports other work an interrupt left for the main
+ *	loop. Both are checked with interrupts off, so whatever they miss
+ *	ends the WFI instead.
+ */
+void eventIdle(uint32_t max_ms, bool (*pending)(void)) {
+	if (max_ms == 0) return;
+	if (max_ms > EVENT_IDLE_MAX_MS) max_ms = EVENT_IDLE_MAX_MS;
+
+	// anything firing from here on stays pending and ends the WFI below
+	__disable_irq();
+
+	// set or posted by an interrupt since the main loop last looked, the loop has to go round again
+	if (eventSignalPending() || (pending != NULL && pending())) {
+		__enable_irq();
+		return;
+	}
+
+	uint32_t next = 0;
+	if (eventNextDeadline(&next)) {
+		if (!eventBefore(time_ms, next)) {
+			__enable_irq();
+			return;
+		}
+		if (next - time_ms < max_ms) max_ms = next - time_ms;
+	}
+
+	// the counter is held while the period changes so a tick can't slip in between
+	htim3.Instance->CR1 &= ~TIM_CR1_CEN;
+	if (max_ms > 1 && !__HAL_TIM_GET_FLAG(&htim3, TIM_FLAG_UPDATE)) {
+		tick_span = max_ms;
+		__HAL_TIM_SET_AUTORELOAD(&htim3, max_ms * tick_counts - 1);
+	}
+	htim3.Instance->CR1 |= TIM_CR1_CEN;
+
+	// SysTick would otherwise wake us every millisecond
+	HAL_SuspendTick();
+	__WFI();
+	HAL_ResumeTick();
+
+	htim3.Instance->CR1 &= ~TIM_CR1_CEN;
+	if (tick_span != 1 && !__HAL_TIM_GET_FLAG(&htim3, TIM_FLAG_UPDATE)) {
+		uint32_t cnt = __HAL_TIM_GET_COUNTER(&htim3);
+		time_ms += cnt / tick_counts;
+		__HAL_TIM_SET_COUNTER(&htim3, cnt % tick_counts);
+		__HAL_TIM_SET_AUTORELOAD(&htim3, tick_counts - 1);
+		tick_span = 1;
+	}
+	htim3.Instance->CR1 |= TIM_CR1_CEN;
+
+	__enable_irq();
+}
+
+/* ISR Signals
+ *	Interrupt handlers don't touch the flags or any other main loop state,
+ *	they post a timestamped EventSignal here and the main loop drains the
+ *	ring before runStateMachine. One producer, one consumer: every
+ *	poster is an EXTI handler at the same NVIC priority, so posts never
+ *	preempt each other, and only the main loop pops. Each side owns its
+ *	own index, the barrier orders the slot write before the index that
+ *	publishes it (and the read before the index that frees it).
+ */
+static EventSignal signal_ring[EVENT_SIGNAL_RING];
+static volatile uint8_t signal_head;  /* next slot to fill, written by the ISR */
+static volatile uint8_t signal_tail;  /* next slot to drain, written by the main loop */
+static volatile uint32_t signal_dropped;
+
+/* eventSignalPost()
+ *	interrupt context only, false if the ring was full and the signal
+ *	had to be dropped
+ */
+bool eventSignalPost(EventSignalSource source, uint8_t arg) {
+	uint8_t head = signal_head;
+
+	if ((uint8_t)(head - signal_tail) >= EVENT_SIGNAL_RING) {
+		++signal_dropped;
+		return false;
+	}
+
+	EventSignal *sig = &signal_ring[head & (EVENT_SIGNAL_RING - 1)];
+	sig->source = source;
+	sig->arg = arg;
+	sig->time_ms = time_ms;
+	__DMB();
+	signal_head = head + 1;
+	return true;
+}
+
+/* eventSignalPop()
+ *	main loop only, copies out the oldest signal, false once drained
+ */
+bool eventSignalPop(EventSignal *out) {
+	uint8_t tail = signal_tail;
+
+	if (tail == signal_head) return false;
+
+	__DMB();
+	*out = signal_ring[tail & (EVENT_SIGNAL_RING - 1)];
+	__DMB();
+	signal_tail = tail + 1;
+	return true;
+}
+
+// true while a posted signal hasn't been popped yet
+static bool eventSignalPending(void) {
+	return signal_tail != signal_head;
+}
+
+// signals lost to a full ring since init
+uint32_t eventSignalDropped(void) {
+	return signal_dropped;
+}
+
 EventReturnCode eventControllerInit(void) {
 	time_ms = 0;
-	eventClear();
+
+	// every record starts empty and free, slot 0 ends up on top of the stack
+	memset(heap_count, 0, sizeof(heap_count));
+	free_count = 0;
+	deferred_count = 0;
+	running = EVENT_NOT_QUEUED;
+	signal_tail = signal_head;
+	signal_dropped = 0;
+	for (uint8_t i = MAX_EVENT_COUNT; i-- > 0;) {
+		event_callback[i] = eventDefaultCallback;
+		event_label[i] = EVENT_EMPTY;
+		event_flag[i] = EVENT_DISABLED;
+		event_deadline[i] = MAX_TIME;
+		event_period[i] = 0;
+		event_repeat[i] = 0;
+		event_generation[i] = 1;
+		event_co[i] = NULL;
+		heap_pos[i] = EVENT_NOT_QUEUED;
+		free_slots[free_count++] = i;
+	}
+
+	// eventIdle retimes TIM3 on the fly, auto-reload writes have to land immediately
+	tick_span = 1;
+	tick_counts = htim3.Init.Period + 1;
+	htim3.Instance->CR1 &= ~TIM_CR1_ARPE;
+
+#ifdef PROFILE_EVENTS
+	// start the free running cycle counter
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	eventProfileReset();
+#endif
 
 	if (HAL_TIM_Base_Start_IT(&htim3) != HAL_OK) {
 		printf("[ERROR] Timer 3 did not start\n\r");
@@ -93,105 +630,240 @@ EventReturnCode eventControllerInit(void) {
 /* eventSchedule()
  *	takes the idx of an event and depending on its scheduling flag
  *	sets it's scheduling time for when the eventRunner should call
- *	its callback. Immedaiates, N repeats
+ *	its callback, then (re)positions it in the deadline heap.
+ *	Immedaiates, N repeats
  */
-EventReturnCode eventSchedule(uint8_t idx) {
+static EventReturnCode eventSchedule(uint8_t idx) {
 	uint8_t schedule_offset = time_ms % 7; //Hopefully helps to cheaply redistribute scheduling
 
-	switch(events[idx].flag) {
+	switch(event_flag[idx]) {
 	case EVENT_SINGLE:
-		events[idx].schedule_time = time_ms + schedule_offset + events[idx].context;
+		event_deadline[idx] = time_ms + schedule_offset + event_period[idx];
 		break;
 	case EVENT_SINGLE_IMMEDIATE:
-		events[idx].schedule_time = time_ms + events[idx].context;
+		event_deadline[idx] = time_ms + event_period[idx];
 		break;
 	case EVENT_DELTA:
-		events[idx].schedule_time = time_ms + schedule_offset;
+		event_deadline[idx] = time_ms + schedule_offset;
 		break;
 	case EVENT_DELTA_IMMEDIATE:
-		events[idx].schedule_time = time_ms;
+		event_deadline[idx] = time_ms;
 		break;
 	case EVENT_N_REPEAT:
-		events[idx].schedule_time = time_ms + schedule_offset;
+		event_deadline[idx] = time_ms + schedule_offset;
 		break;
 	case EVENT_N_REPEAT_IMMEDIATE:
-		events[idx].schedule_time = time_ms;
+		event_deadline[idx] = time_ms;
+		break;
+	case EVENT_PERIODIC:
+	case EVENT_PERIODIC_CATCHUP:
+		// no offset, the first deadline sets the phase
+		event_deadline[idx] = time_ms;
 		break;
 	default:
 #ifdef DEBUG_EVENT_CONTROLLER
-		printf("[ERROR] Bad event type, not scheduled, ID: %ls\n\r", (int*) &events[idx]);
+		printf("[ERROR] Bad event type, not scheduled, slot: %u\n\r", idx);
 #endif 
 		return EVENT_GENERIC_ERROR;
 	}
 
+	event_release[idx] = event_deadline[idx];
+	heapQueue(idx);
+
 #ifdef DEBUG_EVENT_CONTROLLER
 	printf("[INFO] Scheduled ");
-	eventPrint(&events[idx]);
+	eventPrint(idx);
 #endif
 
 	return EVENT_SUCCESS;
 }
 
+/* eventJitterRecord()
+ *	files how late an activation released at deadline started. Below a
+ *	millisecond the TIM3 count gives the fraction of the current tick,
+ *	which only holds while the tick is 1 ms long, i.e. outside eventIdle.
+ */
+static void eventJitterRecord(EventJitter *j, uint32_t deadline) {
+	uint32_t late_ms = eventBefore(time_ms, deadline) ? 0 : time_ms - deadline;
+	uint32_t late_us = late_ms * 1000;
+
+	if (tick_span == 1) {
+		late_us += __HAL_TIM_GET_COUNTER(&htim3) * 1000 / tick_counts;
+	}
+
+	++j->runs;
+	j->total_late_us += late_us;
+	if (late_us > j->max_late_us) {
+		j->max_late_us = late_us;
+	}
+}
+
+/* eventNextPeriod()
+ *	next deadline of a periodic event, one period on from the deadline
+ *	it was released for. If that one has already passed the event
+ *	overran: PERIODIC skips forward to the first boundary not yet past,
+ *	PERIODIC_CATCHUP keeps the missed deadlines unless it has fallen
+ *	more than EVENT_CATCHUP_MAX periods behind.
+ */
+static uint32_t eventNextPeriod(uint8_t idx) {
+	uint32_t period = event_period[idx] ? event_period[idx] : 1;
+	uint32_t next = event_release[idx] + period;
+
+	if (!eventBefore(next, time_ms)) return next;
+
+	uint32_t missed = (time_ms - next) / period;
+	if (event_flag[idx] == EVENT_PERIODIC_CATCHUP && missed < EVENT_CATCHUP_MAX) return next;
+
+	next += missed * period;
+	if (eventBefore(next, time_ms)) {
+		next += period;
+		++missed;
+	}
+	event_jitter[idx].skipped += missed;
+	return next;
+}
+
+/* eventJitterGet()
+ *	jitter counters of the live event with this label, NULL if none
+ */
+const EventJitter* eventJitterGet(EventLabel label) {
+	for (uint8_t i = 0; i < MAX_EVENT_COUNT; ++i) {
+		if (event_label[i] == label && label != EVENT_EMPTY) {
+			return &event_jitter[i];
+		}
+	}
+	return NULL;
+}
+
+void eventJitterReset(void) {
+	for (uint8_t i = 0; i < MAX_EVENT_COUNT; ++i) {
+		memset(&event_jitter[i], 0, sizeof(event_jitter[i]));
+	}
+}
+
+/* Built with EVENT_SINGLE_PASS, eventRunner never starts a pass over and
+ * an event that ran waits for the next pass whatever held the loop. Only
+ * there so tools/sim can measure what the restart buys.
+ */
+#ifdef EVENT_SINGLE_PASS
+#define EVENT_PASS_RESTART false
+#else
+#define EVENT_PASS_RESTART true
+#endif
+
 /* eventRunner()
- * 	This function serves as the executor of event callbacks. It simply
- * 	iterates the event loop looking for valid and ready to be run events.
- * 	After it calls an events callback it executes the switch statement to
- * 	see how rescheduling should be handled. Immedates are downgraded to
- * 	their non-immeidate varities. N repeat events have their context fields
- * 	motifided to decrement how many more runs they have. Once they get to
+ * 	This function serves as the executor of event callbacks. Each step
+ * 	takes the most urgent due event: the highest priority class with a
+ * 	due root, earliest deadline first within it, so an idle pass costs
+ * 	one compare per class. Every event runs at most once per pass, but
+ * 	once a callback has held the loop for a tick or more, the events of
+ * 	classes above its own that already ran may run again, so a long NFC
+ * 	or I2C callback can't keep due encoder and audio samples waiting
+ * 	behind the rest of the low priority work. Its own class and those
+ * 	below wait for the next pass, so however long the callbacks take the
+ * 	pass ends and the main loop gets its turn. After it
+ * 	calls an events callback it executes the switch statement to see how
+ * 	rescheduling should be handled. Immedates are downgraded to
+ * 	their non-immeidate varities. N repeat events have their repeat count
+ * 	decremented to track how many more runs they have. Once they get to
  * 	a single remaining run they become singles.
  * */
 void eventRunner(void) {
-	for (uint8_t i = 0; i < MAX_EVENT_COUNT; ++i) {
-		if (events[i].schedule_time <= time_ms && events[i].label != EVENT_EMPTY) {
-
-			events[i].callback();
-
-			//Reschedule or Remove Handler
-			switch(events[i].flag) {
-			case EVENT_DELTA:
-				events[i].schedule_time = time_ms + events[i].context;
-				break;
-
-			case EVENT_DELTA_IMMEDIATE:
-				events[i].flag = EVENT_DELTA;
-				events[i].schedule_time = time_ms + events[i].context;
-				break;
-
-			case EVENT_N_REPEAT_IMMEDIATE: {
-				events[i].flag = EVENT_N_REPEAT;
-
-				uint8_t n = (events[i].context & 0xFF00) >> 8;
-				if (n > 1) {
-					events[i].context = ((n - 1) << 8) | (events[i].context & 0x00FF);
-				} else {
-					events[i].flag = EVENT_SINGLE;
-					events[i].context &= 0x00FF;
-				}
-
-				events[i].schedule_time = time_ms + events[i].context;
-				break;
+	uint32_t pass_start = time_ms;
+	EventPriority ran = EVENT_PRIORITY_HIGH;  /* class of the last callback */
+
+	for (;;) {
+		if (EVENT_PASS_RESTART && time_ms != pass_start) {
+			eventRequeueAbove(ran);
+			pass_start = time_ms;
+		}
+
+		uint8_t p = 0;
+		while (p < EVENT_PRIORITY_COUNT &&
+				(heap_count[p] == 0 || eventBefore(time_ms, event_deadline[event_heap[p][0]]))) {
+			++p;
+		}
+		if (p == EVENT_PRIORITY_COUNT) break;
+
+		uint8_t i = event_heap[p][0];
+
+		heapRemove(i);
+		running = i;
+		ran = p;
+		if (event_yielded[i]) {
+			event_yielded[i] = false;
+		} else {
+			eventJitterRecord(&event_jitter[i], event_release[i]);
+		}
+#ifdef PROFILE_EVENTS
+		EventLabel label = event_label[i];
+		uint32_t late_ms = time_ms - event_deadline[i];
+		uint32_t start = DWT->CYCCNT;
+#endif
+		event_callback[i]();
+#ifdef PROFILE_EVENTS
+		eventProfileRecord(label, DWT->CYCCNT - start, late_ms);
+#endif
+		running = EVENT_NOT_QUEUED;
+
+		// removed by its own callback, the slot can be reused now
+		if (event_label[i] == EVENT_EMPTY) {
+			if (event_co[i] != NULL) {
+				event_co[i]->line = 0;
+				event_co[i] = NULL;
 			}
+			free_slots[free_count++] = i;
+			continue;
+		}
 
-			case EVENT_N_REPEAT: {
-				uint8_t n = (events[i].context & 0xFF00) >> 8;
-				if (n > 1) {
-					events[i].context = ((n - 1) << 8) | (events[i].context & 0x00FF);
-				} else {
-					events[i].flag = EVENT_SINGLE;
-					events[i].context &= 0x00FF;
-				}
-
-				events[i].schedule_time = time_ms + events[i].context;
-				break;
+		// the callback already put itself back on the schedule, it still waits for the next pass
+		if (heap_pos[i] != EVENT_NOT_QUEUED) {
+			if (!event_yielded[i]) {
+				event_release[i] = event_deadline[i];
 			}
+			heapRemove(i);
+			eventDefer(i);
+			continue;
+		}
 
-			default:
-				eventRemove(i);
+		//Reschedule or Remove Handler
+		switch(event_flag[i]) {
+		case EVENT_DELTA:
+			event_deadline[i] = time_ms + event_period[i];
+			break;
+
+		case EVENT_DELTA_IMMEDIATE:
+			event_flag[i] = EVENT_DELTA;
+			event_deadline[i] = time_ms + event_period[i];
+			break;
+
+		case EVENT_N_REPEAT_IMMEDIATE:
+		case EVENT_N_REPEAT:
+			event_flag[i] = EVENT_N_REPEAT;
+			if (event_repeat[i] > 1) {
+				--event_repeat[i];
+			} else {
+				event_flag[i] = EVENT_SINGLE;
 			}
+
+			event_deadline[i] = time_ms + event_period[i];
+			break;
+
+		case EVENT_PERIODIC:
+		case EVENT_PERIODIC_CATCHUP:
+			event_deadline[i] = eventNextPeriod(i);
+			break;
+
+		default:
+			eventRemove(i);
+			continue;
 		}
+
+		event_release[i] = event_deadline[i];
+		eventDefer(i);
 	}
 
+	eventRequeueDeferred();
 }
 
 /* eventTimerCallback()
@@ -217,24 +889,7 @@ void eventDefaultCallback(void) {
  * 	Below are all the debugging functions needed for the event system
  * 	and its structs/enums
  */
-#ifdef DEBUG_EVENT_CONTROLLER
-void eventPrint(Event *event) {
-	printf("Label: %s, Flag: %s, Context: %x, Ptr: %lu\n\r",
-			EventLabelToStr(event->label), EventFlagToStr(event->flag), event->context, (uint32_t)event);
-}
-
-const char* EventReturnCodeToStr(EventReturnCode code) {
-	switch (code) {
-	case EVENT_SUCCESS: return "EVENT_SUCCESS";
-	case EVENT_LABEL_NOT_FOUND: return "EVENT_LABEL_NOT_FOUND";
-	case EVENT_LABEL_ALREADY_USED: return "EVENT_LABEL_ALREADY_USED";
-	case EVENT_INIT_FAILED: return "EVENT_INIT_FAILED";
-	case EVENT_QUEUE_FULL: return "EVENT_QUEUE_FULL";
-	case EVENT_GENERIC_ERROR: return "EVENT_GENERIC_ERROR";
-	default: return "UNKNOWN_RC";
-	}
-}
-
+#if defined(DEBUG_EVENT_CONTROLLER) || defined(PROFILE_EVENTS)
 const char* EventLabelToStr(EventLabel label) {
 	switch (label) {
 	case EVENT_EMPTY: return "EVENT_EMPTY";
@@ -245,9 +900,29 @@ const char* EventLabelToStr(EventLabel label) {
 	case EVENT_AUDIO: return "EVENT_AUDIO";
 	case EVENT_TIMER: return "EVENT_TIMER";
 	case EVENT_ACCELEROMETER: return "EVENT_ACCELEROMETER";
+	case EVENT_MAGNOMETER: return "EVENT_MAGNOMETER";
 	default: return "UNKNOWN_LABEL";
 	}
 }
+#endif
+
+#ifdef DEBUG_EVENT_CONTROLLER
+static void eventPrint(uint8_t idx) {
+	printf("Label: %s, Flag: %s, Period: %lu, Repeat: %lu, Handle: %04x\n\r",
+			EventLabelToStr(event_label[idx]), EventFlagToStr(event_flag[idx]),
+			event_period[idx], event_repeat[idx], eventHandle(idx));
+}
+
+const char* EventReturnCodeToStr(EventReturnCode code) {
+	switch (code) {
+	case EVENT_SUCCESS: return "EVENT_SUCCESS";
+	case EVENT_HANDLE_NOT_FOUND: return "EVENT_HANDLE_NOT_FOUND";
+	case EVENT_INIT_FAILED: return "EVENT_INIT_FAILED";
+	case EVENT_QUEUE_FULL: return "EVENT_QUEUE_FULL";
+	case EVENT_GENERIC_ERROR: return "EVENT_GENERIC_ERROR";
+	default: return "UNKNOWN_RC";
+	}
+}
 
 const char* EventFlagToStr(EventFlag flag) {
 	switch (flag) {
@@ -258,6 +933,8 @@ const char* EventFlagToStr(EventFlag flag) {
 	case EVENT_DELTA_IMMEDIATE: return "EVENT_DELTA_IMMEDIATE";
 	case EVENT_N_REPEAT: return "EVENT_N_REPEAT";
 	case EVENT_N_REPEAT_IMMEDIATE: return "EVENT_N_REPEAT_IMMEDIATE";
+	case EVENT_PERIODIC: return "EVENT_PERIODIC";
+	case EVENT_PERIODIC_CATCHUP: return "EVENT_PERIODIC_CATCHUP";
 	default: return "UNKNOWN_FLAG";
 	}
 }
@@ -0,0 +1,183 @@
+/*
+ * input_log.c
+ *
+ *	input_log:
+ *		Keeps the raw samples and edges the sensors and buttons hand the
+ *		firmware, with their time, in a RAM ring dumped over LPUART on
+ *		request. Records are small deltas from the last value of their
+ *		kind and a sample that didn't change isn't logged at all, so the
+ *		32 KB ring holds minutes of a box being handled and far longer of
+ *		one sitting still. Every caller runs in the main loop, interrupts
+ *		only get in through the signals stateDrainSignals logs.
+ */
+#include "input_log.h"
+
+#ifdef RECORD_INPUTS
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lock_timer.h"
+#include "stm32l4xx_hal.h"
+
+#define INPUT_DT_ESCAPE 31
+
+extern UART_HandleTypeDef hlpuart1;
+
+_Static_assert(INPUT_LOG_BLOCK <= 0xFFFF && INPUT_LOG_BLOCKS <= 0xFFFF, "dump header holds sizes in 16 bits");
+_Static_assert(INPUT_EDGE_BUTTON < 8, "kinds share a byte with dt");
+
+static uint8_t log_blocks[INPUT_LOG_BLOCKS][INPUT_LOG_BLOCK];
+static uint32_t log_started;  // blocks begun since boot, the one being filled is log_started - 1
+static uint16_t log_fill;     // bytes used of that block
+static uint32_t log_time;     // time_ms of the last record
+static Vector3D log_acc, log_mag;
+static uint16_t log_dial;
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+	*p++ = v & 0xFF;
+	*p++ = v >> 8;
+	return p;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v) {
+	return put16(put16(p, v & 0xFFFF), v >> 16);
+}
+
+static uint8_t *putVarint(uint8_t *p, uint32_t v) {
+	while (v >= 0x80) {
+		*p++ = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+// small changes either way take one byte
+static uint8_t *putDelta(uint8_t *p, int32_t delta) {
+	return putVarint(p, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+}
+
+// starts a new block, its keyframe holds the values from before the record that needed it
+static void inputLogBlock(uint32_t at_ms) {
+	uint8_t *p = log_blocks[log_started % INPUT_LOG_BLOCKS];
+
+	memset(p, 0, INPUT_LOG_BLOCK);
+	p = put32(p, at_ms);
+	p = put32(p, lockTimerGetTime());
+	*p++ = state;
+	*p++ = (TIM2->DIER & TIM_DIER_UIE) ? INPUT_KEY_LOCK_TIMER : 0;
+	p = put16(p, log_dial);
+	p = put16(p, log_acc.x_componenet);
+	p = put16(p, log_acc.y_componenet);
+	p = put16(p, log_acc.z_componenet);
+	p = put16(p, log_mag.x_componenet);
+	p = put16(p, log_mag.y_componenet);
+	p = put16(p, log_mag.z_componenet);
+
+	++log_started;
+	log_fill = INPUT_LOG_KEYFRAME;
+	log_time = at_ms;
+}
+
+static void inputLogRecord(InputKind kind, uint32_t at_ms, const uint8_t *payload, uint8_t len) {
+	uint8_t head[6];
+	uint8_t *p = head + 1;
+
+	if ((int32_t)(at_ms - log_time) < 0) at_ms = log_time;  // an edge drained after a later sample
+	if (log_started == 0 || log_fill + sizeof(head) + len > INPUT_LOG_BLOCK) {
+		inputLogBlock(at_ms);
+	}
+
+	uint32_t dt = at_ms - log_time;
+	if (dt < INPUT_DT_ESCAPE) {
+		head[0] = (kind << 5) | dt;
+	} else {
+		head[0] = (kind << 5) | INPUT_DT_ESCAPE;
+		p = putVarint(p, dt);
+	}
+
+	uint8_t *block = log_blocks[(log_started - 1) % INPUT_LOG_BLOCKS];
+	memcpy(block + log_fill, head, p - head);
+	log_fill += p - head;
+	memcpy(block + log_fill, payload, len);
+	log_fill += len;
+	log_time = at_ms;
+}
+
+// logs an accelerometer or magnetometer sample as it comes off the bus, replay holds the last one
+void inputLogSample(InputKind kind, const Vector3D *sample) {
+	Vector3D *last = (kind == INPUT_ACC) ? &log_acc : &log_mag;
+	uint8_t payload[15];
+	uint8_t *p = payload;
+
+	if (sample->x_componenet == last->x_componenet && sample->y_componenet == last->y_componenet &&
+			sample->z_componenet == last->z_componenet) {
+		return;
+	}
+	p = putDelta(p, sample->x_componenet - last->x_componenet);
+	p = putDelta(p, sample->y_componenet - last->y_componenet);
+	p = putDelta(p, sample->z_componenet - last->z_componenet);
+	inputLogRecord(kind, time_ms, payload, p - payload);
+	*last = *sample;
+}
+
+void inputLogPhone(bool present) {
+	inputLogRecord(present ? INPUT_PHONE_IN : INPUT_PHONE_OUT, time_ms, NULL, 0);
+}
+
+// logs the encoder count, only called when it moved
+void inputLogDial(uint16_t count) {
+	uint8_t payload[5];
+	uint8_t *p = putDelta(payload, (int16_t)(count - log_dial));
+
+	inputLogRecord(INPUT_DIAL, time_ms, payload, p - payload);
+	log_dial = count;
+}
+
+// logs an EXTI edge at the time the interrupt took it
+void inputLogEdge(EventSignalSource source, uint32_t at_ms) {
+	inputLogRecord(source == EVENT_SIGNAL_AUDIO ? INPUT_EDGE_AUDIO : INPUT_EDGE_BUTTON, at_ms, NULL, 0);
+}
+
+static uint16_t inputLogSend(uint16_t sum, const uint8_t *data, uint16_t len) {
+	HAL_UART_Transmit(&hlpuart1, (uint8_t *)data, len, 0xFFFF);
+	while (len--) sum += *data++;
+	return sum;
+}
+
+/* inputLogDump()
+ *	Sends the ring over LPUART, oldest block first and the one being
+ *	filled last. The frame is "PLIN", a header of version, keyframe
+ *	size, block size, blocks sent, blocks begun since boot and time_ms
+ *	now (u8, u8, u16, u16, u32, u32), the blocks, then a u16 sum of
+ *	every byte after the magic. A full ring takes about 3 s at 115200
+ *	and holds up the main loop for it.
+ */
+void inputLogDump(void) {
+	uint32_t started = log_started;
+	uint16_t sent = started < INPUT_LOG_BLOCKS ? started : INPUT_LOG_BLOCKS;
+	uint8_t header[14];
+	uint8_t *p = header;
+	uint16_t sum = 0;
+
+	*p++ = INPUT_LOG_VERSION;
+	*p++ = INPUT_LOG_KEYFRAME;
+	p = put16(p, INPUT_LOG_BLOCK);
+	p = put16(p, sent);
+	p = put32(p, started);
+	p = put32(p, time_ms);
+
+	HAL_UART_Transmit(&hlpuart1, (uint8_t *)"PLIN", 4, 0xFFFF);
+	sum = inputLogSend(sum, header, sizeof(header));
+	for (uint32_t b = started - sent; b != started; ++b) {
+		sum = inputLogSend(sum, log_blocks[b % INPUT_LOG_BLOCKS], INPUT_LOG_BLOCK);
+	}
+
+	uint8_t tail[2];
+	put16(tail, sum);
+	HAL_UART_Transmit(&hlpuart1, tail, sizeof(tail), 0xFFFF);
+}
+
+#endif /* RECORD_INPUTS */
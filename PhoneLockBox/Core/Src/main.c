@@ -35,6 +35,7 @@
 #include "lock_timer.h"
 #include "font.h"
 #include "event_controller.h"
+#include "trace.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -63,12 +64,11 @@ TIM_HandleTypeDef htim2;
 TIM_HandleTypeDef htim3;
 
 /* USER CODE BEGIN PV */
+DMA_HandleTypeDef hdma_spi1_tx;
 PN532 pn532;
 
 extern BoxState state;
 extern uint32_t time_ms;
-extern uint8_t audio_count;
-extern SFlag flags[MAX_FLAGS];
 extern bool master_timer_done;
 /* USER CODE END PV */
 
@@ -87,29 +87,19 @@ static void MX_TIM2_Init(void);
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+// Interrupt context: only posts a signal, stateDrainSignals applies it from the main loop
 void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin){
 	if (GPIO_Pin == GPIO_PIN_0) {  // Replace with your actual D0-connected pin
-		if (state == LOCKED_MONITOR_AWAKE || state == LOCKED_MONITOR_ASLEEP) {
-			++audio_count;
-		}else if(state == LOCKED_FULL_AWAKE || state == LOCKED_FULL_ASLEEP) {
-			stateInsertFlag(SFLAG_AUDIO_VOL_HIGH);
-		}
-#ifdef DEBUG_AUDIO
-		printf("[INFO] EXTI 0 Interrupt Triggered from KY-037 D0!\n\r");
-#endif /* DEBUG_AUDIO */
+		eventSignalPost(EVENT_SIGNAL_AUDIO, state);
 	} else if (GPIO_Pin == GPIO_PIN_10) {
-		stateInsertFlag(SFLAG_ROTENC_INTERRUPT);
-#ifdef DEBUG_ROTARY_ENCODER
-		printf("[INFO] EXTI 10 Interrupt Triggered from Rotenc SW\n\r");
-#endif
-
+		eventSignalPost(EVENT_SIGNAL_ROTENC_SWITCH, 0);
 	}
 }
 
 // Callback: timer has rolled over
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
 	if (htim == &htim3 ) {
-		++time_ms;
+		eventTick();
 	} else if (htim == &htim2) {
 		master_timer_done = true;
 	}
@@ -159,6 +149,7 @@ int main(void)
   	   * */
 	ILI9341_Init();
 	ILI9341_Fill_Screen(WHITE);
+	ILI9341_Framebuffer_Enable(true);
 	PN532_I2C_Init(&pn532);
 	accInit();
 	audioInit();
@@ -181,6 +172,7 @@ int main(void)
 
 	while (1)
 	{
+		stateDrainSignals();
 		runStateMachine();
 		eventRunner();
 
@@ -211,6 +203,33 @@ int main(void)
 
 		}
 
+		/*
+		 * Screen updates queued above (and by state transitions)
+		 * are drawn a slice at a time so events keep running
+		 */
+		Render_Task(RENDER_BUDGET_MS);
+
+		/*
+		 * A TRACE_DUMP_CMD byte on LPUART sends the transition trace,
+		 * INPUT_LOG_DUMP_CMD the input log when built with RECORD_INPUTS
+		 */
+		tracePoll();
+
+		/*
+		 * Sleep until the next event or interrupt. The dial is polled
+		 * above while setting the time, so that screen only dozes a tick
+		 * at a time, and the lock screens watch for exact timer values
+		 * so they keep spinning. stateWorkPending keeps a TIM2 expiry
+		 * that lands after runStateMachine from waiting out the sleep
+		 */
+		if (!Render_Pending()) {
+			if (state == UNLOCKED_EMPTY_AWAKE) {
+				eventIdle(1, stateWorkPending);
+			} else if (state != LOCKED_FULL_AWAKE && state != LOCKED_MONITOR_AWAKE) {
+				eventIdle(EVENT_IDLE_MAX_MS, stateWorkPending);
+			}
+		}
+
 
 
     /* USER CODE END WHILE */
@@ -9,14 +9,16 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "pn532.h"
 #include "event_controller.h"
+#include "stm32l4xx_hal.h"
 #include "state_machine.h"
+#include "input_log.h"
 
 extern PN532 pn532;  // external reference to the PN532 NFC module
-
-uint8_t poll_count;  // counter for NFC polling events
+extern I2C_HandleTypeDef hi2c1;  // bus shared with the accelerometer and magnetometer
 
 // Initializes the NFC module, configures the PN532, and gets the firmware version
 void nfcInit(void) {
@@ -46,6 +48,10 @@ bool nfcHasTarget(void) {
 	// Attempt to read the passive target (NFC phone)
 	uid_len = PN532_ReadPassiveTarget(&pn532, uid, PN532_MIFARE_ISO14443A, 1000);
 
+#ifdef RECORD_INPUTS
+	inputLogPhone(uid_len != PN532_STATUS_ERROR);
+#endif
+
 	// If an error occurs while reading the target, return false
 	if (uid_len == PN532_STATUS_ERROR) {
 		return false;
@@ -60,10 +66,33 @@ bool nfcHasTarget(void) {
 	}
 }
 
-// Callback function for handling NFC events with slower polling intervals
-void nfcEventCallbackSlow(void) {
-	// If an NFC target is detected, update the flags to reflect the phone's presence
-	if (nfcHasTarget()) {
+/* NFC Detection
+ *	nfcEventCallbackSlow runs the InListPassiveTarget exchange that
+ *	PN532_ReadPassiveTarget does, as a coroutine: send the command, wait
+ *	for the ACK, wait for the card response, read it. Each wait polls the
+ *	ready byte every NFC_POLL_MS and returns to the main loop in between,
+ *	so a second without a phone no longer stalls everything else in
+ *	PN532_I2C_WaitReady. Only locals that are done with before the next
+ *	yield live on the stack, the rest sit in nfc_detect.
+ */
+static struct {
+	Coroutine co;
+	bool ready;  // result of the last ready poll
+} nfc_detect;
+
+extern const uint8_t PN532_ACK[6];
+
+// true once the PN532 has something for us, never touches a bus a sensor read still owns
+static bool nfcReady(void) {
+	return HAL_I2C_GetState(&hi2c1) == HAL_I2C_STATE_READY && PN532_I2C_IsReady();
+}
+
+// Updates the phone presence flags
+static void nfcSetPresent(bool present) {
+#ifdef RECORD_INPUTS
+	inputLogPhone(present);
+#endif
+	if (present) {
 		stateRemoveFlag(SFLAG_NFC_PHONE_NOT_PRESENT);  // remove the flag indicating phone is not present
 		stateInsertFlag(SFLAG_NFC_PHONE_PRESENT);      // insert the flag indicating phone is present
 	} else {
@@ -72,70 +101,67 @@ void nfcEventCallbackSlow(void) {
 	}
 }
 
-// Callback function to initiate reading from the NFC module (start polling)
-void nfcEventCallbackStart(void) {
-	uint8_t buff[PN532_FRAME_MAX_LENGTH];  // buffer to store the data sent to the NFC module
-	poll_count = 0;  // reset the poll count
+// Callback function for handling NFC events with slower polling intervals
+void nfcEventCallbackSlow(void) {
+	Coroutine *co = &nfc_detect.co;
 
-	// Prepare the frame for starting passive target reading with specific parameters
-	buff[0] = PN532_HOSTTOPN532;                          // command header
-	buff[1] = PN532_COMMAND_INLISTPASSIVETARGET & 0xFF;   // command to list passive targets
-	buff[2] = 0x01;                                       // parameter 1
-	buff[3] = PN532_MIFARE_ISO14443A;                      // parameter 2 (MIFARE ISO14443A protocol)
+	CO_BEGIN(co);
 
-	// Send the frame to the NFC module, if unsuccessful, register the callback again after 25 ms
-	if (PN532_WriteFrame(&pn532, buff, 4) != PN532_ERROR_NONE) {
-		eventRegister(nfcEventCallbackStart, EVENT_NFC_START_READ, EVENT_SINGLE, 25, 0);
-	} else {
-		// If successful, start polling for NFC events (e.g., detecting the presence of a phone)
-		eventRegister(nfcEventCallbackPoll, EVENT_NFC_POLL, EVENT_SINGLE, 10, 0);
-	}
-}
+	CO_WAIT_UNTIL(co, HAL_I2C_GetState(&hi2c1) == HAL_I2C_STATE_READY, 1);
 
-// Callback function to poll the NFC module for status
-void nfcEventCallbackPoll(void) {
-	uint8_t status[] = {0x00};  // buffer to store the status of the NFC module
-	++poll_count;  // increment the poll count
+	{
+		// Prepare the frame for reading one passive target with the MIFARE ISO14443A protocol
+		uint8_t command[] = {PN532_HOSTTOPN532, PN532_COMMAND_INLISTPASSIVETARGET & 0xFF, 0x01, PN532_MIFARE_ISO14443A};
+		if (PN532_WriteFrame(&pn532, command, sizeof(command)) != PN532_STATUS_OK) {
+			nfcSetPresent(false);
+			CO_EXIT(co);
+		}
+	}
 
-	// Read the status from the NFC module (polling for availability)
-	if (PN532_I2C_ReadData(status, sizeof(status)) != PN532_STATUS_OK) {
+	// Verify the ACK
+	CO_WAIT_UNTIL_TIMEOUT(co, (nfc_detect.ready = nfcReady()), NFC_POLL_MS, NFC_TIMEOUT_MS);
+	if (!nfc_detect.ready) {
+		nfcSetPresent(false);
+		CO_EXIT(co);
+	}
+	{
+		uint8_t ack[sizeof(PN532_ACK)] = {0};
+		pn532.read_data(ack, sizeof(ack));
+		if (memcmp(ack, PN532_ACK, sizeof(ack)) != 0) {
 #ifdef DEBUG_NFC
-		// Debugging: print an error message if polling failed
-		printf("[ERROR] NFC I2C poll failed\n\r");
+			printf("[ERROR] NFC did not receive expected ACK\n\r");
 #endif
+			nfcSetPresent(false);
+			CO_EXIT(co);
+		}
 	}
 
-	// If the NFC module is ready, trigger the read operation
-	if (status[0] == PN532_I2C_READY) {
-		eventRegister(nfcEventCallbackRead, EVENT_NFC_READ, EVENT_SINGLE, 25, 0);
-	} else {
-		// If the NFC module is not ready, keep polling every 10 ms
-		eventRegister(nfcEventCallbackPoll, EVENT_NFC_POLL, EVENT_SINGLE, 10, 0);
+	// Wait for the target list, the PN532 only answers once a phone is in the field
+	CO_WAIT_UNTIL_TIMEOUT(co, (nfc_detect.ready = nfcReady()), NFC_POLL_MS, NFC_TIMEOUT_MS);
+	if (!nfc_detect.ready) {
+		nfcSetPresent(false);
+		CO_EXIT(co);
 	}
-}
-
-// Callback function to read data from the NFC module (e.g., phone UID)
-void nfcEventCallbackRead(void) {
-	uint8_t buff[MIFARE_UID_MAX_LENGTH] = {0};  // buffer to store the UID data
-
-	// Read the NFC frame from the module
-	uint32_t frame_length = PN532_ReadFrame(&pn532, buff, 4);
+	{
+		// expect at most one target with a 7 byte UID
+		uint8_t buff[19 + 2] = {0};
+		int32_t frame_length = PN532_ReadFrame(&pn532, buff, sizeof(buff));
+		bool present = frame_length >= 2 + 6 &&
+				buff[0] == PN532_PN532TOHOST && buff[1] == (PN532_COMMAND_INLISTPASSIVETARGET + 1) &&
+				buff[2] == 0x01 && buff[7] <= 7;
 
-	// If the frame does not match the expected format, handle as an error
-	if (!(buff[0] == PN532_PN532TOHOST && buff[1] == (PN532_COMMAND_INLISTPASSIVETARGET + 1))) {
-		// Error state: should handle restart or reset logic here
-	}
-
-	// If the frame length is valid, check if the phone is present
-	if (frame_length - 2 >= 0) {
-		// Insert flag indicating phone is present
-		stateInsertFlag(SFLAG_NFC_PHONE_PRESENT);
-	} else {
-		// Insert flag indicating phone is not present
-		stateInsertFlag(SFLAG_NFC_PHONE_NOT_PRESENT);
+#ifdef DEBUG_NFC
+		if (present) {
+			// Debugging: print the UID of the detected NFC phone
+			printf("Found card with UID: ");
+			for (uint8_t i = 0; i < buff[7]; i++) {
+				printf("%02x ", buff[8 + i]);
+			}
+			printf("\r\n");
+		}
+#endif
+		nfcSetPresent(present);
 	}
 
-	// We keep scheduling the start event to ensure the phone presence is checked periodically
-	eventRegister(nfcEventCallbackStart, EVENT_NFC_START_READ, EVENT_SINGLE, 25, 0);
+	CO_END(co);
 }
-
@@ -452,12 +452,16 @@ int PN532_I2C_WriteData(uint8_t *data, uint16_t count) {
 	return PN532_STATUS_OK;
 }
 
-bool PN532_I2C_WaitReady(uint32_t timeout) {
+bool PN532_I2C_IsReady(void) {
 	uint8_t status[] = {0x00};
+	i2c_read(status, sizeof(status));
+	return status[0] == PN532_I2C_READY;
+}
+
+bool PN532_I2C_WaitReady(uint32_t timeout) {
 	uint32_t tickstart = HAL_GetTick();
 	while (HAL_GetTick() - tickstart < timeout) {
-		i2c_read(status, sizeof(status));
-		if (status[0] == PN532_I2C_READY) {
+		if (PN532_I2C_IsReady()) {
 			return true;
 		} else {
 			HAL_Delay(5);
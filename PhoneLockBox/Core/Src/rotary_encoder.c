@@ -11,10 +11,10 @@
 
 #include "shared.h"
 #include "state_machine.h"
+#include "input_log.h"
 #include "stm32l4xx_hal.h"
 
 extern TIM_HandleTypeDef htim1;  // external timer handle for Timer 1, which is used for rotary encoder
-extern SFlag flags[MAX_FLAGS];   // array to store state flags
 
 int32_t prev_cnt;  // stores the previous counter value to calculate the delta
 
@@ -22,6 +22,9 @@ int32_t prev_cnt;  // stores the previous counter value to calculate the delta
 void rotencInit(void) {
     TIM1->CNT = 30000;  // reset the counter of Timer 1 to a base value (e.g., 30000)
     prev_cnt = TIM1->CNT;  // store the current counter value as the previous value
+#ifdef RECORD_INPUTS
+    inputLogDial(prev_cnt);
+#endif
 
 #ifdef DEBUG_ROTARY_ENCODER
     // Debugging: check if the timer starts successfully for the rotary encoder
@@ -45,6 +48,9 @@ int32_t rotencGetDelta(void) {
         // Calculate the difference (delta) between the current and previous counter values
         int32_t delta = cnt - prev_cnt;
         prev_cnt = cnt;  // update the previous counter value with the current value
+#ifdef RECORD_INPUTS
+        inputLogDial(cnt);
+#endif
 
         return delta;  // return the delta, which indicates the direction of rotation
     }
@@ -18,109 +18,362 @@
 #include "shared.h"
 #include "main.h"
 #include "lock_timer.h"
+#include "trace.h"
+#include "input_log.h"
 
 #define MINUTE 60000  // constant for 1 minute in milliseconds
 
 BoxState previous;  // stores the previous state
 BoxState state;     // current state of the box
-SFlag flags[MAX_FLAGS];  // array for storing flags used in state transitions
+static volatile SFlagSet flags;  // one bit per flag used in state transitions, see SFLAG_BIT
 bool master_timer_done;  // flag to track when the master timer is done
+static uint8_t flag_source[SFLAG_COUNT];  // EventLabel that last set each flag, for the trace
 
-// checks if a flag exists in the flags array
+extern uint8_t audio_count;  // audio edges counted while monitoring, see audio.c
+
+_Static_assert(SFLAG_COUNT <= 32, "every SFlag needs a bit in SFlagSet");
+
+// sets the bits in set and clears those in clear as one exclusive access, returns the set before
+static SFlagSet flagsUpdate(SFlagSet set, SFlagSet clear) {
+    SFlagSet old;
+
+    do {
+        old = __LDREXW(&flags);
+    } while (__STREXW((old & ~clear) | set, &flags) != 0);
+
+    return old;
+}
+
+// checks if a flag is set
 bool hasFlag(SFlag flag) {
-    for (uint8_t i = 0; i < MAX_FLAGS; ++i) {
-        if (flags[i] == flag) return true;  // return true if flag is found
-    }
-    return false;  // return false if flag isn't found
+    return flag < SFLAG_COUNT && (flags & SFLAG_BIT(flag)) != 0;
 }
 
-// adds a flag to the flags array if it's not already present
+// sets a flag, true if it wasn't already set
 bool stateInsertFlag(SFlag flag) {
 #ifdef DEBUG_STATE_CONTROLLER
     printf("[INFO] inserting state flag: %s\n\r", SFlagToStr(flag));
 #endif
 
-    uint8_t empty_idx = MAX_FLAGS;
-    // search for an empty spot to insert the flag
-    for(uint8_t i = 0; i < MAX_FLAGS; ++i) {
-        if (flags[i] == flag) {
-            return false;  // flag is already in the array
-        } else if (flags[i] == SFLAG_NULL && i < empty_idx) {
-            empty_idx = i;  // find the first available empty spot
-        }
-    }
-
-    if (empty_idx < MAX_FLAGS) {
-        flags[empty_idx] = flag;  // insert the flag into the empty spot
-        return true;  // flag inserted successfully
-    }
+    if (flag == SFLAG_NULL || flag >= SFLAG_COUNT) return false;
 
-    return false;  // no available spots to insert the flag
+    flag_source[flag] = eventCurrentLabel();
+    return (flagsUpdate(SFLAG_BIT(flag), 0) & SFLAG_BIT(flag)) == 0;
 }
 
 void stateRemoveFlag(SFlag flag) {
-	for(uint8_t i = 0; i < MAX_FLAGS; ++i) {
-		if (flags[i] == flag) {
-			flags[i] = SFLAG_NULL;
-		}
-	}
+    if (flag == SFLAG_NULL || flag >= SFLAG_COUNT) return;
+
+    flagsUpdate(0, SFLAG_BIT(flag));
 }
 
-// clears all flags by resetting them to SFLAG_NULL
+// every flag that is set right now, test several at once against SFLAG_BIT masks
+SFlagSet stateFlags(void) {
+    return flags;
+}
+
+// clears all flags, a single store so an interrupted update just retries against it
 void clearFlags(void) {
-    for (uint8_t i = 0; i < MAX_FLAGS; ++i) {
-        flags[i] = SFLAG_NULL;  // reset each flag to null
-    }
+    flags = 0;
+}
+
+/* State Event Sets
+ *	Every state lists the events it runs in its state table entry. On a
+ *	transition stateScheduleEvents diffs the running set against the new
+ *	state's:
+ *	an event both states list with the same callback, label, flag and
+ *	delta stays registered with its timing as it was (phase, an NFC
+ *	sequence in flight), the rest are cancelled or registered. Singles
+ *	are the state timeouts and are always armed fresh. Flags are reset
+ *	on every transition, except the level flags a surviving event keeps
+ *	current (box open/closed, phone present/absent) since it won't run
+ *	again straight away to put them back.
+ */
+#define STATE_EVENTS_MAX 5
+#define STATE_EVENT_LEVELS 2
+
+typedef struct {
+	void (*callback) (void);  // NULL ends the set
+	EventLabel label;
+	EventFlag flag;
+	uint32_t delta;
+	SFlag level[STATE_EVENT_LEVELS];  // flags this event keeps current
+} StateEvent;
+
+#define STATE_EVENT_ACC { accDeltaEvent, EVENT_ACCELEROMETER, EVENT_PERIODIC, 10, { SFLAG_NULL } }
+#define STATE_EVENT_ROTENC { rotencDeltaEvent, EVENT_ROTARY_ENCODER, EVENT_DELTA, 1, { SFLAG_NULL } }
+#define STATE_EVENT_MAG(delta) { magBoxStatusEvent, EVENT_MAGNOMETER, EVENT_DELTA, delta, { SFLAG_BOX_OPEN, SFLAG_BOX_CLOSED } }
+#define STATE_EVENT_NFC { nfcEventCallbackSlow, EVENT_NFC_READ, EVENT_DELTA, 1000, { SFLAG_NFC_PHONE_PRESENT, SFLAG_NFC_PHONE_NOT_PRESENT } }
+#define STATE_EVENT_AUDIO { audioEventCallback, EVENT_AUDIO, EVENT_PERIODIC, 1, { SFLAG_NULL } }
+#define STATE_EVENT_TIMEOUT(ms) { eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, ms, { SFLAG_NULL } }
+
+
+/* State Table
+ *	The machine is described once here as const data, one StateDesc per
+ *	state. Transitions are listed in priority order and the first row
+ *	whose mask matches the pass's flag snapshot wins (any flag of the
+ *	mask, or every one for ON_ALL rows). A transition runs the old
+ *	state's exit action, the row's own action, then the new state's
+ *	entry action. The table is indexed through BOX_STATES in shared.h,
+ *	so a state added there without a state_<NAME> entry here fails to
+ *	compile, and the names stateToStr prints come from the same list.
+ */
+#define STATE_TRANSITIONS_MAX 4
+
+typedef struct {
+	SFlagSet mask;  // 0 ends the list
+	bool all;  // every flag in mask has to be set, not just one
+	BoxState target;
+	void (*action) (void);  // runs on this transition only, NULL if none
+} StateTransition;
+
+#define STATE_IRQ_BUTTON 0x01  // rotary encoder switch on EXTI15_10
+#define STATE_IRQ_AUDIO 0x02   // KY-037 D0 on EXTI0
+
+typedef struct {
+	StateTransition on[STATE_TRANSITIONS_MAX];
+	void (*entry) (void);
+	void (*exit) (void);
+	uint8_t irq;  // STATE_IRQ_* enabled while in the state
+	ScreenId screen;
+	StateEvent events[STATE_EVENTS_MAX];
+} StateDesc;
+
+#define SF(flag) SFLAG_BIT(SFLAG_##flag)
+#define ON_ANY(mask, target) { (mask), false, (target), NULL }
+#define ON_ALL(mask, target) { (mask), true, (target), NULL }
+#define ON_ANY_DO(mask, target, action) { (mask), false, (target), (action) }
+
+// the lock timer starts as the shackle closes
+static void stateLock(void) {
+    lockTimerStart();
+    lockEngage();
 }
 
+// cancels the lock timer and opens the shackle
+static void stateUnlock(void) {
+    lockTimerCancel();
+    lockDisenage();
+}
+
+// accelerometer and rotary encoder events to detect box movement and user interaction
+static const StateDesc state_UNLOCKED_EMPTY_ASLEEP = {
+    .on = {
+        ON_ANY(SF(ACC_BOX_MOVED) | SF(ROTENC_INTERRUPT) | SF(ROTENC_ROTATED), UNLOCKED_ASLEEP_TO_AWAKE),
+    },
+    .irq = STATE_IRQ_BUTTON,
+    .screen = SCREEN_ASLEEP,
+    .events = { STATE_EVENT_ACC, STATE_EVENT_ROTENC },
+};
+
+// a timer event to transition after 1 second
+static const StateDesc state_UNLOCKED_ASLEEP_TO_AWAKE = {
+    .on = {
+        ON_ANY(SF(TIMER_COMPLETE), UNLOCKED_EMPTY_AWAKE),
+    },
+    .irq = 0,
+    .screen = SCREEN_POWERING_ON,
+    .events = { STATE_EVENT_TIMEOUT(1000) },
+};
+
+// NFC event to detect phone and timer event to transition after 1 minute
+static const StateDesc state_UNLOCKED_EMPTY_AWAKE = {
+    .on = {
+        ON_ANY(SF(NFC_PHONE_PRESENT), UNLOCKED_FULL_AWAKE_FUNC_A),
+        ON_ANY(SF(TIMER_COMPLETE) | SF(ROTENC_INTERRUPT), UNLOCKED_EMPTY_ASLEEP),
+    },
+    .irq = STATE_IRQ_BUTTON,
+    .screen = SCREEN_EMPTY_AWAKE,
+    .events = { STATE_EVENT_NFC, STATE_EVENT_TIMEOUT(MINUTE) },
+};
+
+// magnetometer, timer, and rotary encoder events to monitor box status and user input
+static const StateDesc state_UNLOCKED_FULL_AWAKE_FUNC_A = {
+    .on = {
+        ON_ANY(SF(NFC_PHONE_NOT_PRESENT), UNLOCKED_EMPTY_AWAKE),
+        ON_ANY(SF(ROTENC_ROTATED), UNLOCKED_FULL_AWAKE_FUNC_B),
+        ON_ANY(SF(TIMER_COMPLETE) | SF(ROTENC_INTERRUPT), UNLOCKED_FULL_ASLEEP),
+    },
+    .irq = 0,
+    .screen = SCREEN_FULL_AWAKE_A,
+    .events = { STATE_EVENT_MAG(1000), STATE_EVENT_TIMEOUT(MINUTE), STATE_EVENT_ROTENC },
+};
+
+// similar to func A, a button press with the lid closed starts locking
+static const StateDesc state_UNLOCKED_FULL_AWAKE_FUNC_B = {
+    .on = {
+        ON_ALL(SF(ROTENC_INTERRUPT) | SF(BOX_CLOSED), UNLOCKED_TO_LOCKED_AWAKE),
+        ON_ANY(SF(ROTENC_ROTATED), UNLOCKED_FULL_AWAKE_FUNC_A),
+        ON_ANY(SF(NFC_PHONE_NOT_PRESENT), UNLOCKED_EMPTY_AWAKE),
+        ON_ANY(SF(TIMER_COMPLETE), UNLOCKED_FULL_ASLEEP),
+    },
+    .irq = STATE_IRQ_BUTTON,
+    .screen = SCREEN_FULL_AWAKE_B,
+    .events = { STATE_EVENT_MAG(1000), STATE_EVENT_TIMEOUT(MINUTE), STATE_EVENT_ROTENC },
+};
+
+// accelerometer, magnetometer, and rotary encoder events to detect movement or interaction
+static const StateDesc state_UNLOCKED_FULL_ASLEEP = {
+    .on = {
+        ON_ANY(SF(NFC_PHONE_NOT_PRESENT), UNLOCKED_EMPTY_AWAKE),
+        ON_ANY(SF(ACC_BOX_MOVED) | SF(ROTENC_ROTATED) | SF(ROTENC_INTERRUPT), UNLOCKED_FULL_AWAKE_FUNC_A),
+    },
+    .irq = STATE_IRQ_BUTTON,
+    .screen = SCREEN_ASLEEP,
+    .events = { STATE_EVENT_ACC, STATE_EVENT_MAG(1000), STATE_EVENT_ROTENC },
+};
+
+// a timer event to lock after 5 seconds, opening the lid, removing the phone or the button cancel
+static const StateDesc state_UNLOCKED_TO_LOCKED_AWAKE = {
+    .on = {
+        ON_ANY(SF(NFC_PHONE_NOT_PRESENT) | SF(BOX_OPEN) | SF(ROTENC_INTERRUPT), UNLOCKED_FULL_AWAKE_FUNC_B),
+        ON_ANY_DO(SF(TIMER_COMPLETE), LOCKED_FULL_AWAKE, stateLock),
+    },
+    .irq = STATE_IRQ_BUTTON,
+    .screen = SCREEN_LOCKING,
+    .events = { STATE_EVENT_TIMEOUT(5000) },
+};
+
+// magnetometer and timer events to monitor box status and transition
+static const StateDesc state_LOCKED_FULL_AWAKE = {
+    .on = {
+        ON_ANY(SF(BOX_OPEN), EMERGENCY_OPEN),
+        ON_ANY(SF(TIMER_COMPLETE), LOCKED_FULL_ASLEEP),
+        ON_ANY(SF(AUDIO_VOL_HIGH), LOCKED_MONITOR_AWAKE),
+    },
+    .irq = STATE_IRQ_AUDIO,
+    .screen = SCREEN_LOCKED_AWAKE,
+    .events = { STATE_EVENT_MAG(1000), STATE_EVENT_TIMEOUT(MINUTE) },
+};
+
+// accelerometer, magnetometer, and rotary encoder events to monitor box movement and user interaction
+static const StateDesc state_LOCKED_FULL_ASLEEP = {
+    .on = {
+        ON_ANY(SF(BOX_OPEN), EMERGENCY_OPEN),
+        ON_ANY(SF(AUDIO_VOL_HIGH), LOCKED_MONITOR_ASLEEP),
+        ON_ANY(SF(ROTENC_INTERRUPT) | SF(ROTENC_ROTATED) | SF(ACC_BOX_MOVED), LOCKED_FULL_AWAKE),
+    },
+    .irq = STATE_IRQ_BUTTON | STATE_IRQ_AUDIO,
+    .screen = SCREEN_ASLEEP,
+    .events = { STATE_EVENT_ACC, STATE_EVENT_MAG(1000), STATE_EVENT_ROTENC },
+};
+
+// magnetometer, timer, and audio detection to monitor box status and listen for audio match
+static const StateDesc state_LOCKED_MONITOR_AWAKE = {
+    .on = {
+        ON_ANY(SF(BOX_OPEN), EMERGENCY_OPEN),
+        ON_ANY(SF(AUDIO_MATCH), LOCKED_FULL_NOTIFICATION_FUNC_B),
+        ON_ANY(SF(AUDIO_NO_MATCH), LOCKED_FULL_AWAKE),
+    },
+    .irq = STATE_IRQ_AUDIO,
+    .screen = SCREEN_MONITOR_AWAKE,
+    .events = { STATE_EVENT_MAG(1000), STATE_EVENT_TIMEOUT(MINUTE), STATE_EVENT_AUDIO },
+};
+
+// accelerometer, magnetometer, timer, rotary encoder, and audio detection to monitor box status
+static const StateDesc state_LOCKED_MONITOR_ASLEEP = {
+    .on = {
+        ON_ANY(SF(BOX_OPEN), EMERGENCY_OPEN),
+        ON_ANY(SF(AUDIO_MATCH), LOCKED_FULL_NOTIFICATION_FUNC_B),
+        ON_ANY(SF(AUDIO_NO_MATCH), LOCKED_FULL_ASLEEP),
+    },
+    .irq = STATE_IRQ_AUDIO,
+    .screen = SCREEN_ASLEEP,
+    .events = { STATE_EVENT_ACC, STATE_EVENT_MAG(10), STATE_EVENT_TIMEOUT(MINUTE), STATE_EVENT_ROTENC, STATE_EVENT_AUDIO },
+};
+
+// magnetometer, timer, and rotary encoder events to monitor box status and handle user interaction
+static const StateDesc state_LOCKED_FULL_NOTIFICATION_FUNC_A = {
+    .on = {
+        ON_ANY(SF(BOX_OPEN), EMERGENCY_OPEN),
+        ON_ANY(SF(ROTENC_INTERRUPT), UNLOCKED_FULL_AWAKE_FUNC_B),
+        ON_ANY(SF(ROTENC_ROTATED), LOCKED_FULL_NOTIFICATION_FUNC_B),
+        ON_ANY(SF(TIMER_COMPLETE), LOCKED_FULL_AWAKE),
+    },
+    .irq = STATE_IRQ_BUTTON,
+    .screen = SCREEN_NOTIFICATION_A,
+    .events = { STATE_EVENT_MAG(1000), STATE_EVENT_TIMEOUT(MINUTE), STATE_EVENT_ROTENC },
+};
+
+// similar to func A
+static const StateDesc state_LOCKED_FULL_NOTIFICATION_FUNC_B = {
+    .on = {
+        ON_ANY(SF(BOX_OPEN), EMERGENCY_OPEN),
+        ON_ANY(SF(ROTENC_ROTATED), LOCKED_FULL_NOTIFICATION_FUNC_A),
+        ON_ANY(SF(TIMER_COMPLETE), LOCKED_FULL_AWAKE),
+    },
+    .irq = STATE_IRQ_BUTTON,
+    .screen = SCREEN_NOTIFICATION_B,
+    .events = { STATE_EVENT_MAG(1000), STATE_EVENT_TIMEOUT(MINUTE), STATE_EVENT_ROTENC },
+};
+
+// the lock lets go on entry, a timer event returns to func B after 5 seconds
+static const StateDesc state_EMERGENCY_OPEN = {
+    .on = {
+        ON_ANY(SF(TIMER_COMPLETE), UNLOCKED_FULL_AWAKE_FUNC_B),
+    },
+    .entry = stateUnlock,
+    .irq = 0,
+    .screen = SCREEN_EMERGENCY_OPEN,
+    .events = { STATE_EVENT_TIMEOUT(5000) },
+};
+
+#define STATE_TABLE_ENTRY(id, name) [id] = &state_##id,
+
+static const StateDesc *const state_table[BOX_STATE_COUNT] = { BOX_STATES(STATE_TABLE_ENTRY) };
+
 // enables or disables interrupts based on the current state
 void inturruptControl(void) {
-    switch(state) {
-        // states where the button interrupt needs to be disabled
-        case UNLOCKED_ASLEEP_TO_AWAKE:
-        case UNLOCKED_FULL_AWAKE_FUNC_A:
-        case LOCKED_FULL_AWAKE:
-        case LOCKED_MONITOR_AWAKE:
-        case LOCKED_MONITOR_ASLEEP:
-        case EMERGENCY_OPEN:
-            HAL_NVIC_DisableIRQ(EXTI15_10_IRQn);  // disables button interrupt
-            break;
-
-        // states where the button interrupt needs to be enabled
-        case UNLOCKED_EMPTY_ASLEEP:
-        case UNLOCKED_EMPTY_AWAKE:
-        case UNLOCKED_FULL_ASLEEP:
-        case UNLOCKED_FULL_AWAKE_FUNC_B:
-        case UNLOCKED_TO_LOCKED_AWAKE:
-        case LOCKED_FULL_NOTIFICATION_FUNC_A:
-        case LOCKED_FULL_NOTIFICATION_FUNC_B:
-        case LOCKED_FULL_ASLEEP:
-            HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);  // enables button interrupt
-            break;
+    uint8_t irq = state_table[state]->irq;
+
+    if (irq & STATE_IRQ_BUTTON) {
+        HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);  // enables button interrupt
+    } else {
+        HAL_NVIC_DisableIRQ(EXTI15_10_IRQn);  // disables button interrupt
     }
 
-    switch(state) {
-        // states where the audio interrupt needs to be disabled
-        case UNLOCKED_EMPTY_ASLEEP:
-        case UNLOCKED_ASLEEP_TO_AWAKE:
-        case UNLOCKED_EMPTY_AWAKE:
-        case UNLOCKED_FULL_AWAKE_FUNC_A:
-        case UNLOCKED_FULL_AWAKE_FUNC_B:
-        case UNLOCKED_FULL_ASLEEP:
-        case UNLOCKED_TO_LOCKED_AWAKE:
-        case LOCKED_FULL_NOTIFICATION_FUNC_A:
-        case LOCKED_FULL_NOTIFICATION_FUNC_B:
-        case EMERGENCY_OPEN:
-            HAL_NVIC_DisableIRQ(EXTI0_IRQn);  // disables audio interrupt
-            break;
-
-        // states where the audio interrupt needs to be enabled
-        case LOCKED_MONITOR_AWAKE:
-        case LOCKED_FULL_ASLEEP:
-        case LOCKED_FULL_AWAKE:
-        case LOCKED_MONITOR_ASLEEP:
-            HAL_NVIC_EnableIRQ(EXTI0_IRQn);  // enables audio interrupt
-            break;
+    if (irq & STATE_IRQ_AUDIO) {
+        HAL_NVIC_EnableIRQ(EXTI0_IRQn);  // enables audio interrupt
+    } else {
+        HAL_NVIC_DisableIRQ(EXTI0_IRQn);  // disables audio interrupt
+    }
+}
+
+// the screen the current state shows, SCREEN_COUNT if the state is bad
+ScreenId stateScreen(void) {
+    if (state >= BOX_STATE_COUNT) return SCREEN_COUNT;
+    return state_table[state]->screen;
+}
+
+// true while an interrupt has left work for runStateMachine, eventIdle calls it with interrupts off
+bool stateWorkPending(void) {
+    return master_timer_done;
+}
+
+// applies the signals the interrupts posted since the last pass, oldest first
+void stateDrainSignals(void) {
+    EventSignal sig;
+
+    while (eventSignalPop(&sig)) {
+#ifdef RECORD_INPUTS
+        inputLogEdge(sig.source, sig.time_ms);
+#endif
+        if (sig.source == EVENT_SIGNAL_AUDIO) {
+            // act on the state the edge arrived in, not the one it is drained in
+            if (sig.arg == LOCKED_MONITOR_AWAKE || sig.arg == LOCKED_MONITOR_ASLEEP) {
+                ++audio_count;
+            } else if (sig.arg == LOCKED_FULL_AWAKE || sig.arg == LOCKED_FULL_ASLEEP) {
+                stateInsertFlag(SFLAG_AUDIO_VOL_HIGH);
+            }
+#ifdef DEBUG_AUDIO
+            printf("[INFO] EXTI 0 Interrupt Triggered from KY-037 D0 at %lu ms!\n\r", sig.time_ms);
+#endif /* DEBUG_AUDIO */
+        } else if (sig.source == EVENT_SIGNAL_ROTENC_SWITCH) {
+            stateInsertFlag(SFLAG_ROTENC_INTERRUPT);
+#ifdef DEBUG_ROTARY_ENCODER
+            printf("[INFO] EXTI 10 Interrupt Triggered from Rotenc SW at %lu ms\n\r", sig.time_ms);
+#endif
+        }
     }
 }
 
@@ -132,314 +385,119 @@ void stateMachineInit(void) {
 // main function for running the state machine and handling transitions
 void runStateMachine(void) {
     BoxState next = state;  // variable to store the next state
-
-    switch (state) {
-        // state transitions for UNLOCKED_EMPTY_ASLEEP
-        case UNLOCKED_EMPTY_ASLEEP:
-            if (hasFlag(SFLAG_ACC_BOX_MOVED) || hasFlag(SFLAG_ROTENC_INTERRUPT) || hasFlag(SFLAG_ROTENC_ROTATED)) {
-                next = UNLOCKED_ASLEEP_TO_AWAKE;  // move to awake state if the box is moved or rotary encoder is triggered
-            }
-            break;
-
-        // state transitions for UNLOCKED_ASLEEP_TO_AWAKE
-        case UNLOCKED_ASLEEP_TO_AWAKE:
-            if (hasFlag(SFLAG_TIMER_COMPLETE)) {
-                next = UNLOCKED_EMPTY_AWAKE;  // after timer completes, move to awake state
-            }
-            break;
-
-        // state transitions for UNLOCKED_EMPTY_AWAKE
-        case UNLOCKED_EMPTY_AWAKE:
-            if (hasFlag(SFLAG_NFC_PHONE_PRESENT)) {
-                next = UNLOCKED_FULL_AWAKE_FUNC_A;  // move to full awake if phone is detected
-            }
-            else if (hasFlag(SFLAG_TIMER_COMPLETE) || hasFlag(SFLAG_ROTENC_INTERRUPT)) {
-                next = UNLOCKED_EMPTY_ASLEEP;  // move to sleep if timer completes or rotary encoder is triggered
-            }
-            break;
-
-        // state transitions for UNLOCKED_FULL_AWAKE_FUNC_A
-        case UNLOCKED_FULL_AWAKE_FUNC_A:
-            if (hasFlag(SFLAG_NFC_PHONE_NOT_PRESENT)) {
-                next = UNLOCKED_EMPTY_AWAKE;  // move to awake state if phone is removed
-            }
-            else if (hasFlag(SFLAG_ROTENC_ROTATED)) {
-                next = UNLOCKED_FULL_AWAKE_FUNC_B;  // move to func B if rotary encoder is rotated
-            } else if (hasFlag(SFLAG_TIMER_COMPLETE) || hasFlag(SFLAG_ROTENC_INTERRUPT)) {
-                next = UNLOCKED_FULL_ASLEEP;  // move to sleep state if timer completes or rotary encoder is triggered
-            }
-            break;
-
-        // state transitions for UNLOCKED_FULL_AWAKE_FUNC_B
-        case UNLOCKED_FULL_AWAKE_FUNC_B:
-            if (hasFlag(SFLAG_ROTENC_INTERRUPT) && hasFlag(SFLAG_BOX_CLOSED)) {
-                next = UNLOCKED_TO_LOCKED_AWAKE;  // transition to locked if box is closed and rotary encoder is triggered
-            }
-            else if (hasFlag(SFLAG_ROTENC_ROTATED)) {
-                next = UNLOCKED_FULL_AWAKE_FUNC_A;  // go back to func A if rotary encoder is rotated
-            } else if (hasFlag(SFLAG_NFC_PHONE_NOT_PRESENT)) {
-                next = UNLOCKED_EMPTY_AWAKE;  // move back to awake state if phone is not present
-            } else if (hasFlag(SFLAG_TIMER_COMPLETE)) {
-                next = UNLOCKED_FULL_ASLEEP;  // move to sleep state if timer completes
-            }
-            break;
-
-        // state transitions for UNLOCKED_FULL_ASLEEP
-        case UNLOCKED_FULL_ASLEEP:
-            if (hasFlag(SFLAG_NFC_PHONE_NOT_PRESENT)) {
-                next = UNLOCKED_EMPTY_AWAKE;  // move to awake state if phone is not present
+    const StateTransition *taken = NULL;  // the row that fired, if any
+    SFlagSet cause = 0;  // the flags of that row which were set
+    SFlagSet f = stateFlags();  // one snapshot for the pass, each row below is a single AND
+
+    if (state < BOX_STATE_COUNT) {
+        const StateTransition *on = state_table[state]->on;
+
+        // first matching row in priority order wins
+        for (uint8_t i = 0; i < STATE_TRANSITIONS_MAX && on[i].mask != 0; ++i) {
+            if (on[i].all ? SFLAG_ALL(f, on[i].mask) : SFLAG_ANY(f, on[i].mask)) {
+                taken = &on[i];
+                next = taken->target;
+                cause = f & taken->mask;
+                break;
             }
-            else if (hasFlag(SFLAG_ACC_BOX_MOVED) || hasFlag(SFLAG_ROTENC_ROTATED) || hasFlag(SFLAG_ROTENC_INTERRUPT)) {
-                next = UNLOCKED_FULL_AWAKE_FUNC_A;  // move to full awake if box is moved or rotary encoder is triggered
-            }
-            break;
-
-        // state transitions for UNLOCKED_TO_LOCKED_AWAKE
-        case UNLOCKED_TO_LOCKED_AWAKE:
-            if ((hasFlag(SFLAG_NFC_PHONE_NOT_PRESENT)) || hasFlag(SFLAG_BOX_OPEN) || hasFlag(SFLAG_ROTENC_INTERRUPT)) {
-                next = UNLOCKED_FULL_AWAKE_FUNC_B;  // move to awake state if box is open or phone is removed
-            } else if (hasFlag(SFLAG_TIMER_COMPLETE)) {
-                next = LOCKED_FULL_AWAKE;  // move to locked state after timer completes
-            }
-            break;
-
-        // state transitions for LOCKED_FULL_AWAKE
-        case LOCKED_FULL_AWAKE:
-            if (hasFlag(SFLAG_BOX_OPEN)) {
-                next = EMERGENCY_OPEN;  // enter emergency open state if the box is open
-            }
-            else if (hasFlag(SFLAG_TIMER_COMPLETE)) {
-                next = LOCKED_FULL_ASLEEP;  // move to asleep state if timer completes
-            }
-            else if (hasFlag(SFLAG_AUDIO_VOL_HIGH)) {
-                next = LOCKED_MONITOR_AWAKE;  // move to monitor awake if audio is detected
-            }
-            break;
-
-        // state transitions for LOCKED_FULL_NOTIFICATION_FUNC_A
-        case LOCKED_FULL_NOTIFICATION_FUNC_A:
-            if (hasFlag(SFLAG_BOX_OPEN)) {
-                next = EMERGENCY_OPEN;  // emergency open if the box is open
-            }
-            else if (hasFlag(SFLAG_ROTENC_INTERRUPT)) {
-                next = UNLOCKED_FULL_AWAKE_FUNC_B;  // unlock if rotary encoder interrupt is detected
-            }
-            else if (hasFlag(SFLAG_ROTENC_ROTATED)) {
-                next = LOCKED_FULL_NOTIFICATION_FUNC_B;  // move to next notification function if rotary encoder is rotated
-            }
-            else if (hasFlag(SFLAG_TIMER_COMPLETE)) {
-                next = LOCKED_FULL_AWAKE;  // move back to awake state if timer completes
-            }
-            break;
-
-        // state transitions for LOCKED_FULL_NOTIFICATION_FUNC_B
-        case LOCKED_FULL_NOTIFICATION_FUNC_B:
-            if (hasFlag(SFLAG_BOX_OPEN)) {
-                next = EMERGENCY_OPEN;  // emergency open if box is open
-            }
-            else if (hasFlag(SFLAG_ROTENC_ROTATED)) {
-                next = LOCKED_FULL_NOTIFICATION_FUNC_A;  // go back to func A if rotary encoder is rotated
-            }
-            else if (hasFlag(SFLAG_TIMER_COMPLETE)) {
-                next = LOCKED_FULL_AWAKE;  // move to awake state if timer completes
-            }
-            break;
-
-        // state transitions for LOCKED_FULL_ASLEEP
-        case LOCKED_FULL_ASLEEP:
-            if (hasFlag(SFLAG_BOX_OPEN)) {
-                next = EMERGENCY_OPEN;  // emergency open if box is open
-            }
-            else if (hasFlag(SFLAG_AUDIO_VOL_HIGH)) {
-                next = LOCKED_MONITOR_ASLEEP;  // move to monitor asleep if high audio is detected
-            }
-            else if (hasFlag(SFLAG_ROTENC_INTERRUPT) || hasFlag(SFLAG_ROTENC_ROTATED) || hasFlag(SFLAG_ACC_BOX_MOVED)) {
-                next = LOCKED_FULL_AWAKE;  // move to awake state if rotary encoder is triggered or box is moved
-            }
-            break;
-
-        // state transitions for LOCKED_MONITOR_AWAKE
-        case LOCKED_MONITOR_AWAKE:
-            if (hasFlag(SFLAG_BOX_OPEN)) {
-                next = EMERGENCY_OPEN;  // emergency open if box is open
-            }
-            else if (hasFlag(SFLAG_AUDIO_MATCH)) {
-                next = LOCKED_FULL_NOTIFICATION_FUNC_B;  // move to notification if audio match is found
-            } else if (hasFlag(SFLAG_AUDIO_NO_MATCH)) {
-                next = LOCKED_FULL_AWAKE;  // go back to full awake if no audio match is found
-            }
-            break;
-
-        // state transitions for LOCKED_MONITOR_ASLEEP
-        case LOCKED_MONITOR_ASLEEP:
-            if (hasFlag(SFLAG_BOX_OPEN)) {
-                next = EMERGENCY_OPEN;  // emergency open if box is open
-            }
-            else if (hasFlag(SFLAG_AUDIO_MATCH)) {
-                next = LOCKED_FULL_NOTIFICATION_FUNC_B;  // go to notification if audio match is found
-            }
-            else if (hasFlag(SFLAG_AUDIO_NO_MATCH)) {
-                next = LOCKED_FULL_ASLEEP;  // go back to sleep if no audio match is found
-            }
-            break;
-
-        // state transitions for EMERGENCY_OPEN
-        case EMERGENCY_OPEN:
-            if (hasFlag(SFLAG_TIMER_COMPLETE)) {
-                next = UNLOCKED_FULL_AWAKE_FUNC_B;  // transition back to awake func B after emergency open
-            }
-            break;
-
-        default:
+        }
+    } else {
 #ifdef DEBUG_STATE_CONTROLLER
-            printf("[ERROR] default case of state machine reached, system in bad state\n\r");
+        printf("[ERROR] state machine outside its table, system in bad state\n\r");
 #endif
-            break;
     }
 
     // if the master timer is done, reset to full awake state
     if (master_timer_done) {
         next = UNLOCKED_FULL_AWAKE_FUNC_A;
+        taken = NULL;
         master_timer_done = false;
     }
 
     // update state if it changes
     if (next != state) {
-        eventClear();  // clear all events associated with the current state
-        clearFlags();  // reset all flags
-
 #ifdef DEBUG_STATE_CONTROLLER
         printf("\n[Info] --- state transition: %s → %s ---\n\r", stateToStr(state), stateToStr(next));
 #endif
+        if (taken != NULL) {
+            traceTransition(state, next, cause, flag_source[__builtin_ctz(cause)], TRACE_CAUSE_FLAGS);
+        } else {
+            traceTransition(state, next, 0, EVENT_EMPTY, TRACE_CAUSE_MASTER_TIMER);
+        }
 
-        stateTransitionCleanup(next);  // handle cleanup when transitioning to the next state
+        // leave the old state and take the transition
+        if (state < BOX_STATE_COUNT && state_table[state]->exit != NULL) state_table[state]->exit();
+        if (taken != NULL && taken->action != NULL) taken->action();
 
         previous = state;
         state = next;
 
         // setup the new state
+        if (state_table[state]->entry != NULL) state_table[state]->entry();
         inturruptControl();  // handle interrupt enabling/disabling
-        stateScheduleEvents();  // schedule events for the new state
+        stateScheduleEvents();  // swap to the new state's events and reset the flags
         screenResolve();  // update the screen if needed
     }
 }
 
-// transition specific logic based on the current state and the next state
-void stateTransitionCleanup(BoxState next) {
-    // if transitioning from unlocked awake to locked awake, start the lock timer and engage the lock
-    if (state == UNLOCKED_TO_LOCKED_AWAKE && next == LOCKED_FULL_AWAKE) {
-        lockTimerStart();  // start the lock timer
-        lockEngage();      // engage the lock
-    }
-    // if transitioning from locked awake or locked asleep to unlocked awake function B, cancel the lock timer and disengage the lock
-    else if ((state == LOCKED_FULL_AWAKE || state == LOCKED_FULL_ASLEEP) && next == UNLOCKED_FULL_AWAKE_FUNC_B) {
-        lockTimerCancel();  // cancel the lock timer
-        lockDisenage();     // disengage the lock
-    }
-    // if transitioning to emergency open, cancel the lock timer and disengage the lock
-    else if (next == EMERGENCY_OPEN) {
-        lockTimerCancel();  // cancel the lock timer
-        lockDisenage();     // disengage the lock
+// the set that is registered right now and the handle of each entry
+static const StateEvent *active_set;
+static EventHandle active_handles[STATE_EVENTS_MAX];
+
+static bool stateEventSame(const StateEvent *a, const StateEvent *b) {
+    return a->callback == b->callback && a->label == b->label &&
+            a->flag == b->flag && a->delta == b->delta;
+}
+
+// index of a running event in the active set the new entry can carry on as, -1 if none
+static int8_t stateEventFind(const StateEvent *e, const bool *taken) {
+    if (active_set == NULL || e->flag == EVENT_SINGLE || e->flag == EVENT_SINGLE_IMMEDIATE) return -1;
+
+    for (uint8_t i = 0; i < STATE_EVENTS_MAX && active_set[i].callback != NULL; ++i) {
+        if (!taken[i] && stateEventSame(&active_set[i], e) && eventValid(active_handles[i])) {
+            return i;
+        }
     }
+    return -1;
 }
 
-// schedules events based on the current state of the box
+// switches the registered events over to the current state's set and resets the flags
 void stateScheduleEvents() {
-    switch (state) {
-        case UNLOCKED_EMPTY_ASLEEP:
-            // schedule accelerometer and rotary encoder events to detect box movement and user interaction
-            eventRegister(accDeltaEvent, EVENT_ACCELEROMETER, EVENT_DELTA, 10, 0);
-            eventRegister(rotencDeltaEvent, EVENT_ROTARY_ENCODER, EVENT_DELTA, 1, 0);
-            break;
-
-        case UNLOCKED_ASLEEP_TO_AWAKE:
-            // schedule a timer event to transition after 1 second
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, 1000, 0);
-            break;
-
-        case UNLOCKED_EMPTY_AWAKE:
-            // schedule NFC event to detect phone and timer event to transition after 1 minute
-            eventRegister(nfcEventCallbackSlow, EVENT_NFC_READ, EVENT_DELTA, 1000, 0);
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, MINUTE, 0);
-            break;
-
-        case UNLOCKED_FULL_AWAKE_FUNC_A:
-            // schedule magnetometer, timer, and rotary encoder events to monitor box status and user input
-            eventRegister(magBoxStatusEvent, EVENT_MAGNOMETER, EVENT_DELTA, 1000, 0);
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, MINUTE, 0);
-            eventRegister(rotencDeltaEvent, EVENT_ROTARY_ENCODER, EVENT_DELTA, 1, 0);
-            break;
-
-        case UNLOCKED_FULL_AWAKE_FUNC_B:
-            // similar to func A, with timer and rotary encoder events to monitor status
-            eventRegister(magBoxStatusEvent, EVENT_MAGNOMETER, EVENT_DELTA, 1000, 0);
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, MINUTE, 0);
-            eventRegister(rotencDeltaEvent, EVENT_ROTARY_ENCODER, EVENT_DELTA, 1, 0);
-            break;
-
-        case UNLOCKED_FULL_ASLEEP:
-            // schedule accelerometer, magnetometer, and rotary encoder events to detect movement or interaction
-            eventRegister(accDeltaEvent, EVENT_ACCELEROMETER, EVENT_DELTA, 10, 0);
-            eventRegister(magBoxStatusEvent, EVENT_ACCELEROMETER, EVENT_DELTA, 1000, 0);
-            eventRegister(rotencDeltaEvent, EVENT_ROTARY_ENCODER, EVENT_DELTA, 1, 0);
-            break;
-
-        case UNLOCKED_TO_LOCKED_AWAKE:
-            // schedule a timer event to transition after 5 seconds
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, 5000, 0);
-            break;
-
-        case LOCKED_FULL_AWAKE:
-            // schedule magnetometer and timer events to monitor box status and transition
-            eventRegister(magBoxStatusEvent, EVENT_MAGNOMETER, EVENT_DELTA, 1000, 0);
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, MINUTE, 0);
-            break;
-
-        case LOCKED_FULL_NOTIFICATION_FUNC_A:
-            // schedule magnetometer, timer, and rotary encoder events to monitor box status and handle user interaction
-            eventRegister(magBoxStatusEvent, EVENT_MAGNOMETER, EVENT_DELTA, 1000, 0);
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, MINUTE, 0);
-            eventRegister(rotencDeltaEvent, EVENT_ROTARY_ENCODER, EVENT_DELTA, 1, 0);
-            break;
-
-        case LOCKED_FULL_NOTIFICATION_FUNC_B:
-            // similar to func A but with accelerometer to check box status
-            eventRegister(magBoxStatusEvent, EVENT_ACCELEROMETER, EVENT_DELTA, 1000, 0);
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, MINUTE, 0);
-            eventRegister(rotencDeltaEvent, EVENT_ROTARY_ENCODER, EVENT_DELTA, 1, 0);
-            break;
-
-        case LOCKED_FULL_ASLEEP:
-            // schedule accelerometer, magnetometer, and rotary encoder events to monitor box movement and user interaction
-            eventRegister(accDeltaEvent, EVENT_ACCELEROMETER, EVENT_DELTA, 10, 0);
-            eventRegister(magBoxStatusEvent, EVENT_ACCELEROMETER, EVENT_DELTA, 1000, 0);
-            eventRegister(rotencDeltaEvent, EVENT_ROTARY_ENCODER, EVENT_DELTA, 1, 0);
-            break;
-
-        case LOCKED_MONITOR_AWAKE:
-            // schedule events for magnetometer, timer, and audio detection to monitor box status and listen for audio match
-            eventRegister(magBoxStatusEvent, EVENT_ACCELEROMETER, EVENT_DELTA, 1000 , 0);
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, MINUTE, 0);
-            eventRegister(audioEventCallback, EVENT_AUDIO, EVENT_DELTA, 1, 0);
-            break;
-
-        case LOCKED_MONITOR_ASLEEP:
-            // schedule events for accelerometer, magnetometer, timer, rotary encoder, and audio detection to monitor box status
-            eventRegister(accDeltaEvent, EVENT_ACCELEROMETER, EVENT_DELTA, 10, 0);
-            eventRegister(magBoxStatusEvent, EVENT_ACCELEROMETER, EVENT_DELTA, 10, 0);
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, MINUTE, 0);
-            eventRegister(rotencDeltaEvent, EVENT_ROTARY_ENCODER, EVENT_DELTA, 1, 0);
-            eventRegister(audioEventCallback, EVENT_AUDIO, EVENT_DELTA, 1, 0);
-            break;
-
-        case EMERGENCY_OPEN:
-            // schedule timer event to transition after 5 seconds in emergency state
-            eventRegister(eventTimerCallback, EVENT_TIMER, EVENT_SINGLE, 5000, 0);
-            break;
-
-        default:
-            break;
+    const StateEvent *set = state_table[state]->events;
+    EventHandle handles[STATE_EVENTS_MAX] = { EVENT_HANDLE_NONE };
+    bool taken[STATE_EVENTS_MAX] = { false };
+    SFlagSet kept = 0;
+
+    // match the events both sets share, along with the level flags they still hold
+    for (uint8_t i = 0; i < STATE_EVENTS_MAX && set[i].callback != NULL; ++i) {
+        int8_t j = stateEventFind(&set[i], taken);
+        if (j < 0) continue;
+
+        taken[j] = true;
+        handles[i] = active_handles[j];
+        for (uint8_t l = 0; l < STATE_EVENT_LEVELS; ++l) {
+            kept |= SFLAG_BIT(set[i].level[l]);
+        }
+    }
+
+    // drop whatever the new state doesn't run
+    for (uint8_t i = 0; active_set != NULL && i < STATE_EVENTS_MAX && active_set[i].callback != NULL; ++i) {
+        if (!taken[i]) {
+            eventCancel(active_handles[i]);
+        }
+    }
+
+    flagsUpdate(0, ~kept);  // reset all flags but the kept levels that are set
+
+    // and start what it adds
+    for (uint8_t i = 0; i < STATE_EVENTS_MAX && set[i].callback != NULL; ++i) {
+        if (handles[i] == EVENT_HANDLE_NONE) {
+            handles[i] = eventRegister(set[i].callback, set[i].label, set[i].flag, set[i].delta, 0);
+        }
     }
+
+    active_set = set;
+    memcpy(active_handles, handles, sizeof(active_handles));
 }
 
 #ifdef DEBUG_STATE_CONTROLLER
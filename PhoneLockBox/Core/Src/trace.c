@@ -0,0 +1,100 @@
+/*
+ * trace.c
+ *
+ *	trace:
+ *		A ring of the last TRACE_RING state transitions. Recording is a
+ *		12 byte store and an index bump from the main loop, so it stays on
+ *		in every build and doesn't move timing the way the DEBUG_OUT
+ *		printfs do. The ring only goes out over LPUART when asked for.
+ */
+#include "trace.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stm32l4xx_hal.h"
+#include "input_log.h"
+
+extern UART_HandleTypeDef hlpuart1;
+
+_Static_assert((TRACE_RING & (TRACE_RING - 1)) == 0, "TRACE_RING must be a power of two");
+_Static_assert(sizeof(TraceEntry) == 12, "TraceEntry is dumped as is, keep trace_decode.py in step");
+_Static_assert(BOX_STATE_COUNT <= 0xFF && EVENT_LABEL_COUNT <= 0xFF, "trace entries hold states and labels in a byte");
+
+static TraceEntry trace_ring[TRACE_RING];
+static uint32_t trace_count;  // entries recorded since boot, the newest is at trace_count - 1
+
+// records a transition, only called from the main loop
+void traceTransition(BoxState from, BoxState to, SFlagSet flags, EventLabel label, TraceCause cause) {
+	TraceEntry *e = &trace_ring[trace_count & (TRACE_RING - 1)];
+
+	e->time_ms = time_ms;
+	e->flags = flags;
+	e->from = from;
+	e->to = to;
+	e->label = label;
+	e->cause = cause;
+	++trace_count;
+}
+
+uint32_t traceCount(void) {
+	return trace_count;
+}
+
+static uint16_t traceSum(uint16_t sum, const uint8_t *data, uint32_t len) {
+	while (len--) sum += *data++;
+	return sum;
+}
+
+static uint16_t traceSend(uint16_t sum, const void *data, uint32_t len) {
+	HAL_UART_Transmit(&hlpuart1, (uint8_t *)data, len, 0xFFFF);
+	return traceSum(sum, data, len);
+}
+
+/* traceDump()
+ *	Sends the ring over LPUART, oldest entry first. The frame is
+ *	"PLTR", a header of version, entry size, entries sent, entries
+ *	recorded since boot and time_ms now (u8, u8, u16, u32, u32), the
+ *	entries, then a u16 sum of every byte after the magic. Blocks for
+ *	the length of the transfer, about 130 ms for a full ring at 115200.
+ */
+void traceDump(void) {
+	uint32_t count = trace_count;
+	uint16_t sent = count < TRACE_RING ? count : TRACE_RING;
+	uint32_t first = (count - sent) & (TRACE_RING - 1);
+	uint32_t split = TRACE_RING - first < sent ? TRACE_RING - first : sent;
+	uint8_t header[12] = {
+		TRACE_VERSION, sizeof(TraceEntry),
+		sent & 0xFF, sent >> 8,
+		count & 0xFF, (count >> 8) & 0xFF, (count >> 16) & 0xFF, count >> 24,
+		time_ms & 0xFF, (time_ms >> 8) & 0xFF, (time_ms >> 16) & 0xFF, time_ms >> 24
+	};
+	uint16_t sum = 0;
+
+	HAL_UART_Transmit(&hlpuart1, (uint8_t *)"PLTR", 4, 0xFFFF);
+	sum = traceSend(sum, header, sizeof(header));
+	sum = traceSend(sum, &trace_ring[first], split * sizeof(TraceEntry));
+	if (sent > split) {
+		sum = traceSend(sum, &trace_ring[0], (sent - split) * sizeof(TraceEntry));
+	}
+
+	uint8_t tail[2] = { sum & 0xFF, sum >> 8 };
+	HAL_UART_Transmit(&hlpuart1, tail, sizeof(tail), 0xFFFF);
+}
+
+// checks LPUART for a dump command without waiting, one register read when nothing arrived
+void tracePoll(void) {
+	if (!__HAL_UART_GET_FLAG(&hlpuart1, UART_FLAG_RXNE)) return;
+
+	uint8_t c = (uint8_t)hlpuart1.Instance->RDR;
+	__HAL_UART_CLEAR_OREFLAG(&hlpuart1);  // a byte sent while we weren't looking mustn't stall the receiver
+
+	if (c == TRACE_DUMP_CMD) {
+		traceDump();
+	}
+#ifdef RECORD_INPUTS
+	else if (c == INPUT_LOG_DUMP_CMD) {
+		inputLogDump();
+	}
+#endif
+}
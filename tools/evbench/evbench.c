@@ -0,0 +1,195 @@
+/*
+ * evbench.c - host benchmark of the event controller's deadline heaps
+ *
+ * Builds event_controller.c unchanged for the host, against the HAL
+ * stand-in in tools/sim/stub, with room for 254 events, and sweeps the
+ * number of live events to show how each operation on the heaps grows
+ * with it:
+ *
+ *     make -C tools/evbench
+ *     tools/evbench/evbench
+ *     tools/evbench/evbench 2000000
+ *
+ * For each count n the table is filled with n periodic events of period
+ * n ms whose phases are a millisecond apart, spread over the labels so
+ * every priority class has some, and then timed:
+ *
+ *     runner       one eventRunner call per millisecond, each of which
+ *                  finds and dispatches the one event that fell due
+ *     idle         an eventRunner call with nothing due, the cost of a
+ *                  main loop pass that runs nothing
+ *     next         eventNextDeadline, as eventIdle calls it
+ *     reschedule   eventReschedule of a random event to a random delay
+ *     cancel+reg   eventCancel of a random event and the eventRegister
+ *                  that takes its slot back
+ *
+ * Every column is host ns per call, median of five runs of the given
+ * number of calls (200000 by default). They only compare counts with
+ * each other, the board is a few hundred times slower.
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stm32l4xx_hal.h"
+#include "event_controller.h"
+#include "state_machine.h"
+
+#define BENCH_RUNS 5
+
+/* What event_controller.c needs from the HAL and the rest of the firmware */
+TIM_TypeDef sim_tim1, sim_tim2, sim_tim3;
+TIM_HandleTypeDef htim3 = { TIM3, { 899, 100 } };
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) {
+	htim->Instance->DIER |= TIM_DIER_UIE;
+	htim->Instance->CR1 |= TIM_CR1_CEN;
+	return HAL_OK;
+}
+
+void HAL_SuspendTick(void) {}
+void HAL_ResumeTick(void) {}
+void __disable_irq(void) {}
+void __enable_irq(void) {}
+void __WFI(void) {}
+
+bool stateInsertFlag(SFlag flag) {
+	(void)flag;
+	return true;
+}
+
+static uint64_t dispatched;
+static EventHandle handles[MAX_EVENT_COUNT];
+static uint32_t rng = 1;
+
+static uint32_t benchRandom(void) {
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static void benchCallback(void) {
+	++dispatched;
+}
+
+static EventLabel benchLabel(unsigned k) {
+	return (EventLabel)(EVENT_EMPTY + 1 + k % (EVENT_LABEL_COUNT - 1));
+}
+
+static double benchNow(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// n live periodic events of period n ms, one falling due every millisecond from now on
+static void benchFill(unsigned n) {
+	eventControllerInit();
+	for (unsigned k = 0; k < n; ++k) {
+		handles[k] = eventRegister(benchCallback, benchLabel(k), EVENT_PERIODIC, n, 0);
+		++time_ms;
+	}
+	eventRunner();
+}
+
+static int benchCompare(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/* benchTime()
+ *	median ns per call of op over BENCH_RUNS runs of calls calls each,
+ *	each on a freshly filled table. *runs gets the callbacks dispatched
+ *	per call.
+ */
+static double benchTime(unsigned n, unsigned calls, void (*op)(unsigned n), double *runs) {
+	double ns[BENCH_RUNS];
+	uint64_t timed = 0;
+
+	for (int r = 0; r < BENCH_RUNS; ++r) {
+		benchFill(n);
+		uint64_t before = dispatched;
+		double start = benchNow();
+		for (unsigned c = 0; c < calls; ++c) {
+			op(n);
+		}
+		ns[r] = (benchNow() - start) / calls;
+		timed += dispatched - before;
+	}
+	if (runs) *runs = (double)timed / ((double)BENCH_RUNS * calls);
+	qsort(ns, BENCH_RUNS, sizeof(ns[0]), benchCompare);
+	return ns[BENCH_RUNS / 2];
+}
+
+static void benchRunner(unsigned n) {
+	(void)n;
+	++time_ms;
+	eventRunner();
+}
+
+static void benchIdle(unsigned n) {
+	(void)n;
+	eventRunner();
+}
+
+static volatile uint32_t next_sink;
+
+static void benchNext(unsigned n) {
+	uint32_t next;
+
+	(void)n;
+	if (eventNextDeadline(&next)) next_sink = next;
+}
+
+static void benchReschedule(unsigned n) {
+	eventReschedule(handles[benchRandom() % n], 1 + benchRandom() % (2 * n));
+}
+
+static void benchCancelRegister(unsigned n) {
+	unsigned k = benchRandom() % n;
+
+	eventCancel(handles[k]);
+	handles[k] = eventRegister(benchCallback, benchLabel(k), EVENT_PERIODIC, n, 0);
+}
+
+int main(int argc, char **argv) {
+	static const unsigned counts[] = { 1, 2, 4, 8, 16, 32, 64, 128, MAX_EVENT_COUNT };
+	unsigned calls = 200000;
+
+	if (argc > 2 || (argc == 2 && (calls = (unsigned)strtoul(argv[1], NULL, 0)) == 0)) {
+		fprintf(stderr, "usage: evbench [calls]\n");
+		return 2;
+	}
+
+	printf("%6s %10s %10s %10s %12s %12s %10s\n", "events", "runner", "idle", "next",
+			"reschedule", "cancel+reg", "runs/call");
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+		unsigned n = counts[i];
+		double ns[5], runs;
+
+		// eventControllerInit reports itself on stdout, keep it out of the table
+		fflush(stdout);
+		int out = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+		dup2(null, STDOUT_FILENO);
+
+		ns[0] = benchTime(n, calls, benchRunner, &runs);
+		ns[1] = benchTime(n, calls, benchIdle, NULL);
+		ns[2] = benchTime(n, calls, benchNext, NULL);
+		ns[3] = benchTime(n, calls, benchReschedule, NULL);
+		ns[4] = benchTime(n, calls, benchCancelRegister, NULL);
+
+		fflush(stdout);
+		dup2(out, STDOUT_FILENO);
+		close(out);
+		close(null);
+		printf("%6u %10.1f %10.1f %10.1f %12.1f %12.1f %10.3f\n", n, ns[0], ns[1], ns[2], ns[3], ns[4], runs);
+	}
+	return 0;
+}
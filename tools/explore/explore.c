@@ -0,0 +1,849 @@
+/*
+ * explore.c - exhaustive state-space explorer for the BoxState machine
+ *
+ * Builds state_machine.c and lock_timer.c unchanged for the host,
+ * against the HAL stand-in in tools/sim/stub and the event controller
+ * stand-in below, and walks every configuration runStateMachine can be
+ * handed from power on, breadth first:
+ *
+ *     make -C tools/explore
+ *     tools/explore/explore
+ *     tools/explore/explore --jobs 8 -v
+ *
+ * A node is what one pass of the main loop sees: the BoxState, the flag
+ * set, master_timer_done, and the lock as lock_timer.c left it (shackle
+ * engaged, TIM2 update interrupt armed, lock time still to run). From a
+ * node the real runStateMachine takes its pass, then any combination of
+ * what the new state lets happen before the next pass gives the next
+ * node: each event the state has registered can run and set its flags,
+ * each EXTI line inturruptControl enabled can post its signal, which the
+ * real stateDrainSignals applies, and an armed TIM2 can fire. Events set
+ * flags as their callbacks do, see explore_source below; that table is
+ * the one place the explorer knows anything the firmware doesn't tell
+ * it, keep it in step with the stateInsertFlag calls in the callbacks.
+ * Nodes are kept in a table indexed by their packed key, so each is
+ * expanded once.
+ *
+ * The report lists:
+ *
+ *     unreachable   BoxStates no node has
+ *     livelock      a cycle the machine goes round with nothing happening
+ *     stuck         nodes from which no input gets back to
+ *                   UNLOCKED_EMPTY_ASLEEP, the state the box boots in
+ *     lock          nodes with the shackle engaged and no lock time left,
+ *                   a box that stays shut past its timer or never armed it
+ *
+ * with the shortest input sequence that leads to the first of each kind.
+ * -v prints one for every BoxState a finding shows up in. The exit
+ * status is 1 if anything was found.
+ *
+ * Jobs. state_machine.c keeps its state in globals, so nodes are
+ * expanded by worker processes, one per core by default, the way
+ * tools/sim spreads sessions; each takes a share of every BFS level and
+ * sends back the nodes it found.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stm32l4xx_hal.h"
+#include "Screen_Driver.h"
+#include "accelerometer.h"
+#include "audio.h"
+#include "event_controller.h"
+#include "lock_timer.h"
+#include "nfc.h"
+#include "rotary_encoder.h"
+#include "shared.h"
+#include "state_machine.h"
+#include "trace.h"
+
+/* Node keys
+ *	flags:SFLAG_COUNT state:4 master_timer_done:1 engaged:1 armed:1 running:1
+ */
+#define KEY_STATE_SHIFT SFLAG_COUNT
+#define KEY_FLAGS ((1u << SFLAG_COUNT) - 1)
+#define KEY_MTD (1u << (SFLAG_COUNT + 4))
+#define KEY_ENGAGED (KEY_MTD << 1)
+#define KEY_ARMED (KEY_MTD << 2)
+#define KEY_RUNNING (KEY_MTD << 3)
+#define KEY_SPACE (KEY_MTD << 4)
+#define KEY_STATE(key) ((BoxState)(((key) >> KEY_STATE_SHIFT) & 0xF))
+
+_Static_assert(BOX_STATE_COUNT <= 16, "node keys hold the state in 4 bits");
+_Static_assert(SFLAG_COUNT + 8 <= 24, "node keys index a table, keep them small");
+
+#define HOME UNLOCKED_EMPTY_ASLEEP
+#define NOT_SEEN UINT32_MAX
+
+/* Inputs
+ *	What can happen between two passes, one source each, packed two bits
+ *	a source: 0 if it stays quiet, otherwise which outcome it had.
+ */
+typedef enum {
+	SRC_ACC,
+	SRC_ROTENC,
+	SRC_MAG,
+	SRC_NFC,
+	SRC_TIMER,
+	SRC_AUDIO,
+	SRC_BUTTON,
+	SRC_CLAP,
+	SRC_MASTER,
+	SRC_COUNT
+} Source;
+
+#define INPUT_GET(input, src) (((input) >> (2 * (src))) & 3)
+#define INPUT_SET(src, outcome) ((uint32_t)(outcome) << (2 * (src)))
+
+/* explore_source
+ *	per source, the event label or interrupt that drives it and the
+ *	names of its outcomes. The flags each outcome sets are in
+ *	exploreApply, mirroring the callbacks.
+ */
+static const struct {
+	EventLabel label;  // EVENT_EMPTY for the interrupt sources
+	uint8_t outcomes;
+	const char *name[3];
+} explore_source[SRC_COUNT] = {
+	[SRC_ACC] = { EVENT_ACCELEROMETER, 1, { "moved" } },
+	[SRC_ROTENC] = { EVENT_ROTARY_ENCODER, 1, { "dial turned" } },
+	[SRC_MAG] = { EVENT_MAGNOMETER, 2, { "lid open", "lid closed" } },
+	[SRC_NFC] = { EVENT_NFC_READ, 2, { "phone in", "phone out" } },
+	[SRC_TIMER] = { EVENT_TIMER, 1, { "state timeout" } },
+	[SRC_AUDIO] = { EVENT_AUDIO, 2, { "knock matched", "knock missed" } },
+	[SRC_BUTTON] = { EVENT_EMPTY, 1, { "press" } },
+	[SRC_CLAP] = { EVENT_EMPTY, 1, { "clap" } },
+	[SRC_MASTER] = { EVENT_EMPTY, 1, { "lock timer done" } },
+};
+
+extern BoxState state;
+extern bool master_timer_done;
+
+/* Event controller stand-in
+ *	Records which events stateScheduleEvents has registered, the signal
+ *	ring holds what the node's input posts for stateDrainSignals.
+ */
+static EventLabel live[MAX_EVENT_COUNT];  // label of each handle, EVENT_EMPTY if free
+static EventSignal signals[2];
+static uint8_t signal_count, signal_next;
+uint8_t audio_count;
+
+EventHandle eventRegister(void *callback, EventLabel label, EventFlag flag, uint32_t delta, uint32_t n_runs) {
+	for (EventHandle h = 0; h < MAX_EVENT_COUNT; ++h) {
+		if (live[h] == EVENT_EMPTY) {
+			live[h] = label;
+			return h + 1;
+		}
+	}
+	fprintf(stderr, "explore: more than MAX_EVENT_COUNT events registered in %s\n", stateToStr(state));
+	exit(1);
+}
+
+EventReturnCode eventCancel(EventHandle handle) {
+	if (handle == EVENT_HANDLE_NONE || handle > MAX_EVENT_COUNT) return EVENT_HANDLE_NOT_FOUND;
+	live[handle - 1] = EVENT_EMPTY;
+	return EVENT_SUCCESS;
+}
+
+bool eventValid(EventHandle handle) {
+	return handle != EVENT_HANDLE_NONE && handle <= MAX_EVENT_COUNT && live[handle - 1] != EVENT_EMPTY;
+}
+
+EventLabel eventCurrentLabel(void) {
+	return EVENT_EMPTY;
+}
+
+bool eventSignalPop(EventSignal *out) {
+	if (signal_next == signal_count) return false;
+	*out = signals[signal_next++];
+	return true;
+}
+
+static bool exploreLive(EventLabel label) {
+	for (uint8_t h = 0; h < MAX_EVENT_COUNT; ++h) {
+		if (live[h] == label) return true;
+	}
+	return false;
+}
+
+// only their addresses are used, to tell one state's events from another's
+static void exploreNeverCalled(void) {
+	fprintf(stderr, "explore: an event callback was called\n");
+	abort();
+}
+
+void accDeltaEvent(void) { exploreNeverCalled(); }
+void magBoxStatusEvent(void) { exploreNeverCalled(); }
+void rotencDeltaEvent(void) { exploreNeverCalled(); }
+void nfcEventCallbackSlow(void) { exploreNeverCalled(); }
+void audioEventCallback(void) { exploreNeverCalled(); }
+void eventTimerCallback(void) { exploreNeverCalled(); }
+
+void traceTransition(BoxState from, BoxState to, SFlagSet flags, EventLabel label, TraceCause cause) {}
+void screenResolve(void) {}
+
+/* HAL stand-in
+ *	Only the lock: the shackle pin, the TIM2 update interrupt that
+ *	lockTimerStart arms and lockTimerCancel disarms, and whether the
+ *	lock time set when it was armed is still running.
+ */
+TIM_TypeDef sim_tim1, sim_tim2, sim_tim3;
+GPIO_TypeDef sim_gpiob, sim_gpiod, sim_gpioe;
+TIM_HandleTypeDef htim2 = { TIM2, { 8999, 30000 } };
+
+static bool nvic_enabled[64];
+static bool lock_running;
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) {
+	htim->Instance->DIER |= TIM_DIER_UIE;
+	if (htim == &htim2) lock_running = true;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim) {
+	htim->Instance->DIER &= ~TIM_DIER_UIE;
+	if (htim == &htim2) lock_running = false;
+	return HAL_OK;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+	if (PinState) {
+		GPIOx->ODR |= GPIO_Pin;
+	} else {
+		GPIOx->ODR &= ~GPIO_Pin;
+	}
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+	nvic_enabled[IRQn] = true;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+	nvic_enabled[IRQn] = false;
+}
+
+/* Expanding a node */
+static void exploreSetFlags(SFlagSet set) {
+	clearFlags();
+	for (uint8_t f = SFLAG_NULL + 1; f < SFLAG_COUNT; ++f) {
+		if (set & SFLAG_BIT(f)) stateInsertFlag(f);
+	}
+}
+
+// the key of the machine as it stands, master_timer_done aside
+static uint32_t exploreKey(void) {
+	return (stateFlags() & KEY_FLAGS) | ((uint32_t)state << KEY_STATE_SHIFT) |
+			((GPIOE->ODR & GPIO_PIN_15) ? KEY_ENGAGED : 0) |
+			((TIM2->DIER & TIM_DIER_UIE) ? KEY_ARMED : 0) |
+			(lock_running ? KEY_RUNNING : 0);
+}
+
+// puts the machine in the node's configuration, with the node state's events registered
+static void exploreLoad(uint32_t key) {
+	memset(live, 0, sizeof(live));
+	state = KEY_STATE(key);
+	stateScheduleEvents();
+	inturruptControl();
+
+	exploreSetFlags(key & KEY_FLAGS);
+	master_timer_done = (key & KEY_MTD) != 0;
+	HAL_GPIO_WritePin(GPIOE, GPIO_PIN_15, (key & KEY_ENGAGED) != 0);
+	TIM2->DIER = (key & KEY_ARMED) ? TIM_DIER_UIE : 0;
+	lock_running = (key & KEY_RUNNING) != 0;
+}
+
+static void exploreSignal(EventSignalSource source, uint8_t arg) {
+	signals[signal_count++] = (EventSignal){ source, arg, 0 };
+}
+
+// sets the flags an outcome of a source leads to, as its callback or interrupt would
+static void exploreApply(Source src, uint8_t outcome) {
+	switch (src) {
+	case SRC_ACC:
+		stateInsertFlag(SFLAG_ACC_BOX_MOVED);
+		break;
+	case SRC_ROTENC:
+		stateInsertFlag(SFLAG_ROTENC_ROTATED);
+		break;
+	case SRC_MAG:
+		stateRemoveFlag(outcome == 1 ? SFLAG_BOX_CLOSED : SFLAG_BOX_OPEN);
+		stateInsertFlag(outcome == 1 ? SFLAG_BOX_OPEN : SFLAG_BOX_CLOSED);
+		break;
+	case SRC_NFC:
+		stateRemoveFlag(outcome == 1 ? SFLAG_NFC_PHONE_NOT_PRESENT : SFLAG_NFC_PHONE_PRESENT);
+		stateInsertFlag(outcome == 1 ? SFLAG_NFC_PHONE_PRESENT : SFLAG_NFC_PHONE_NOT_PRESENT);
+		break;
+	case SRC_TIMER:
+		stateInsertFlag(SFLAG_TIMER_COMPLETE);
+		break;
+	case SRC_AUDIO:
+		stateRemoveFlag(outcome == 1 ? SFLAG_AUDIO_NO_MATCH : SFLAG_AUDIO_MATCH);
+		stateInsertFlag(outcome == 1 ? SFLAG_AUDIO_MATCH : SFLAG_AUDIO_NO_MATCH);
+		break;
+	case SRC_BUTTON:
+		exploreSignal(EVENT_SIGNAL_ROTENC_SWITCH, 0);
+		break;
+	case SRC_CLAP:
+		exploreSignal(EVENT_SIGNAL_AUDIO, state);
+		break;
+	case SRC_MASTER:
+		master_timer_done = true;
+		lock_running = false;  // it fires as the lock time runs out, and every reload after
+		break;
+	default:
+		break;
+	}
+}
+
+// whether the state the pass left the machine in lets a source happen
+static bool exploreCanHappen(Source src) {
+	switch (src) {
+	case SRC_BUTTON: return nvic_enabled[EXTI15_10_IRQn];
+	case SRC_CLAP: return nvic_enabled[EXTI0_IRQn];
+	case SRC_MASTER: return (TIM2->DIER & TIM_DIER_UIE) != 0;
+	default: return exploreLive(explore_source[src].label);
+	}
+}
+
+typedef struct {
+	uint32_t key;
+	uint32_t input;
+} Edge;
+
+/* exploreExpand()
+ *	runs the node's pass and appends a node for every input that can
+ *	follow it, the quiet input first. Returns how many were added.
+ */
+static uint32_t exploreExpand(uint32_t key, Edge *out) {
+	uint8_t outcomes[SRC_COUNT];
+	uint32_t count = 0;
+
+	exploreLoad(key);
+	runStateMachine();
+
+	uint32_t after = exploreKey();
+	bool after_running = lock_running;
+	for (Source s = 0; s < SRC_COUNT; ++s) {
+		outcomes[s] = exploreCanHappen(s) ? explore_source[s].outcomes : 0;
+	}
+
+	// every source quiet or on one of its outcomes, counted like an odometer
+	uint8_t pick[SRC_COUNT] = { 0 };
+	for (;;) {
+		uint32_t input = 0;
+
+		exploreSetFlags(after & KEY_FLAGS);
+		master_timer_done = false;
+		lock_running = after_running;
+		signal_count = signal_next = 0;
+		for (Source s = 0; s < SRC_COUNT; ++s) {
+			if (pick[s] == 0) continue;
+			input |= INPUT_SET(s, pick[s]);
+			exploreApply(s, pick[s]);
+		}
+		stateDrainSignals();
+		out[count++] = (Edge){ exploreKey() | (master_timer_done ? KEY_MTD : 0), input };
+
+		Source s = 0;
+		while (s < SRC_COUNT && pick[s] == outcomes[s]) pick[s++] = 0;
+		if (s == SRC_COUNT) break;
+		++pick[s];
+	}
+	return count;
+}
+
+// the node the box is in as main() enters its loop
+static uint32_t exploreStart(void) {
+	stateMachineInit();
+	lockTimerInit();
+	exploreLoad((uint32_t)state << KEY_STATE_SHIFT);
+	return exploreKey();
+}
+
+/* Workers
+ *	Each takes a list of keys and answers with, per key, the number of
+ *	nodes it leads to and the nodes. The answer is built in full before
+ *	it is written so the workers run side by side while the parent
+ *	reads them one at a time.
+ */
+typedef struct {
+	pid_t pid;
+	int to, from;
+} Worker;
+
+static void exploreRead(int fd, void *buf, size_t len) {
+	size_t got = 0;
+	ssize_t n;
+
+	while (got < len && (n = read(fd, (char *)buf + got, len - got)) > 0) {
+		got += n;
+	}
+	if (got != len) {
+		fprintf(stderr, "explore: a worker went away\n");
+		exit(1);
+	}
+}
+
+static void exploreWrite(int fd, const void *buf, size_t len) {
+	size_t put = 0;
+	ssize_t n;
+
+	while (put < len && (n = write(fd, (const char *)buf + put, len - put)) > 0) {
+		put += n;
+	}
+	if (put != len) {
+		fprintf(stderr, "explore: a worker went away\n");
+		exit(1);
+	}
+}
+
+// most inputs one node can be followed by, every source quiet or on one of its outcomes
+#define EDGES_MAX ((1u << (SRC_COUNT - 3)) * 3 * 3 * 3)
+
+static void exploreWorker(int in, int out) {
+	uint32_t n;
+	Edge edges[EDGES_MAX];
+	uint32_t *keys = NULL;
+	uint8_t *reply = NULL;
+	size_t reply_cap = 0;
+
+	while (read(in, &n, sizeof(n)) == sizeof(n)) {
+		keys = realloc(keys, (n ? n : 1) * sizeof(*keys));
+		exploreRead(in, keys, n * sizeof(*keys));
+
+		size_t len = 0;
+		for (uint32_t i = 0; i < n; ++i) {
+			uint32_t m = exploreExpand(keys[i], edges);
+			size_t need = len + sizeof(m) + m * sizeof(Edge);
+
+			if (need > reply_cap) {
+				reply_cap = need * 2;
+				reply = realloc(reply, reply_cap);
+			}
+			memcpy(reply + len, &m, sizeof(m));
+			memcpy(reply + len + sizeof(m), edges, m * sizeof(Edge));
+			len = need;
+		}
+		exploreWrite(out, reply, len);
+	}
+	_exit(0);
+}
+
+static void exploreSpawn(Worker *w, unsigned jobs) {
+	fflush(stdout);
+	for (unsigned j = 0; j < jobs; ++j) {
+		int to[2], from[2];
+
+		if (pipe(to) != 0 || pipe(from) != 0) {
+			perror("explore: pipe");
+			exit(1);
+		}
+		pid_t pid = fork();
+		if (pid < 0) {
+			perror("explore: fork");
+			exit(1);
+		}
+		if (pid == 0) {
+			close(to[1]);
+			close(from[0]);
+			for (unsigned k = 0; k < j; ++k) {
+				close(w[k].to);
+				close(w[k].from);
+			}
+			exploreWorker(to[0], from[1]);
+		}
+		close(to[0]);
+		close(from[1]);
+		w[j] = (Worker){ pid, to[1], from[0] };
+	}
+}
+
+/* Graph
+ *	Nodes in the order the search found them, so following parent from
+ *	any node gives a shortest input sequence from power on. Edges are
+ *	stored per node, in node order, with the quiet input first.
+ */
+typedef struct {
+	uint32_t key;
+	uint32_t parent;
+	uint32_t input;  // what led here from parent
+	uint32_t first_edge, edge_count;
+} Node;
+
+static Node *nodes;
+static uint32_t node_count, node_cap;
+static Edge *edges;  // key is the index of the node the edge leads to
+static uint64_t edge_count, edge_cap;
+static uint32_t *index_of;  // by key, NOT_SEEN until found
+static unsigned levels;
+
+static uint32_t exploreAddNode(uint32_t key, uint32_t parent, uint32_t input) {
+	if (node_count == node_cap) {
+		node_cap = node_cap ? node_cap * 2 : 4096;
+		nodes = realloc(nodes, node_cap * sizeof(*nodes));
+	}
+	if (nodes == NULL) {
+		fprintf(stderr, "explore: out of memory\n");
+		exit(1);
+	}
+	nodes[node_count] = (Node){ key, parent, input, 0, 0 };
+	index_of[key] = node_count;
+	return node_count++;
+}
+
+static void exploreAddEdge(uint32_t to, uint32_t input) {
+	if (edge_count == edge_cap) {
+		edge_cap = edge_cap ? edge_cap * 2 : 65536;
+		edges = realloc(edges, edge_cap * sizeof(*edges));
+		if (edges == NULL) {
+			fprintf(stderr, "explore: out of memory\n");
+			exit(1);
+		}
+	}
+	edges[edge_count++] = (Edge){ to, input };
+}
+
+/* exploreSearch()
+ *	breadth first from the power on node, one level at a time split
+ *	evenly over the workers.
+ */
+static void exploreSearch(Worker *w, unsigned jobs) {
+	index_of = malloc(KEY_SPACE * sizeof(*index_of));
+	if (index_of == NULL) {
+		fprintf(stderr, "explore: out of memory\n");
+		exit(1);
+	}
+	memset(index_of, 0xFF, KEY_SPACE * sizeof(*index_of));
+
+	uint32_t start = exploreStart();
+	exploreAddNode(start, NOT_SEEN, 0);
+
+	for (uint32_t begin = 0, end = 1; begin < end; begin = end, end = node_count) {
+		uint32_t width = end - begin;
+
+		++levels;
+		for (unsigned j = 0; j < jobs; ++j) {
+			uint32_t from = begin + (uint64_t)width * j / jobs, to = begin + (uint64_t)width * (j + 1) / jobs;
+			uint32_t n = to - from;
+			uint32_t keys[n ? n : 1];
+
+			for (uint32_t i = 0; i < n; ++i) {
+				keys[i] = nodes[from + i].key;
+			}
+			exploreWrite(w[j].to, &n, sizeof(n));
+			exploreWrite(w[j].to, keys, n * sizeof(*keys));
+		}
+
+		for (unsigned j = 0; j < jobs; ++j) {
+			uint32_t from = begin + (uint64_t)width * j / jobs, to = begin + (uint64_t)width * (j + 1) / jobs;
+
+			for (uint32_t i = from; i < to; ++i) {
+				Edge found[EDGES_MAX];
+				uint32_t m;
+
+				exploreRead(w[j].from, &m, sizeof(m));
+				if (m > EDGES_MAX) {
+					fprintf(stderr, "explore: a worker sent %u nodes for one\n", m);
+					exit(1);
+				}
+				exploreRead(w[j].from, found, m * sizeof(Edge));
+
+				nodes[i].first_edge = edge_count;
+				nodes[i].edge_count = m;
+				for (uint32_t k = 0; k < m; ++k) {
+					uint32_t to_index = index_of[found[k].key];
+					if (to_index == NOT_SEEN) to_index = exploreAddNode(found[k].key, i, found[k].input);
+					exploreAddEdge(to_index, found[k].input);
+				}
+			}
+		}
+	}
+}
+
+/* Report */
+static bool verbose;
+
+static void exploreFlags(char *out, size_t len, uint32_t key) {
+	static const char *const names[SFLAG_COUNT] = {
+		[SFLAG_ACC_BOX_MOVED] = "ACC_BOX_MOVED",
+		[SFLAG_ADC_INTERRUPT] = "ADC_INTERRUPT",
+		[SFLAG_ADC_MATCH] = "ADC_MATCH",
+		[SFLAG_ROTENC_INTERRUPT] = "ROTENC_INTERRUPT",
+		[SFLAG_ROTENC_ROTATED] = "ROTENC_ROTATED",
+		[SFLAG_TIMER_COMPLETE] = "TIMER_COMPLETE",
+		[SFLAG_NFC_PHONE_PRESENT] = "NFC_PHONE_PRESENT",
+		[SFLAG_NFC_PHONE_NOT_PRESENT] = "NFC_PHONE_NOT_PRESENT",
+		[SFLAG_BOX_CLOSED] = "BOX_CLOSED",
+		[SFLAG_BOX_OPEN] = "BOX_OPEN",
+		[SFLAG_AUDIO_VOL_HIGH] = "AUDIO_VOL_HIGH",
+		[SFLAG_AUDIO_MATCH] = "AUDIO_MATCH",
+		[SFLAG_AUDIO_NO_MATCH] = "AUDIO_NO_MATCH",
+	};
+	size_t at = 0;
+
+	out[0] = '\0';
+	for (uint8_t f = SFLAG_NULL + 1; f < SFLAG_COUNT; ++f) {
+		if (key & SFLAG_BIT(f)) at += snprintf(out + at, at < len ? len - at : 0, "%s%s", at ? "|" : "", names[f] ? names[f] : "?");
+	}
+	if (key & KEY_MTD) at += snprintf(out + at, at < len ? len - at : 0, "%smaster_timer_done", at ? "|" : "");
+	if (at == 0) snprintf(out, len, "-");
+}
+
+static void exploreInput(char *out, size_t len, uint32_t input) {
+	size_t at = 0;
+
+	out[0] = '\0';
+	for (Source s = 0; s < SRC_COUNT; ++s) {
+		uint8_t o = INPUT_GET(input, s);
+		if (o) at += snprintf(out + at, at < len ? len - at : 0, "%s%s", at ? " + " : "", explore_source[s].name[o - 1]);
+	}
+	if (at == 0) snprintf(out, len, "nothing");
+}
+
+static void exploreNode(uint32_t key) {
+	char flags[256];
+
+	exploreFlags(flags, sizeof(flags), key);
+	printf("%-36s  lock %s%s%s  flags %s\n", stateToStr(KEY_STATE(key)),
+			(key & KEY_ENGAGED) ? "engaged" : "open",
+			(key & KEY_ARMED) ? ", timer armed" : "",
+			(key & KEY_RUNNING) ? ", time left" : "", flags);
+}
+
+// prints the shortest way from power on to a node
+static void explorePath(uint32_t index) {
+	uint32_t path[levels + 1];
+	uint32_t depth = 0;
+	char input[128];
+
+	for (uint32_t i = index; i != NOT_SEEN; i = nodes[i].parent) {
+		path[depth++] = i;
+	}
+	for (uint32_t d = depth; d-- > 0;) {
+		if (nodes[path[d]].parent == NOT_SEEN) {
+			snprintf(input, sizeof(input), "power on");
+		} else {
+			exploreInput(input, sizeof(input), nodes[path[d]].input);
+		}
+		printf("      %-28s ", input);
+		exploreNode(nodes[path[d]].key);
+	}
+}
+
+/* exploreFinding()
+ *	reports the nodes marked in hit: how many in each BoxState, and the
+ *	path to the first found, or to the first in every state with -v.
+ */
+static unsigned exploreFinding(const char *what, const bool *hit) {
+	uint32_t per_state[BOX_STATE_COUNT] = { 0 };
+	uint32_t first[BOX_STATE_COUNT];
+	uint32_t total = 0, first_any = NOT_SEEN;
+
+	for (uint32_t i = 0; i < node_count; ++i) {
+		if (!hit[i]) continue;
+		BoxState s = KEY_STATE(nodes[i].key);
+		if (per_state[s]++ == 0) first[s] = i;
+		if (first_any == NOT_SEEN) first_any = i;
+		++total;
+	}
+
+	printf("\n%s: %u node%s\n", what, total, total == 1 ? "" : "s");
+	for (int s = 0; s < BOX_STATE_COUNT; ++s) {
+		if (per_state[s] == 0) continue;
+		printf("  %-38s %8u\n", stateToStr(s), per_state[s]);
+		if (verbose) explorePath(first[s]);
+	}
+	if (!verbose && first_any != NOT_SEEN) {
+		printf("  shortest:\n");
+		explorePath(first_any);
+	}
+	return total != 0;
+}
+
+static unsigned exploreUnreachable(void) {
+	bool seen[BOX_STATE_COUNT] = { false };
+	unsigned missing = 0;
+
+	for (uint32_t i = 0; i < node_count; ++i) {
+		seen[KEY_STATE(nodes[i].key)] = true;
+	}
+	printf("\nunreachable states:");
+	for (int s = 0; s < BOX_STATE_COUNT; ++s) {
+		if (!seen[s]) {
+			printf("%s %s", missing ? "," : "", stateToStr(s));
+			++missing;
+		}
+	}
+	printf("%s\n", missing ? "" : " none");
+	return missing != 0;
+}
+
+/* exploreLivelock()
+ *	follows the quiet edge, the first of every node, which is where the
+ *	machine goes on its own. A walk that comes back to a node it passed
+ *	through, with a state change on the way, never settles. Every node
+ *	on such a cycle is marked.
+ */
+static unsigned exploreLivelock(void) {
+	uint8_t *mark = calloc(node_count, 1);  // 0 new, 1 on the current walk, 2 done
+	bool *hit = calloc(node_count, sizeof(*hit));
+
+	for (uint32_t i = 0; i < node_count; ++i) {
+		uint32_t n = i;
+
+		while (mark[n] == 0) {
+			mark[n] = 1;
+			n = edges[nodes[n].first_edge].key;
+		}
+		if (mark[n] == 1) {
+			bool moves = false;
+			uint32_t c = n;
+			do {
+				uint32_t next = edges[nodes[c].first_edge].key;
+				moves |= KEY_STATE(nodes[c].key) != KEY_STATE(nodes[next].key);
+				c = next;
+			} while (c != n);
+			if (moves) {
+				do {
+					hit[c] = true;
+					c = edges[nodes[c].first_edge].key;
+				} while (c != n);
+			}
+		}
+		for (n = i; mark[n] == 1; n = edges[nodes[n].first_edge].key) {
+			mark[n] = 2;
+		}
+	}
+
+	unsigned found = exploreFinding("livelock, cycles taken with nothing happening", hit);
+	free(mark);
+	free(hit);
+	return found;
+}
+
+/* exploreStuck()
+ *	marks the nodes some input sequence takes back to HOME, working
+ *	back from HOME over the reversed edges; the rest are stuck.
+ */
+static unsigned exploreStuck(void) {
+	uint32_t *in_count = calloc(node_count + 1, sizeof(*in_count));
+	uint32_t *in_from = malloc(edge_count * sizeof(*in_from));
+	uint32_t *queue = malloc(node_count * sizeof(*queue));
+	bool *home = calloc(node_count, sizeof(*home));
+	bool *hit = malloc(node_count * sizeof(*hit));
+	uint32_t head = 0, tail = 0;
+
+	if (in_count == NULL || in_from == NULL || queue == NULL || home == NULL || hit == NULL) {
+		fprintf(stderr, "explore: out of memory\n");
+		exit(1);
+	}
+
+	// reversed edges, grouped by the node they lead to
+	for (uint64_t e = 0; e < edge_count; ++e) {
+		++in_count[edges[e].key + 1];
+	}
+	for (uint32_t i = 0; i < node_count; ++i) {
+		in_count[i + 1] += in_count[i];
+	}
+	for (uint32_t i = 0; i < node_count; ++i) {
+		for (uint32_t e = nodes[i].first_edge; e < nodes[i].first_edge + nodes[i].edge_count; ++e) {
+			in_from[in_count[edges[e].key]++] = i;
+		}
+	}
+	for (uint32_t i = node_count; i > 0; --i) {
+		in_count[i] = in_count[i - 1];
+	}
+	in_count[0] = 0;
+
+	for (uint32_t i = 0; i < node_count; ++i) {
+		if (KEY_STATE(nodes[i].key) == HOME) {
+			home[i] = true;
+			queue[tail++] = i;
+		}
+	}
+	while (head < tail) {
+		uint32_t n = queue[head++];
+		for (uint32_t e = in_count[n]; e < in_count[n + 1]; ++e) {
+			if (!home[in_from[e]]) {
+				home[in_from[e]] = true;
+				queue[tail++] = in_from[e];
+			}
+		}
+	}
+	for (uint32_t i = 0; i < node_count; ++i) {
+		hit[i] = !home[i];
+	}
+
+	char what[80];
+	snprintf(what, sizeof(what), "stuck, no way back to %s", stateToStr(HOME));
+	unsigned found = exploreFinding(what, hit);
+	free(in_count);
+	free(in_from);
+	free(queue);
+	free(home);
+	free(hit);
+	return found;
+}
+
+static unsigned exploreLock(void) {
+	bool *hit = malloc(node_count * sizeof(*hit));
+
+	for (uint32_t i = 0; i < node_count; ++i) {
+		hit[i] = (nodes[i].key & KEY_ENGAGED) && !(nodes[i].key & KEY_RUNNING);
+	}
+	unsigned found = exploreFinding("lock engaged with no lock time left", hit);
+	free(hit);
+	return found;
+}
+
+static void exploreUsage(void) {
+	fprintf(stderr, "usage: explore [-v] [--jobs J]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned jobs = cores > 0 ? (unsigned)cores : 1;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-v") == 0) {
+			verbose = true;
+		} else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = (unsigned)strtoul(argv[++i], NULL, 0);
+		} else {
+			exploreUsage();
+		}
+	}
+	if (jobs == 0) exploreUsage();
+
+	struct timespec start, stop;
+	Worker w[jobs];
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	exploreSpawn(w, jobs);
+	exploreSearch(w, jobs);
+	for (unsigned j = 0; j < jobs; ++j) {
+		close(w[j].to);
+		close(w[j].from);
+	}
+	while (wait(NULL) > 0) {}
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	printf("%u nodes, %llu edges, %u levels deep, in %.2f s on %u job%s\n", node_count,
+			(unsigned long long)edge_count, levels,
+			(stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9, jobs, jobs == 1 ? "" : "s");
+
+	unsigned found = 0;
+	found += exploreUnreachable();
+	found += exploreLivelock();
+	found += exploreStuck();
+	found += exploreLock();
+	return found ? 1 : 0;
+}
@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+"""
+rgb565_pack.py - convert display art into packed RGB565 assets
+
+Packs an image into the compressed stream drawn by ILI9341_Draw_Packed_Image
+(see Screen_Driver.c) and writes it out as a C header holding the byte array
+and its ILI9341_Packed_Image descriptor. Run it whenever the art changes and
+commit the generated header next to the other assets in Core/Inc.
+
+    tools/rgb565_pack.py graphics/splash.png -o PhoneLockBox/Core/Inc/splash.h
+    tools/rgb565_pack.py PhoneLockBox/Core/Inc/snow_tiger.h --width 320 -o tiger_packed.h
+    tools/rgb565_pack.py art.bin --width 40 --name lock_icon -o lock_icon.h
+
+Inputs: any format Pillow can open, a C header holding one raw RGB565 byte
+array (the old snow_tiger.h style), or a raw .bin of big-endian RGB565. The
+last two need --width. Every run decodes the result again and refuses to
+write a header that does not reproduce the source pixels.
+
+Stream format, one op per pixel or group of pixels. The decoder starts with
+prev = 0x0000 and a zeroed 64 entry index; every decoded pixel becomes prev
+and is stored at index[hash(pixel)], hash = (r*3 + g*5 + b*7) & 63 on the
+5/6/5 bit channels. Channel deltas wrap within the channel width.
+
+    00nnnnnn            RUN      prev repeated n+1 times (1..64)
+    01iiiiii            INDEX    index[i]
+    10rrggbb            DIFF     dr, dg, db each in -2..1, stored +2
+    110ggggg rrrrbbbb   LUMA     dg in -16..15 (+16), dr-dg and db-dg in -8..7 (+8)
+    111nnnnn p0 .. pn   LITERAL  n+1 raw pixels (1..32), big-endian RGB565
+"""
+
+import argparse
+import os
+import re
+import sys
+
+OP_RUN = 0x00
+OP_INDEX = 0x40
+OP_DIFF = 0x80
+OP_LUMA = 0xC0
+OP_LITERAL = 0xE0
+
+RUN_MAX = 64
+LITERAL_MAX = 32
+
+
+def split(px):
+    return (px >> 11) & 0x1F, (px >> 5) & 0x3F, px & 0x1F
+
+
+def join(r, g, b):
+    return ((r & 0x1F) << 11) | ((g & 0x3F) << 5) | (b & 0x1F)
+
+
+def pixel_hash(px):
+    r, g, b = split(px)
+    return (r * 3 + g * 5 + b * 7) & 63
+
+
+def wrap(d, bits):
+    """Signed difference folded into the channel's range."""
+    half = 1 << (bits - 1)
+    return ((d + half) & ((1 << bits) - 1)) - half
+
+
+def encode(pixels):
+    out = bytearray()
+    index = [0] * 64
+    prev = 0
+    run = 0
+    literals = []
+
+    def flush_literals():
+        while literals:
+            chunk = literals[:LITERAL_MAX]
+            del literals[:LITERAL_MAX]
+            out.append(OP_LITERAL | (len(chunk) - 1))
+            for px in chunk:
+                out.extend(px.to_bytes(2, "big"))
+
+    def flush_run():
+        nonlocal run
+        if run:
+            out.append(OP_RUN | (run - 1))
+            run = 0
+
+    for px in pixels:
+        if px == prev:
+            flush_literals()
+            run += 1
+            if run == RUN_MAX:
+                flush_run()
+            continue
+        flush_run()
+
+        h = pixel_hash(px)
+        if index[h] == px:
+            flush_literals()
+            out.append(OP_INDEX | h)
+        else:
+            r, g, b = split(px)
+            pr, pg, pb = split(prev)
+            dr, dg, db = wrap(r - pr, 5), wrap(g - pg, 6), wrap(b - pb, 5)
+            dr_dg, db_dg = dr - dg, db - dg
+            if -2 <= dr <= 1 and -2 <= dg <= 1 and -2 <= db <= 1:
+                flush_literals()
+                out.append(OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2))
+            elif -16 <= dg <= 15 and -8 <= dr_dg <= 7 and -8 <= db_dg <= 7:
+                flush_literals()
+                out.append(OP_LUMA | (dg + 16))
+                out.append(((dr_dg + 8) << 4) | (db_dg + 8))
+            else:
+                literals.append(px)
+        index[h] = px
+        prev = px
+
+    flush_literals()
+    flush_run()
+    return bytes(out)
+
+
+def decode(data, count):
+    """Reference decoder, mirrors ILI9341_Packed_Next in Screen_Driver.c."""
+    pixels = []
+    index = [0] * 64
+    prev = 0
+    i = 0
+    while len(pixels) < count:
+        op = data[i]
+        i += 1
+        if op & 0xC0 == OP_RUN:
+            n = (op & 0x3F) + 1
+            pixels += [prev] * n
+            continue
+        if op & 0xE0 == OP_LITERAL:
+            n = (op & 0x1F) + 1
+            for _ in range(n):
+                px = int.from_bytes(data[i:i + 2], "big")
+                i += 2
+                index[pixel_hash(px)] = px
+                pixels.append(px)
+            prev = pixels[-1]
+            continue
+        if op & 0xC0 == OP_INDEX:
+            px = index[op & 0x3F]
+        elif op & 0xC0 == OP_DIFF:
+            pr, pg, pb = split(prev)
+            px = join(pr + ((op >> 4) & 3) - 2, pg + ((op >> 2) & 3) - 2, pb + (op & 3) - 2)
+        else:
+            dg = (op & 0x1F) - 16
+            nxt = data[i]
+            i += 1
+            pr, pg, pb = split(prev)
+            px = join(pr + dg + (nxt >> 4) - 8, pg + dg, pb + dg + (nxt & 0x0F) - 8)
+        index[pixel_hash(px)] = px
+        pixels.append(px)
+        prev = px
+    return pixels[:count]
+
+
+def load(path, width):
+    ext = os.path.splitext(path)[1].lower()
+    if ext in (".h", ".c"):
+        text = open(path).read()
+        body = text[text.index("{") + 1:text.rindex("}")]
+        raw = bytes(int(v, 16) for v in re.findall(r"0x[0-9a-fA-F]{1,2}", body))
+    elif ext == ".bin":
+        raw = open(path, "rb").read()
+    else:
+        try:
+            from PIL import Image
+        except ImportError:
+            sys.exit("rgb565_pack: Pillow is needed to read %s" % path)
+        img = Image.open(path).convert("RGB")
+        pixels = [join(r >> 3, g >> 2, b >> 3) for r, g, b in img.getdata()]
+        return img.width, img.height, pixels
+
+    if not width:
+        sys.exit("rgb565_pack: --width is required for raw RGB565 input")
+    if len(raw) % (2 * width):
+        sys.exit("rgb565_pack: %d bytes is not a whole number of %d pixel rows" % (len(raw), width))
+    pixels = [(raw[i] << 8) | raw[i + 1] for i in range(0, len(raw), 2)]
+    return width, len(pixels) // width, pixels
+
+
+def write_header(path, name, width, height, data):
+    guard = "INC_%s_H_" % name.upper()
+    with open(path, "w") as f:
+        f.write("/*\n * %s.h\n *\n" % name)
+        f.write(" *  Packed RGB565 asset, %dx%d, %d bytes (raw %d).\n" % (width, height, len(data), width * height * 2))
+        f.write(" *  Generated by tools/rgb565_pack.py, do not edit.\n */\n\n")
+        f.write("#ifndef %s\n#define %s\n\n" % (guard, guard))
+        f.write("#include \"Screen_Driver.h\"\n\n")
+        f.write("static const uint8_t %s_data[%d] = {\n" % (name, len(data)))
+        for i in range(0, len(data), 24):
+            f.write("\t" + ",".join("0x%02x" % b for b in data[i:i + 24]) + ",\n")
+        f.write("};\n\n")
+        f.write("static const ILI9341_Packed_Image %s = { %d, %d, sizeof(%s_data), %s_data };\n\n" % (name, width, height, name, name))
+        f.write("#endif /* %s */\n" % guard)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack display art into an ILI9341_Packed_Image header.")
+    parser.add_argument("input")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("--width", type=int, default=0, help="row width in pixels for raw RGB565 input")
+    parser.add_argument("--name", help="C identifier, defaults to the output file name")
+    args = parser.parse_args()
+
+    width, height, pixels = load(args.input, args.width)
+    data = encode(pixels)
+    if decode(data, len(pixels)) != pixels:
+        sys.exit("rgb565_pack: round trip failed, nothing written")
+
+    name = args.name or re.sub(r"\W", "_", os.path.splitext(os.path.basename(args.output))[0])
+    write_header(args.output, name, width, height, data)
+    print("%s: %dx%d, %d -> %d bytes (%.1f%%)" % (args.output, width, height, len(pixels) * 2, len(data),
+                                                100.0 * len(data) / (len(pixels) * 2)))
+
+
+if __name__ == "__main__":
+    main()
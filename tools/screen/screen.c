@@ -0,0 +1,1177 @@
+/*
+ * screen.c - host checks of the ILI9341 driver
+ *
+ * Builds Screen_Driver.c unchanged for the host, against the HAL
+ * stand-in in tools/sim/stub, with the SPI calls landing here. The
+ * driver is included rather than linked so the checks can reach its
+ * statics:
+ *
+ *     make -C tools/screen check
+ *     tools/screen/screen burst text arc packed
+ *
+ * Every check exits non-zero when it finds a difference.
+ *
+ *     burst    ILI9341_Draw_Colour_Burst through the DMA burst engine
+ *              against the blocking version it replaced, for runs of 0,
+ *              1, 320, 321 and 76800 pixels. HAL_SPI_Transmit_DMA only
+ *              records the transfer; the check then completes transfers
+ *              one at a time and calls HAL_SPI_TxCpltCallback, as the
+ *              DMA interrupt would. The bytes each transfer sends are
+ *              taken when it completes and compared with the buffer as
+ *              it was when the transfer started, so a buffer refilled
+ *              while the DMA still reads it shows up; a byte ramp through
+ *              ILI9341_Burst_Stream makes every staged buffer differ.
+ *
+ *     text     ILI9341_Draw_Text against the character by character,
+ *              pixel by pixel renderer it replaced, with the framebuffer
+ *              off. Both byte streams are decoded into a model of the
+ *              panel's GRAM (CASET, PASET, RAMWR and the window walk) and
+ *              must leave the same pixels. Per state, the strings its
+ *              screen draws are placed as Screen_Op_Draw places them, and
+ *              the SPI transactions, bytes and CS assertions each path
+ *              costs are listed; every printable character of FONT1 to
+ *              FONT4 and strings cut off by the screen edges follow.
+ *
+ *     arc      ILI9341_Draw_RingSector_v2 on the span rasterizer against
+ *              the per-pixel atan2f version it replaced, both drawn into
+ *              the framebuffer, for the countdown ring, the lock shackle,
+ *              a wide band and a disc: 0 to every whole degree (a row
+ *              every 30 is listed, and any that differs), 0 to the
+ *              fractional angles the countdown ring is drawn at, and other
+ *              start angles. The edge pixels the two versions treat
+ *              differently on purpose are counted apart (see arcCompare),
+ *              any other difference fails. Host ns per draw, median of a
+ *              0 to 360 sweep, compare the two; the board is slower.
+ *
+ *     packed   ILI9341_Packed_Next against the images it decodes. Each
+ *              image is written out raw and packed by tools/rgb565_pack.py
+ *              (python3 on the PATH), the bytes are read back from the
+ *              header it writes and decoded one pixel at a time, and again
+ *              by ILI9341_Draw_Packed_Image into the GRAM model; both must
+ *              give the source pixel for pixel. Besides snow_tiger.h the
+ *              images are built to stress one op each: all RUN, all
+ *              LITERAL, an index whose slots keep being taken over, and
+ *              channel ramps that wrap. The ops each stream is made of and
+ *              the host decode rate, in MB/s of pixels out and of packed
+ *              bytes in, are listed.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../PhoneLockBox/Core/Src/Screen_Driver.c"
+#include "snow_tiger.h"
+
+#ifndef PACKER
+#define PACKER "../rgb565_pack.py"
+#endif
+
+/* What Screen_Driver.c needs from the HAL and the rest of the firmware */
+SPI_HandleTypeDef hspi1;
+GPIO_TypeDef sim_gpiob, sim_gpiod, sim_gpioe;
+BoxState state;
+uint32_t max_time_ms;
+
+/* SPI traffic since the last spiCountReset, as the panel sees it */
+typedef struct {
+	uint32_t transactions;  // HAL_SPI_Transmit and HAL_SPI_Transmit_DMA calls
+	uint32_t bytes;
+	uint32_t cs_frames;     // CS assertions
+} SpiCount;
+
+static SpiCount spi_count;
+
+static void spiCountReset(void) {
+	memset(&spi_count, 0, sizeof(spi_count));
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+	if (GPIOx == LCD_CS_PORT && (GPIO_Pin & LCD_CS_PIN) && PinState == GPIO_PIN_RESET && (GPIOx->ODR & LCD_CS_PIN)) {
+		++spi_count.cs_frames;
+	}
+	if (PinState == GPIO_PIN_SET) {
+		GPIOx->ODR |= GPIO_Pin;
+	} else {
+		GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+	}
+}
+
+uint32_t HAL_GetTick(void) {
+	return 0;
+}
+
+void HAL_Delay(uint32_t Delay) {
+	(void)Delay;
+}
+
+ScreenId stateScreen(void) {
+	return SCREEN_ASLEEP;
+}
+
+// 01:23:45 left, so OP_TIME draws more than one digit
+uint32_t lockTimerGetTime(void) {
+	return (1 * 3600 + 23 * 60 + 45) * 1000;
+}
+
+/* The panel's GRAM, rebuilt from the byte stream: CASET and PASET set the
+   window, RAMWR starts at its top left corner and walks it row by row,
+   wrapping back to the top. MADCTL is taken as ILI9341_Init leaves it, so
+   x and y are screen coordinates in the horizontal rotation */
+#define PANEL_W 320
+#define PANEL_H 240
+
+static struct {
+	uint16_t gram[PANEL_H][PANEL_W];
+	uint8_t command;
+	uint8_t param[4];
+	uint8_t params;
+	uint16_t xs, xe, ys, ye;
+	uint16_t x, y;
+	uint8_t high;  // first byte of the pixel being written
+	bool half;
+} panel;
+
+static void panelFill(uint16_t colour) {
+	for (int y = 0; y < PANEL_H; ++y) {
+		for (int x = 0; x < PANEL_W; ++x) panel.gram[y][x] = colour;
+	}
+}
+
+static void panelByte(uint8_t byte, bool data) {
+	if (!data) {
+		panel.command = byte;
+		panel.params = 0;
+		if (byte == 0x2C) {
+			panel.x = panel.xs;
+			panel.y = panel.ys;
+			panel.half = false;
+		}
+		return;
+	}
+
+	switch (panel.command) {
+	case 0x2A:
+	case 0x2B:
+		if (panel.params < 4) panel.param[panel.params++] = byte;
+		if (panel.params == 4) {
+			uint16_t start = panel.param[0] << 8 | panel.param[1];
+			uint16_t end = panel.param[2] << 8 | panel.param[3];
+			if (panel.command == 0x2A) {
+				panel.xs = start;
+				panel.xe = end;
+			} else {
+				panel.ys = start;
+				panel.ye = end;
+			}
+		}
+		break;
+
+	case 0x2C:
+		if (!panel.half) {
+			panel.high = byte;
+			panel.half = true;
+			break;
+		}
+		panel.half = false;
+		if (panel.x < PANEL_W && panel.y < PANEL_H) panel.gram[panel.y][panel.x] = panel.high << 8 | byte;
+		if (++panel.x > panel.xe) {
+			panel.x = panel.xs;
+			if (++panel.y > panel.ye) panel.y = panel.ys;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/* Everything the panel was sent with CS low and DC high, in order */
+#define SPI_LOG_MAX (2 * LCD_WIDTH_1 * LCD_HEIGHT_1 + 64)
+
+static struct {
+	uint8_t data[SPI_LOG_MAX];
+	uint32_t length;
+	uint32_t overflow;  // data bytes past the end of the log
+	uint32_t stray;     // bytes sent with CS high
+} spi_log;
+
+static void spiLogReset(void) {
+	memset(&spi_log, 0, sizeof(spi_log));
+}
+
+static bool spiSelected(void) {
+	return !(sim_gpiob.ODR & LCD_CS_PIN);
+}
+
+static void spiLog(const uint8_t *data, uint16_t length) {
+	bool dc = sim_gpiob.ODR & LCD_DC_PIN;
+
+	spi_count.bytes += length;
+	if (!spiSelected()) {
+		spi_log.stray += length;
+		return;
+	}
+	for (uint16_t i = 0; i < length; ++i) panelByte(data[i], dc);
+	if (!dc) return;
+	for (uint16_t i = 0; i < length; ++i) {
+		if (spi_log.length < SPI_LOG_MAX) {
+			spi_log.data[spi_log.length++] = data[i];
+		} else {
+			++spi_log.overflow;
+		}
+	}
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+	(void)hspi;
+	(void)Timeout;
+	++spi_count.transactions;
+	spiLog(pData, Size);
+	return HAL_OK;
+}
+
+/* The one DMA transfer in flight, with the bytes it held when it started.
+   With immediate set a transfer completes before HAL_SPI_Transmit_DMA
+   returns, and the ones the callback starts queue behind it, so driver
+   calls that wait for the burst can follow each other */
+static struct {
+	const uint8_t *data;
+	uint16_t length;
+	uint8_t start[ILI9341_DMA_MAX_TRANSFER];
+	bool pending;
+	bool immediate;
+	bool completing;
+	uint32_t started;
+	uint32_t overlapped;  // started while another was still in flight
+	uint32_t rewritten;   // source changed between start and completion
+} dma;
+
+static void dmaComplete(void);
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size) {
+	(void)hspi;
+	if (dma.pending) ++dma.overlapped;
+	dma.data = pData;
+	dma.length = Size;
+	memcpy(dma.start, pData, Size);
+	dma.pending = true;
+	++dma.started;
+	++spi_count.transactions;
+	if (dma.immediate && !dma.completing) {
+		dma.completing = true;
+		while (dma.pending) dmaComplete();
+		dma.completing = false;
+	}
+	return HAL_OK;
+}
+
+// finish the transfer in flight and take the TX complete interrupt
+static void dmaComplete(void) {
+	if (memcmp(dma.start, dma.data, dma.length) != 0) ++dma.rewritten;
+	spiLog(dma.data, dma.length);
+	dma.pending = false;
+	HAL_SPI_TxCpltCallback(&hspi1);
+}
+
+static void dmaReset(void) {
+	dma.pending = false;
+	dma.started = 0;
+	dma.overlapped = 0;
+	dma.rewritten = 0;
+}
+
+/* ILI9341_Draw_Colour_Burst as it was before the DMA burst engine, sent
+   with blocking transmits. burst_buffer has one spare byte: the original
+   wrote one past its end for odd sizes under BURST_MAX_SIZE / 2 */
+static void Old_Draw_Colour_Burst(uint16_t Colour, uint32_t Size)
+{
+	//SENDS COLOUR
+	uint32_t Buffer_Size = 0;
+	if((Size*2) < BURST_MAX_SIZE)
+	{
+		Buffer_Size = Size;
+	}
+	else
+	{
+		Buffer_Size = BURST_MAX_SIZE;
+	}
+
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+
+	unsigned char chifted = 	Colour>>8;;
+	unsigned char burst_buffer[Buffer_Size + 1];
+	for(uint32_t j = 0; j < Buffer_Size; j+=2)
+	{
+		burst_buffer[j] = 	chifted;
+		burst_buffer[j+1] = Colour;
+	}
+
+	uint32_t Sending_Size = Size*2;
+	uint32_t Sending_in_Block = Sending_Size/Buffer_Size;
+	uint32_t Remainder_from_block = Sending_Size%Buffer_Size;
+
+	if(Sending_in_Block != 0)
+	{
+		for(uint32_t j = 0; j < (Sending_in_Block); j++)
+		{
+			HAL_SPI_Transmit(HSPI_INSTANCE, (unsigned char *)burst_buffer, Buffer_Size, 10);
+		}
+	}
+
+	//REMAINDER!
+	HAL_SPI_Transmit(HSPI_INSTANCE, (unsigned char *)burst_buffer, Remainder_from_block, 10);
+
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+}
+
+/* The text path as it was before text runs: a register write per byte,
+   a background rectangle per character and a window per set pixel */
+//general function to send a char via SPI
+static void Old_SPI_Send(unsigned char SPI_Data)
+{
+	//transmit via our SPI instance
+	HAL_StatusTypeDef rc = HAL_SPI_Transmit(HSPI_INSTANCE, &SPI_Data, 1, 1);
+	(void)rc;
+#ifdef DEBUG_DISPLAY
+	switch(rc) {
+	case HAL_OK:
+		break;
+	case HAL_ERROR:
+		printf("[ERROR] SPI send failed to ILI9341 with generic error code\n\r");
+		break;
+	case HAL_BUSY:
+		printf("[ERROR] SPI send failed to ILI9341, device is busy\n\r");
+		break;
+	case HAL_TIMEOUT:
+		printf("[ERROR] SPI send failed to ILI9341, timeout occurred\n\r");
+		break;
+	}
+#endif /*END DEBUG_DISPLAY*/
+}
+
+//function to sent one command via SPI
+static void Old_Write_Command(uint8_t Command)
+{
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_RESET);
+	Old_SPI_Send(Command);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+}
+
+//function to send one 8 bit int via SPI
+static void Old_Write_Data(uint8_t Data)
+{
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	Old_SPI_Send(Data);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+}
+
+//function to set address range to draw in
+static void Old_Set_Address(uint16_t X1, uint16_t Y1, uint16_t X2, uint16_t Y2)
+{
+	Old_Write_Command(0x2A);
+	Old_Write_Data(X1>>8);
+	Old_Write_Data(X1);
+	Old_Write_Data(X2>>8);
+	Old_Write_Data(X2);
+
+	Old_Write_Command(0x2B);
+	Old_Write_Data(Y1>>8);
+	Old_Write_Data(Y1);
+	Old_Write_Data(Y2>>8);
+	Old_Write_Data(Y2);
+
+	Old_Write_Command(0x2C);
+}
+
+static void Old_Fill_Screen(uint16_t Colour)
+{
+	Old_Set_Address(0,0,LCD_WIDTH,LCD_HEIGHT);
+	Old_Draw_Colour_Burst(Colour, LCD_WIDTH*LCD_HEIGHT);
+}
+
+static void Old_Draw_Pixel(uint16_t X,uint16_t Y,uint16_t Colour)
+{
+	if((X >=LCD_WIDTH) || (Y >=LCD_HEIGHT)) return;	//OUT OF BOUNDS!
+
+	//ADDRESS
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	Old_SPI_Send(0x2A);
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+
+	//XDATA
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	unsigned char Temp_Buffer[4] = {X>>8,X, (X+1)>>8, (X+1)};
+	HAL_SPI_Transmit(HSPI_INSTANCE, Temp_Buffer, 4, 1);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+
+	//ADDRESS
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	Old_SPI_Send(0x2B);
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+
+	//YDATA
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	unsigned char Temp_Buffer1[4] = {Y>>8,Y, (Y+1)>>8, (Y+1)};
+	HAL_SPI_Transmit(HSPI_INSTANCE, Temp_Buffer1, 4, 1);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+
+	//ADDRESS
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_RESET);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	Old_SPI_Send(0x2C);
+	HAL_GPIO_WritePin(LCD_DC_PORT, LCD_DC_PIN, GPIO_PIN_SET);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+
+	//COLOUR
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_RESET);
+	unsigned char Temp_Buffer2[2] = {Colour>>8, Colour};
+	HAL_SPI_Transmit(HSPI_INSTANCE, Temp_Buffer2, 2, 1);
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+
+}
+
+static void Old_Draw_Rectangle(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t Colour)
+{
+	if((X >=LCD_WIDTH) || (Y >=LCD_HEIGHT)) return;
+	if((X+Width-1)>=LCD_WIDTH)
+	{
+		Width=LCD_WIDTH-X;
+	}
+	if((Y+Height-1)>=LCD_HEIGHT)
+	{
+		Height=LCD_HEIGHT-Y;
+	}
+	Old_Set_Address(X, Y, X+Width-1, Y+Height-1);
+	Old_Draw_Colour_Burst(Colour, Height*Width);
+}
+
+//Draw singular char
+static void Old_Draw_Char(char ch, const uint8_t font[], uint16_t X, uint16_t Y, uint16_t color, uint16_t bgcolor)
+{
+	if ((ch < 31) || (ch > 127)) return;
+
+	uint8_t fOffset, fWidth, fHeight, fBPL;
+	uint8_t *tempChar;
+
+	fOffset = font[0];
+	fWidth = font[1];
+	fHeight = font[2];
+	fBPL = font[3];
+
+	tempChar = (uint8_t*)&font[((ch - 0x20) * fOffset) + 4]; /* Current Character = Meta + (Character Index * Offset) */
+
+	/* Clear background first */
+	Old_Draw_Rectangle(X, Y, fWidth, fHeight, bgcolor);
+
+	for (int j=0; j < fHeight; j++)
+	{
+		for (int i=0; i < fWidth; i++)
+		{
+			uint8_t z =  tempChar[fBPL * i + ((j & 0xF8) >> 3) + 1]; /* (j & 0xF8) >> 3, increase one by 8-bits */
+			uint8_t b = 1 << (j & 0x07);
+			if (( z & b ) != 0x00)
+			{
+				Old_Draw_Pixel(X+i, Y+j, color);
+			}
+		}
+	}
+}
+
+//function to draw text via calls of draw char
+static void Old_Draw_Text(const char* str, const uint8_t font[], uint16_t X, uint16_t Y, uint16_t color, uint16_t bgcolor)
+{
+	uint8_t charWidth;			/* Width of character */
+	uint8_t fOffset = font[0];	/* Offset of character */
+	uint8_t fWidth = font[1];	/* Width of font */
+
+	while (*str)
+	{
+		Old_Draw_Char(*str, font, X, Y, color, bgcolor);
+
+		/* Check character width and calculate proper position */
+		uint8_t *tempChar = (uint8_t*)&font[((*str - 0x20) * fOffset) + 4];
+		charWidth = tempChar[0];
+
+		if(charWidth + 2 < fWidth)
+		{
+			/* If character width is smaller than font width */
+			X += (charWidth + 2);
+		}
+		else
+		{
+			X += fWidth;
+		}
+
+		str++;
+	}
+}
+
+// ILI9341_Fill_Callback producing a byte ramp, so every buffer the engine stages differs
+static void rampFill(uint8_t *buffer, uint32_t length, void *context) {
+	uint32_t *next = context;
+
+	for (uint32_t i = 0; i < length; ++i) buffer[i] = (uint8_t)(*next)++ * 7;
+}
+
+static uint8_t burst_expected[SPI_LOG_MAX];
+static uint8_t burst_old[SPI_LOG_MAX];
+
+static bool checkBurst(void) {
+	static const uint32_t sizes[] = { 0, 1, 320, 321, LCD_WIDTH_1 * LCD_HEIGHT_1 };
+	// two colours in turn so the pattern the engine caches has to be rewritten
+	static const uint16_t colours[] = { 0xF81F, 0x07E0 };
+	bool ok = true;
+
+	printf("%7s %7s %9s %9s %10s %9s %8s %8s\n", "pixels", "colour", "new", "old",
+			"transfers", "expected", "old", "in flight");
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		for (size_t c = 0; c < sizeof(colours) / sizeof(colours[0]); ++c) {
+			uint32_t size = sizes[i];
+			uint16_t colour = colours[c];
+			uint32_t old_length = 0;
+			const char *old_match = "-";
+
+			for (uint32_t p = 0; p < size; ++p) {
+				burst_expected[2 * p] = colour >> 8;
+				burst_expected[2 * p + 1] = colour;
+			}
+
+			// the old code divides by zero on an empty run
+			if (size) {
+				spiLogReset();
+				Old_Draw_Colour_Burst(colour, size);
+				old_length = spi_log.length;
+				memcpy(burst_old, spi_log.data, old_length);
+			}
+
+			spiLogReset();
+			dmaReset();
+			ILI9341_Draw_Colour_Burst(colour, size);
+			bool returned_busy = ILI9341_Burst_Busy();
+			uint32_t completions = 0;
+			while (dma.pending && completions <= size) {
+				dmaComplete();
+				++completions;
+			}
+
+			bool released = !ILI9341_Burst_Busy() && !spiSelected() && !dma.pending;
+			bool matches = spi_log.length == 2 * size && memcmp(spi_log.data, burst_expected, 2 * size) == 0;
+			bool clean = !dma.overlapped && !dma.rewritten && !spi_log.stray && !spi_log.overflow;
+			bool old_ok = size && old_length == 2 * size && memcmp(burst_old, burst_expected, 2 * size) == 0;
+
+			if (size) old_match = old_ok ? "yes" : "no";
+			// only a run the old code got right has to come out the same
+			if (old_ok && (spi_log.length != old_length || memcmp(spi_log.data, burst_old, old_length) != 0)) {
+				matches = false;
+			}
+
+			printf("%7u %#7x %9u %9u %10u %9s %8s %8s\n", size, colour, spi_log.length, old_length,
+					dma.started, matches ? "yes" : "no", old_match, clean ? "ok" : "BAD");
+			if (size && !returned_busy) {
+				printf("        ILI9341_Draw_Colour_Burst waited for the transfer to finish\n");
+				ok = false;
+			}
+			if (!released) {
+				printf("        burst still holds the panel after the last transfer\n");
+				ok = false;
+			}
+			if (!matches || !clean) ok = false;
+		}
+	}
+
+	// a producer stream, the refill of the idle buffer has to leave the one in flight alone
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		uint32_t size = sizes[i], next = 0;
+
+		for (uint32_t b = 0; b < 2 * size; ++b) burst_expected[b] = (uint8_t)b * 7;
+		spiLogReset();
+		dmaReset();
+		ILI9341_Burst_Stream(rampFill, &next, 2 * size);
+		while (dma.pending && dma.started <= size + 1) dmaComplete();
+
+		bool matches = spi_log.length == 2 * size && memcmp(spi_log.data, burst_expected, 2 * size) == 0;
+		bool clean = !dma.overlapped && !dma.rewritten && !spi_log.stray && !spi_log.overflow;
+		printf("%7u %7s %9u %9s %10u %9s %8s %8s\n", size, "ramp", spi_log.length, "-",
+				dma.started, matches ? "yes" : "no", "-", clean ? "ok" : "BAD");
+		if (!matches || !clean || ILI9341_Burst_Busy() || spiSelected()) ok = false;
+	}
+	printf("old: no marks a run the blocking version sent wrong, it repeats a half\n"
+			"filled buffer for odd runs under %u pixels\n", BURST_MAX_SIZE / 2);
+	return ok;
+}
+
+/* Which screen each state shows, as state_machine.c's state table has it */
+static const ScreenId state_screen[BOX_STATE_COUNT] = {
+	[UNLOCKED_EMPTY_ASLEEP] = SCREEN_ASLEEP,
+	[UNLOCKED_ASLEEP_TO_AWAKE] = SCREEN_POWERING_ON,
+	[UNLOCKED_EMPTY_AWAKE] = SCREEN_EMPTY_AWAKE,
+	[UNLOCKED_FULL_AWAKE_FUNC_A] = SCREEN_FULL_AWAKE_A,
+	[UNLOCKED_FULL_AWAKE_FUNC_B] = SCREEN_FULL_AWAKE_B,
+	[UNLOCKED_FULL_ASLEEP] = SCREEN_ASLEEP,
+	[UNLOCKED_TO_LOCKED_AWAKE] = SCREEN_LOCKING,
+	[LOCKED_FULL_AWAKE] = SCREEN_LOCKED_AWAKE,
+	[LOCKED_FULL_ASLEEP] = SCREEN_ASLEEP,
+	[LOCKED_MONITOR_AWAKE] = SCREEN_MONITOR_AWAKE,
+	[LOCKED_MONITOR_ASLEEP] = SCREEN_ASLEEP,
+	[LOCKED_FULL_NOTIFICATION_FUNC_A] = SCREEN_NOTIFICATION_A,
+	[LOCKED_FULL_NOTIFICATION_FUNC_B] = SCREEN_NOTIFICATION_B,
+	[EMERGENCY_OPEN] = SCREEN_EMERGENCY_OPEN,
+};
+
+typedef struct {
+	const char *text;
+	const uint8_t *font;
+	uint16_t x, y;
+	uint16_t colour;
+} TextDraw;
+
+static uint16_t text_old[PANEL_H][PANEL_W];
+
+// paint the screen BACKG as OP_FILL does, then draw the strings and count only their traffic
+static SpiCount textRender(const TextDraw *draws, unsigned n, bool old) {
+	if (old) {
+		Old_Fill_Screen(BACKG);
+	} else {
+		ILI9341_Fill_Screen(BACKG);
+	}
+	panelFill(BACKG);
+	spiCountReset();
+	for (unsigned i = 0; i < n; ++i) {
+		const TextDraw *d = &draws[i];
+		if (old) {
+			Old_Draw_Text(d->text, d->font, d->x, d->y, d->colour, BACKG);
+		} else {
+			ILI9341_Draw_Text(d->text, d->font, d->x, d->y, d->colour, BACKG);
+		}
+	}
+	return spi_count;
+}
+
+// render with both paths, print a row and return the number of pixels that differ
+static unsigned textCompare(const char *name, const TextDraw *draws, unsigned n, SpiCount *old_total, SpiCount *new_total) {
+	SpiCount old = textRender(draws, n, true);
+	memcpy(text_old, panel.gram, sizeof(text_old));
+	SpiCount new = textRender(draws, n, false);
+	unsigned differ = 0;
+
+	for (int y = 0; y < PANEL_H; ++y) {
+		for (int x = 0; x < PANEL_W; ++x) differ += panel.gram[y][x] != text_old[y][x];
+	}
+	old_total->transactions += old.transactions;
+	old_total->bytes += old.bytes;
+	old_total->cs_frames += old.cs_frames;
+	new_total->transactions += new.transactions;
+	new_total->bytes += new.bytes;
+	new_total->cs_frames += new.cs_frames;
+	printf("%-36s %5u %8u %8u %8u %8u %8u %8u %6u\n", name, n, old.transactions, old.bytes, old.cs_frames,
+			new.transactions, new.bytes, new.cs_frames, differ);
+	return differ;
+}
+
+static bool checkText(void) {
+	static char printable[2][64];
+	static const uint8_t *const fonts[] = { FONT1, FONT2, FONT3, FONT4 };
+	SpiCount old_total = { 0 }, new_total = { 0 };
+	unsigned differ = 0;
+
+	dma.immediate = true;
+	printf("%-36s %5s %8s %8s %8s %8s %8s %8s %6s\n", "", "", "old", "", "", "new", "", "", "");
+	printf("%-36s %5s %8s %8s %8s %8s %8s %8s %6s\n", "state", "texts", "xfers", "bytes", "cs",
+			"xfers", "bytes", "cs", "differ");
+	for (int st = 0; st < BOX_STATE_COUNT; ++st) {
+		TextDraw draws[8];
+		unsigned n = 0;
+
+		// placed the way Screen_Op_Draw places them
+		for (const Screen_Op *op = screens[state_screen[st]]; op->op != SCREEN_OP_END; ++op) {
+			if (op->op != SCREEN_OP_TEXT && op->op != SCREEN_OP_TIME) continue;
+			TextDraw *d = &draws[n++];
+			d->text = (op->op == SCREEN_OP_TIME) ? get_time() : op->text;
+			d->font = op->font;
+			d->x = (op->x == SCREEN_CENTRE) ? (320 - get_text_width(d->text, op->font))/2 : op->x;
+			d->y = (op->y == SCREEN_CENTRE) ? (240 - get_text_height(op->font))/2 : op->y;
+			d->colour = op->colour;
+		}
+		differ += textCompare(stateToStr(st), draws, n, &old_total, &new_total);
+	}
+	printf("%-36s %5s %8u %8u %8u %8u %8u %8u\n", "all states", "", old_total.transactions, old_total.bytes,
+			old_total.cs_frames, new_total.transactions, new_total.bytes, new_total.cs_frames);
+
+	// every printable character in each font, and strings cut off by the right and bottom edges
+	for (int c = 0x20; c < 0x7F; ++c) {
+		int half = c >= 0x50;
+		printable[half][c - (half ? 0x50 : 0x20)] = c;
+	}
+	SpiCount extra_old = { 0 }, extra_new = { 0 };
+	for (size_t f = 0; f < sizeof(fonts) / sizeof(fonts[0]); ++f) {
+		char name[40];
+		for (int half = 0; half < 2; ++half) {
+			TextDraw d = { printable[half], fonts[f], 0, 100, WHITE };
+			snprintf(name, sizeof(name), "FONT%zu %s", f + 1, half ? "'P' to '~'" : "' ' to 'O'");
+			differ += textCompare(name, &d, 1, &extra_old, &extra_new);
+		}
+	}
+	// the old code cut the last cell to an odd pixel count at most x, and sent it
+	// shifted by a byte as the burst check shows, 251 leaves it an even one
+	TextDraw right = { "Cut off by the right edge", FONT4, 251, 100, GREEN };
+	TextDraw bottom = { "Cut off by the bottom edge", FONT4, 10, 230, RED };
+	differ += textCompare("right edge", &right, 1, &extra_old, &extra_new);
+	differ += textCompare("bottom edge", &bottom, 1, &extra_old, &extra_new);
+	dma.immediate = false;
+
+	if (differ) printf("%u pixels differ from the old renderer\n", differ);
+	return differ == 0;
+}
+
+/* ILI9341_Draw_RingSector_v2 as it was before the span rasterizer: an
+   atan2f per pixel of the bounding square, each pixel drawn on its own */
+static void Old_Draw_RingSector_v2(uint16_t X, uint16_t Y, uint16_t inner_radius, uint16_t outer_radius, float start_angle_deg, float end_angle_deg, uint16_t color)
+{
+    if (start_angle_deg < 0.0f) start_angle_deg = 0.0f;
+    if (end_angle_deg > 360.0f) end_angle_deg = 360.0f;
+    if (start_angle_deg > end_angle_deg) return; // invalid range
+
+    float start_rad = start_angle_deg * (M_PI / 180.0f);
+    float end_rad = end_angle_deg * (M_PI / 180.0f);
+
+    for (int y = -outer_radius; y <= outer_radius; y++) {
+        for (int x = -outer_radius; x <= outer_radius; x++) {
+            int dist_sq = x * x + y * y;
+            if (dist_sq >= inner_radius * inner_radius && dist_sq <= outer_radius * outer_radius) {
+                float theta = atan2f((float)-y, (float)x);  // screen y grows downward
+                if (theta < 0) theta += 2.0f * M_PI;
+
+                if (theta >= start_rad && theta <= end_rad) {
+                    ILI9341_Draw_Pixel(X + x, Y + y, color);
+                }
+            }
+        }
+    }
+}
+
+static double screenNow(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint16_t arc_old[FB_PIXELS];
+
+static void arcClear(void) {
+	memset(framebuffer, 0, sizeof(framebuffer));
+	fb_dirty_count = 0;
+}
+
+typedef struct {
+	const char *name;
+	uint16_t x, y, inner, outer;
+} ArcShape;
+
+typedef struct {
+	unsigned old_px, new_px;
+	unsigned differ;     // pixels set by one version only
+	unsigned expected;   // of those, the ones the edge rules below account for
+} ArcDiff;
+
+/* Draw one arc both ways. The new rasterizer treats both edges as closed
+   and draws nothing for an empty sweep, so three kinds of pixel are
+   expected to differ: the 0 degree ray of a 0 to 0 arc, which the old
+   code drew, the same ray at the 360 end of an arc starting past 0, which
+   it left out, and the centre of a disc, which it only drew from 0 */
+static ArcDiff arcCompare(const ArcShape *a, float start, float end) {
+	ArcDiff d = { 0 };
+
+	arcClear();
+	Old_Draw_RingSector_v2(a->x, a->y, a->inner, a->outer, start, end, RED);
+	memcpy(arc_old, framebuffer, sizeof(arc_old));
+	arcClear();
+	ILI9341_Draw_RingSector_v2(a->x, a->y, a->inner, a->outer, start, end, RED);
+
+	for (int i = 0; i < FB_PIXELS; ++i) {
+		int x = i % LCD_WIDTH - a->x, y = i / LCD_WIDTH - a->y;
+
+		d.old_px += arc_old[i] != 0;
+		d.new_px += framebuffer[i] != 0;
+		if (framebuffer[i] == arc_old[i]) continue;
+		++d.differ;
+		if ((y == 0 && x > 0 && (end == 0.0f || end >= 360.0f)) || (x == 0 && y == 0)) ++d.expected;
+	}
+	return d;
+}
+
+// median host ns of one draw, old or new, over a sweep of end angles
+static double arcTime(const ArcShape *a, bool old) {
+	double ns[5];
+
+	for (int r = 0; r < 5; ++r) {
+		double start = screenNow();
+		for (int e = 0; e <= 360; e += 5) {
+			fb_dirty_count = 0;
+			if (old) {
+				Old_Draw_RingSector_v2(a->x, a->y, a->inner, a->outer, 0.0f, e, RED);
+			} else {
+				ILI9341_Draw_RingSector_v2(a->x, a->y, a->inner, a->outer, 0.0f, e, RED);
+			}
+		}
+		ns[r] = (screenNow() - start) / (360 / 5 + 1);
+	}
+	for (int i = 0; i < 5; ++i) {
+		for (int j = i + 1; j < 5; ++j) {
+			if (ns[j] < ns[i]) {
+				double t = ns[i];
+				ns[i] = ns[j];
+				ns[j] = t;
+			}
+		}
+	}
+	return ns[2];
+}
+
+static void arcAdd(ArcDiff *sum, const ArcDiff *d) {
+	sum->differ += d->differ;
+	sum->expected += d->expected;
+}
+
+static bool checkArc(void) {
+	static const ArcShape shapes[] = {
+		{ "countdown ring", RING_X, RING_Y, RING_RAD - RING_WIDTH, RING_RAD },
+		{ "lock shackle", 40, 40, 8, 10 },
+		{ "wide band", 160, 120, 40, 100 },
+		{ "disc", 160, 120, 0, 60 },
+	};
+	unsigned unexpected = 0;
+
+	ILI9341_Framebuffer_Enable(true);
+	printf("%-16s %6s %7s %7s %7s %9s\n", "", "end", "old px", "new px", "differ", "unexpected");
+	for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+		const ArcShape *a = &shapes[s];
+		ArcDiff whole = { 0 }, part = { 0 }, starts = { 0 };
+		char name[32];
+
+		snprintf(name, sizeof(name), "%s %u-%u", a->name, a->inner, a->outer);
+		// 0 to every whole degree, a row every 30
+		for (int end = 0; end <= 360; ++end) {
+			ArcDiff d = arcCompare(a, 0.0f, end);
+			if (end % 30 == 0 || d.differ != d.expected) {
+				printf("%-16s %6d %7u %7u %7u %9u\n", end ? "" : name, end, d.old_px, d.new_px,
+						d.differ, d.differ - d.expected);
+			}
+			arcAdd(&whole, &d);
+		}
+		// 0 to the fractional angles the countdown produces
+		for (int step = 1; step <= 720; ++step) {
+			ArcDiff d = arcCompare(a, 0.0f, step * 0.4987f);
+			arcAdd(&part, &d);
+		}
+		// other start angles, up to the 360 end the seam rule covers
+		for (int start = 5; start < 360; start += 10) {
+			for (int sweep = 10; start + sweep <= 360; sweep += 45) {
+				ArcDiff d = arcCompare(a, start, start + sweep);
+				arcAdd(&starts, &d);
+			}
+			ArcDiff d = arcCompare(a, start, 360.0f);
+			arcAdd(&starts, &d);
+		}
+
+		double old_ns = arcTime(a, true), new_ns = arcTime(a, false);
+		printf("%-16s %6s %7s %7s %7u %9u  whole degrees\n", "", "", "", "", whole.differ, whole.differ - whole.expected);
+		printf("%-16s %6s %7s %7s %7u %9u  0.4987 degree steps\n", "", "", "", "", part.differ, part.differ - part.expected);
+		printf("%-16s %6s %7s %7s %7u %9u  start 5 to 355\n", "", "", "", "", starts.differ, starts.differ - starts.expected);
+		printf("%-16s host ns per draw: old %.0f, new %.0f, %.1fx\n\n", "", old_ns, new_ns, old_ns / new_ns);
+		unexpected += whole.differ - whole.expected + part.differ - part.expected + starts.differ - starts.expected;
+	}
+	// switching off flushes the framebuffer, complete its bursts so the next check starts idle
+	dma.immediate = true;
+	ILI9341_Framebuffer_Enable(false);
+	dma.immediate = false;
+	if (unexpected) printf("%u pixels differ from the old arc away from its edge rules\n", unexpected);
+	return unexpected == 0;
+}
+
+/* A test image for the packer, raw RGB565 pixels */
+typedef struct {
+	const char *name;
+	uint16_t width, height;
+	uint16_t *pixels;
+} PackedCase;
+
+/* An image packed by rgb565_pack.py, read back from the header it wrote */
+typedef struct {
+	uint16_t width, height;
+	uint8_t *data;
+	uint32_t size;
+} PackedHeader;
+
+static uint32_t packed_rng = 1;
+
+static uint32_t packedRandom(void) {
+	packed_rng ^= packed_rng << 13;
+	packed_rng ^= packed_rng >> 17;
+	packed_rng ^= packed_rng << 5;
+	return packed_rng;
+}
+
+static uint16_t *packedAlloc(const PackedCase *c) {
+	return malloc((size_t)c->width * c->height * sizeof(uint16_t));
+}
+
+// snow_tiger.h as the packer's example packs it
+static void packedTiger(PackedCase *c) {
+	c->pixels = packedAlloc(c);
+	for (int i = 0; i < c->width * c->height; ++i) c->pixels[i] = snow_tiger[2 * i] << 8 | snow_tiger[2 * i + 1];
+}
+
+// two flat halves, the first in the decoder's starting colour: nothing but RUN ops
+static void packedAllRun(PackedCase *c) {
+	int n = c->width * c->height;
+
+	c->pixels = packedAlloc(c);
+	for (int i = 0; i < n; ++i) c->pixels[i] = (i < n / 2) ? 0x0000 : 0xFFFF;
+}
+
+/* Every pixel flips the top bit of all three channels, which no DIFF or
+   LUMA reaches, and every pair steps a Gray code through the low bits, so
+   no colour repeats and the index never hits: nothing but LITERAL groups.
+   The code starts at 1, colour 0 is already the starting pixel and in the
+   index, and the image stops before it runs out of 12 bits */
+static void packedAllLiteral(PackedCase *c) {
+	c->pixels = packedAlloc(c);
+	for (int i = 0; i < c->width * c->height; ++i) {
+		unsigned step = (i >> 1) + 1, gray = step ^ (step >> 1);
+		uint16_t base = PACKED_RGB(gray & 0x0F, (gray >> 4) & 0x0F, (gray >> 8) & 0x0F);
+		c->pixels[i] = base ^ ((i & 1) ? 0 : PACKED_RGB(0x10, 0x20, 0x10));
+	}
+}
+
+/* Random picks from 128 colours, two per index slot, so about half the
+   lookups find the slot taken by the other colour of the pair */
+static void packedIndexThrash(PackedCase *c) {
+	uint16_t palette[128];
+	int found[64] = { 0 }, filled = 0;
+
+	// a full-period LCG over 16 bits never repeats a colour
+	for (uint32_t px = 0x1234; filled < 128; px = (px * 40503u + 1) & 0xFFFF) {
+		int h = PACKED_HASH(px);
+		if (found[h] < 2) {
+			palette[2 * h + found[h]++] = px;
+			++filled;
+		}
+	}
+	c->pixels = packedAlloc(c);
+	for (int i = 0; i < c->width * c->height; ++i) c->pixels[i] = palette[packedRandom() % 128];
+}
+
+// channel ramps that wrap every few dozen pixels: DIFF on even rows, LUMA on odd ones
+static void packedWrap(PackedCase *c) {
+	c->pixels = packedAlloc(c);
+	for (int y = 0; y < c->height; ++y) {
+		for (int x = 0; x < c->width; ++x) {
+			int k = y * c->width + x;
+			c->pixels[k] = (y & 1) ? PACKED_RGB(x * 3, 63 - x * 9, x * 3 + 11) : PACKED_RGB(x, -2 * x, -x);
+		}
+	}
+}
+
+static bool packedRun(const char *dir, const PackedCase *c, PackedHeader *out) {
+	char bin[256], header[256], command[1024];
+	FILE *f;
+
+	snprintf(bin, sizeof(bin), "%s/%s.bin", dir, c->name);
+	snprintf(header, sizeof(header), "%s/%s.h", dir, c->name);
+	if (!(f = fopen(bin, "wb"))) return false;
+	for (int i = 0; i < c->width * c->height; ++i) {
+		fputc(c->pixels[i] >> 8, f);
+		fputc(c->pixels[i] & 0xFF, f);
+	}
+	fclose(f);
+
+	snprintf(command, sizeof(command), "python3 %s %s --width %u --name %s -o %s > /dev/null",
+			PACKER, bin, c->width, c->name, header);
+	bool ok = system(command) == 0;
+	remove(bin);
+	if (!ok || !(f = fopen(header, "r"))) return false;
+
+	// the byte array between the braces after <name>_data[, then the descriptor's width and height
+	static char text[4 << 20];
+	size_t length = fread(text, 1, sizeof(text) - 1, f);
+	fclose(f);
+	remove(header);
+	text[length] = 0;
+
+	char *p = strstr(text, "_data[");
+	char *desc = strstr(text, "ILI9341_Packed_Image");
+	unsigned width, height;
+	if (!p || !desc || !(p = strchr(p, '{')) || sscanf(strchr(desc, '{'), "{ %u, %u,", &width, &height) != 2) return false;
+
+	out->width = width;
+	out->height = height;
+	out->data = malloc(length / 4 + 1);
+	out->size = 0;
+	for (char *end = strchr(p, '}'); (p = strstr(p, "0x")) && p < end; p += 2) {
+		out->data[out->size++] = (uint8_t)strtoul(p, NULL, 16);
+	}
+	return true;
+}
+
+static void packedStart(const PackedHeader *h) {
+	packed.src = h->data;
+	packed.end = h->data + h->size;
+	packed.prev = 0;
+	packed.run = 0;
+	packed.literals = 0;
+	memset(packed.index, 0, sizeof(packed.index));
+}
+
+typedef struct {
+	unsigned run, index, diff, luma, literal;
+} PackedOps;
+
+// what the stream is made of, literal counts groups
+static PackedOps packedOps(const PackedHeader *h) {
+	PackedOps ops = { 0 };
+
+	for (uint32_t i = 0; i < h->size;) {
+		uint8_t op = h->data[i++];
+		switch (op >> 6) {
+		case 0: ++ops.run; break;
+		case 1: ++ops.index; break;
+		case 2: ++ops.diff; break;
+		default:
+			if ((op & 0xE0) == 0xE0) {
+				++ops.literal;
+				i += 2 * ((op & 0x1F) + 1);
+			} else {
+				++ops.luma;
+				++i;
+			}
+			break;
+		}
+	}
+	return ops;
+}
+
+static bool checkPacked(void) {
+	PackedCase cases[] = {
+		{ "snow_tiger", 320, 240 },
+		{ "all_run", 320, 240 },
+		{ "all_literal", 128, 62 },
+		{ "index_thrash", 320, 240 },
+		{ "wrap", 320, 240 },
+	};
+	void (*make[])(PackedCase *) = { packedTiger, packedAllRun, packedAllLiteral, packedIndexThrash, packedWrap };
+	char dir[] = "/tmp/screen-packed-XXXXXX";
+	bool ok = true;
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return false;
+	}
+	printf("%-13s %7s %7s %6s %6s %6s %6s %6s %7s %7s %9s %8s\n", "image", "raw", "packed", "run", "index",
+			"diff", "luma", "lit", "differ", "panel", "MB/s out", "MB/s in");
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		PackedCase *c = &cases[i];
+		PackedHeader h;
+		uint32_t n = (uint32_t)c->width * c->height;
+
+		make[i](c);
+		if (!packedRun(dir, c, &h) || h.width != c->width || h.height != c->height) {
+			printf("%-13s rgb565_pack.py failed or wrote a header this check can't read\n", c->name);
+			free(c->pixels);
+			ok = false;
+			continue;
+		}
+
+		// ILI9341_Packed_Next one pixel at a time against the source
+		unsigned differ = 0;
+		packedStart(&h);
+		for (uint32_t k = 0; k < n; ++k) differ += ILI9341_Packed_Next() != c->pixels[k];
+		bool consumed = packed.src == packed.end && !packed.run && !packed.literals;
+
+		// the whole path, line buffers and all, through the panel model
+		unsigned panel_differ = 0;
+		dma.immediate = true;
+		ILI9341_Draw_Packed_Image(&(ILI9341_Packed_Image){ h.width, h.height, h.size, h.data }, 0, 0);
+		dma.immediate = false;
+		for (uint32_t k = 0; k < n; ++k) panel_differ += panel.gram[k / c->width][k % c->width] != c->pixels[k];
+
+		// decode rate through the fill callback, a line buffer at a time
+		static uint8_t line[ILI9341_LINE_BUFFER_SIZE];
+		unsigned reps = 0;
+		double start = screenNow(), elapsed;
+		do {
+			packedStart(&h);
+			for (uint32_t left = 2 * n; left;) {
+				uint32_t len = left < sizeof(line) ? left : sizeof(line);
+				ILI9341_Packed_Fill(line, len, NULL);
+				left -= len;
+			}
+			++reps;
+		} while ((elapsed = screenNow() - start) < 2e8);
+
+		PackedOps ops = packedOps(&h);
+		printf("%-13s %7u %7u %6u %6u %6u %6u %6u %7u %7u %9.1f %8.1f\n", c->name, 2 * n, h.size, ops.run,
+				ops.index, ops.diff, ops.luma, ops.literal, differ, panel_differ,
+				2e3 * n * reps / elapsed, 1e3 * h.size * reps / elapsed);
+
+		if (differ || panel_differ || !consumed) ok = false;
+		if (!consumed) printf("%-13s the decoder stopped short of the end of the stream\n", "");
+		// the construction has to produce the ops it claims to
+		if (i == 1 && (ops.index || ops.luma || ops.literal || ops.diff > 1)) ok = false;
+		if (i == 2 && (ops.run || ops.index || ops.diff || ops.luma || h.size != 2 * n + (n + 31) / 32)) ok = false;
+		free(h.data);
+		free(c->pixels);
+	}
+	rmdir(dir);
+	printf("differ counts pixels ILI9341_Packed_Next got wrong, panel the ones\n"
+			"ILI9341_Draw_Packed_Image left wrong in GRAM\n");
+	return ok;
+}
+
+static const struct {
+	const char *name;
+	bool (*run)(void);
+} checks[] = {
+	{ "burst", checkBurst },
+	{ "text", checkText },
+	{ "arc", checkArc },
+	{ "packed", checkPacked },
+};
+
+int main(int argc, char **argv) {
+	size_t count = sizeof(checks) / sizeof(checks[0]);
+	bool ok = true;
+	int ran = 0;
+
+	HAL_GPIO_WritePin(LCD_CS_PORT, LCD_CS_PIN, GPIO_PIN_SET);
+	ILI9341_Set_Rotation(SCREEN_HORIZONTAL_2);
+	for (size_t i = 0; i < count; ++i) {
+		bool wanted = argc < 2;
+		for (int a = 1; a < argc; ++a) {
+			if (strcmp(argv[a], checks[i].name) == 0) wanted = true;
+		}
+		if (!wanted) continue;
+		printf("%s%s:\n", ran ? "\n" : "", checks[i].name);
+		ok &= checks[i].run();
+		++ran;
+	}
+	if (ran == 0) {
+		fprintf(stderr, "usage: screen [");
+		for (size_t i = 0; i < count; ++i) fprintf(stderr, "%s%s", i ? "|" : "", checks[i].name);
+		fprintf(stderr, "]...\n");
+		return 2;
+	}
+	return ok ? 0 : 1;
+}
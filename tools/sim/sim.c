@@ -0,0 +1,1413 @@
+/*
+ * sim.c - discrete-event simulator for the event controller and state machine
+ *
+ * Builds event_controller.c, state_machine.c, audio.c, rotary_encoder.c,
+ * lock_timer.c, accelerometer.c, trace.c and input_log.c unchanged for
+ * the host, against the HAL stand-in in stub/, and runs them under a
+ * copy of the main loop from main.c on a virtual clock, so scheduler changes can be measured without flashing
+ * a box. Most states poll the dial every millisecond, so a simulated
+ * millisecond is at least one main loop pass; one core manages a few
+ * thousand times real time, and --jobs spreads generated sessions over
+ * as many boxes as there are cores.
+ *
+ *     make -C tools/sim
+ *     tools/sim/sim tools/sim/lock_session.txt
+ *     tools/sim/sim --sessions 2000 --seed 7 --jobs 8
+ *     tools/sim/sim -v --sessions 3
+ *     tools/sim/sim -v --replay field.bin
+ *
+ * The run ends with a report: main loop passes and time spent awake,
+ * signals posted and dropped, how long each BoxState was held, and per
+ * event label the dispatch count, start lateness and modeled cost from
+ * the PROFILE_EVENTS profiler. -v also prints every state transition.
+ * --trace writes the transition trace the box would send for
+ * TRACE_DUMP_CMD at the end of the run, for tools/trace/trace_decode.py.
+ *
+ * Clock. Virtual time is kept in us. TIM3 (10 us a count, 101 a tick),
+ * TIM2 (the lock timer, counting down every 100 us) and TIM1 (the
+ * encoder) are plain register structs moved along with it, and their
+ * update interrupts run as soon as they fall due unless PRIMASK is set,
+ * so eventIdle sees the same register states it does on the board.
+ * __WFI fast forwards to the next pending interrupt. A main loop pass
+ * that doesn't sleep waits for the next interrupt the same way, unless
+ * an event is already due or a redraw is left, since nothing else it
+ * reads can change in between. DWT->CYCCNT reads virtual time at the
+ * 90 MHz core clock.
+ *
+ * Sensors. accelerometer.c runs as is over a model of the I2C1 bus
+ * whose reads return raw samples made up from the simulated world: a
+ * still box, shaken past ACCELERATION_WAKE_DELTA while moved, and the
+ * lid magnet either side of MAGNOMETER_THRESHOLD. The NFC callback is
+ * replaced by a coroutine below that follows the real one's bus waits
+ * and poll periods against a model of the PN532. Only the bus, this
+ * stand-in and the screen cost time (the SIM_*_US costs), the real
+ * modules are taken to run in no time.
+ *
+ * Script. One stimulus per line, '#' starts a comment:
+ *
+ *     <time> <command> [args]
+ *
+ * time is in ms, or with an s, m, h or d suffix; a leading + makes it
+ * relative to the line before. Commands:
+ *
+ *     move              the box is picked up (accelerometer wake)
+ *     turn <n>          the dial turns n encoder counts, negative turns back
+ *     press             the dial is pressed (EXTI15_10)
+ *     phone in|out      a phone enters or leaves the NFC field
+ *     lid open|closed   the magnetometer sees the lid open or closed
+ *     clap <n> [ms]     n KY-037 edges on EXTI0, ms apart (30 by default)
+ *     load <ms> <us>    from here on a low priority event holds the loop
+ *                       for us every ms, standing in for a blocking driver
+ *     end               stop here, otherwise the run ends 5 minutes after
+ *                       the last stimulus
+ *
+ * --sessions generates the script instead: N lock sessions with random
+ * idle gaps, lock lengths, noise while locked and the occasional lid
+ * forced open, from a seeded PRNG so a run repeats exactly for the same
+ * seed and --jobs.
+ *
+ * Replay. --replay runs an input log dumped by a box built with
+ * RECORD_INPUTS (INPUT_LOG_DUMP_CMD on LPUART) instead of a script:
+ * accelerometer.c gets the recorded samples, the newest one at or
+ * before each read, and the edges, dial counts and NFC results come
+ * back at the times they were logged. A phone found or lost is put in
+ * or taken out in time for the NFC poll that logged it to see it. A
+ * log that wrapped starts in the state its oldest block was written in,
+ * with the lock timer armed if it was, and every replay stops at the
+ * time of the dump. Log times are the box's time_ms, which falls a
+ * little behind across tickless sleeps, so transitions come back in
+ * the same order a fraction of a second early. Replaying the same log
+ * on two builds and diffing the -v output shows what a change does to
+ * the transitions.
+ * --record writes the log this run would dump, so replay can be checked
+ * against the run that made it.
+ *
+ * Lateness. make -C tools/sim lateness runs encoder_load.txt on this
+ * build and on one with EVENT_SINGLE_PASS, where eventRunner never
+ * starts a pass over, and prints the worst encoder lateness and the
+ * longest eventRunner call of each.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stm32l4xx_hal.h"
+#include "Screen_Driver.h"
+#include "accelerometer.h"
+#include "audio.h"
+#include "event_controller.h"
+#include "input_log.h"
+#include "lock_timer.h"
+#include "nfc.h"
+#include "rotary_encoder.h"
+#include "shared.h"
+#include "state_machine.h"
+#include "trace.h"
+
+#define SIM_CORE_HZ 90000000u  /* SystemClock_Config: MSI 4 MHz x 45 / 2 */
+#define SIM_TIM3_COUNT_US 10   /* prescaler 899 */
+#define SIM_TIM2_COUNT_US 100  /* prescaler 8999 */
+
+/* Modeled costs and device timing, us */
+#define SIM_LOOP_US 4               /* a main loop pass that runs nothing */
+#define SIM_I2C_BYTE_US 90          /* I2C1 at about 100 kHz */
+#define SIM_I2C_START_US 15         /* setting up an interrupt driven transfer */
+#define SIM_PN532_ACK_US 2000       /* InListPassiveTarget to ACK */
+#define SIM_PN532_TARGET_US 30000   /* ACK to target list with a phone in the field */
+#define SIM_SCREEN_US 30000         /* screenResolve redraw */
+#define SIM_RING_US 4000            /* Ring_Update */
+#define SIM_TIMER_TEXT_US 1500      /* UEA_Timer_Update */
+#define SIM_MOVE_US 200000          /* how long a move shows on the accelerometer */
+
+/* Raw samples the world model hands accelerometer.c */
+#define SIM_ACC_REST_Z 16000        /* 1 g at rest */
+#define SIM_ACC_SHAKE_X 25000       /* alternated while moved, past ACCELERATION_WAKE_DELTA */
+#define SIM_MAG_CLOSED 1000         /* under MAGNOMETER_THRESHOLD */
+#define SIM_MAG_OPEN 6000           /* over it */
+#define SIM_SETTLE_US (5 * 60 * 1000000ull)
+
+#define SIM_US_PER_MS 1000ull
+#define SIM_NEVER UINT64_MAX
+
+/* Firmware globals normally defined by main.c and the HAL */
+TIM_TypeDef sim_tim1, sim_tim2, sim_tim3;
+GPIO_TypeDef sim_gpiob, sim_gpiod, sim_gpioe;
+CoreDebug_Type sim_core_debug;
+I2C_HandleTypeDef hi2c1;
+uint32_t SystemCoreClock = SIM_CORE_HZ;
+
+TIM_HandleTypeDef htim1 = { TIM1, { 0, 60000 } };
+TIM_HandleTypeDef htim2 = { TIM2, { 8999, 30000 } };
+TIM_HandleTypeDef htim3 = { TIM3, { 899, 100 } };
+
+static USART_TypeDef sim_lpuart;
+UART_HandleTypeDef hlpuart1 = { &sim_lpuart };
+
+extern bool master_timer_done;
+extern BoxState state;
+extern int32_t prev_cnt;
+
+/* Simulated world */
+typedef enum {
+	STIM_MOVE,
+	STIM_TURN,
+	STIM_DIAL,
+	STIM_PRESS,
+	STIM_PHONE,
+	STIM_LID,
+	STIM_EDGE,
+	STIM_LOAD,
+	STIM_END
+} StimulusKind;
+
+typedef struct {
+	uint64_t time_us;
+	uint32_t order;  // keeps lines with the same time in script order
+	uint8_t kind;
+	int32_t arg;
+} Stimulus;
+
+static Stimulus *stimuli;
+static size_t stimulus_count, stimulus_cap, stimulus_next;
+
+static struct {
+	bool phone;
+	bool lid_open;
+	uint64_t moved_until_us;
+} world;
+
+/* Load events from the script, registered by the main loop once started */
+#define SIM_LOADS_MAX 8
+#define SIM_LOAD_LABEL ((EventLabel)EVENT_LABEL_COUNT)  /* past the labels, so the profiler leaves it out */
+
+static struct {
+	uint32_t period_ms;
+	uint32_t cost_us;
+	bool started;
+	EventHandle handle;
+} loads[SIM_LOADS_MAX];
+static unsigned load_count;
+
+/* Virtual clock and interrupt state */
+static uint64_t now_us;
+static uint64_t end_us = SIM_NEVER;
+static uint32_t tim3_sub_us, tim2_sub_us;  // time into the current count
+static bool primask;
+static bool nvic_enabled[64];
+static bool exti_pending[16];
+static uint32_t isr_runs;
+
+/* Bookkeeping for the report */
+static bool verbose;
+static FILE *uart_out;  // --trace and --record, takes what the firmware sends on LPUART
+static uint64_t awake_us, wakeups, loop_passes;
+static uint64_t runner_max_us;  // longest eventRunner call
+static uint64_t signals_posted, exti_lost;
+static uint64_t state_us[EMERGENCY_OPEN + 1], state_entries[EMERGENCY_OPEN + 1];
+static uint64_t state_since_us;
+static uint64_t tick_us;  // length of a 1 ms tick, htim3.Init.Period changes under tickless idle
+static uint64_t lock_us, lock_since_us, lock_sessions;
+static bool lock_engaged;
+
+static void simService(void);
+
+/* Timers
+ *	TIM3 counts up and updates when it passes ARR (or wraps at 16 bits if
+ *	ARR was lowered below CNT). TIM2 counts down from CNT and reloads ARR
+ *	on the count after 0. Each runs only while CEN is set.
+ */
+static uint64_t tim3Until(void) {
+	if (!(TIM3->CR1 & TIM_CR1_CEN)) return SIM_NEVER;
+
+	uint32_t counts = TIM3->CNT <= TIM3->ARR ? TIM3->ARR + 1 - TIM3->CNT : 0x10000 - TIM3->CNT;
+	return (uint64_t)counts * SIM_TIM3_COUNT_US - tim3_sub_us;
+}
+
+static void tim3Run(uint64_t us) {
+	if (!(TIM3->CR1 & TIM_CR1_CEN)) return;
+
+	uint64_t counts = (tim3_sub_us + us) / SIM_TIM3_COUNT_US;
+	tim3_sub_us = (tim3_sub_us + us) % SIM_TIM3_COUNT_US;
+
+	while (counts) {
+		if (TIM3->CNT > TIM3->ARR) {
+			uint32_t room = 0x10000 - TIM3->CNT;
+			if (counts < room) { TIM3->CNT += counts; return; }
+			counts -= room;
+			TIM3->CNT = 0;
+			continue;
+		}
+
+		uint32_t room = TIM3->ARR + 1 - TIM3->CNT;
+		if (counts < room) { TIM3->CNT += counts; return; }
+		counts -= room;
+		TIM3->CNT = 0;
+		TIM3->SR |= TIM_SR_UIF;
+	}
+}
+
+static uint64_t tim2Until(void) {
+	if (!(TIM2->CR1 & TIM_CR1_CEN)) return SIM_NEVER;
+
+	return ((uint64_t)TIM2->CNT + 1) * SIM_TIM2_COUNT_US - tim2_sub_us;
+}
+
+static void tim2Run(uint64_t us) {
+	if (!(TIM2->CR1 & TIM_CR1_CEN)) return;
+
+	uint64_t counts = (tim2_sub_us + us) / SIM_TIM2_COUNT_US;
+	tim2_sub_us = (tim2_sub_us + us) % SIM_TIM2_COUNT_US;
+
+	while (counts) {
+		if (counts <= TIM2->CNT) { TIM2->CNT -= counts; return; }
+		counts -= TIM2->CNT + 1;
+		TIM2->CNT = TIM2->ARR;
+		TIM2->SR |= TIM_SR_UIF;
+	}
+}
+
+/* Stimuli */
+static void simApply(const Stimulus *s) {
+	switch (s->kind) {
+	case STIM_MOVE:
+		world.moved_until_us = now_us + SIM_MOVE_US;
+		break;
+	case STIM_TURN:
+		TIM1->CNT = (TIM1->CNT + s->arg) & 0xFFFF;
+		break;
+	case STIM_DIAL:
+		TIM1->CNT = s->arg & 0xFFFF;
+		break;
+	case STIM_PRESS:
+		exti_pending[10] = true;
+		break;
+	case STIM_PHONE:
+		world.phone = s->arg;
+		break;
+	case STIM_LID:
+		world.lid_open = s->arg;
+		break;
+	case STIM_EDGE:
+		// the EXTI line latches one edge, more before it is taken are lost
+		if (exti_pending[0]) ++exti_lost;
+		exti_pending[0] = true;
+		break;
+	case STIM_LOAD:
+		loads[s->arg].started = true;
+		break;
+	case STIM_END:
+		end_us = now_us;
+		break;
+	}
+}
+
+// us until the next timer update or stimulus, at most limit
+static uint64_t simNextChange(uint64_t limit) {
+	uint64_t step = limit - now_us;
+	uint64_t t;
+
+	if ((t = tim3Until()) < step) step = t;
+	if ((t = tim2Until()) < step) step = t;
+	if (stimulus_next < stimulus_count) {
+		t = stimuli[stimulus_next].time_us > now_us ? stimuli[stimulus_next].time_us - now_us : 0;
+		if (t < step) step = t;
+	}
+	return step;
+}
+
+// moves the clock on by step, which must not pass the next change, and takes what falls due
+static void simStep(uint64_t step) {
+	tim3Run(step);
+	tim2Run(step);
+	now_us += step;
+
+	while (stimulus_next < stimulus_count && stimuli[stimulus_next].time_us <= now_us) {
+		simApply(&stimuli[stimulus_next++]);
+	}
+	simService();
+}
+
+// time passing inside the firmware: a callback, a blocking transfer, a redraw
+static void simSpend(uint64_t us) {
+	uint64_t target = now_us + us;
+
+	awake_us += us;
+	while (now_us < target) {
+		simStep(simNextChange(target));
+	}
+}
+
+/* Interrupts */
+static bool simPending(void) {
+	return ((TIM3->SR & TIM_SR_UIF) && (TIM3->DIER & TIM_DIER_UIE) && nvic_enabled[TIM3_IRQn]) ||
+			((TIM2->SR & TIM_SR_UIF) && (TIM2->DIER & TIM_DIER_UIE) && nvic_enabled[TIM2_IRQn]) ||
+			(exti_pending[0] && nvic_enabled[EXTI0_IRQn]) ||
+			(exti_pending[10] && nvic_enabled[EXTI15_10_IRQn]);
+}
+
+// runs the handlers of everything pending, as the it.c handlers and main.c callbacks do
+static void simService(void) {
+	if (primask) return;
+
+	while (simPending()) {
+		++isr_runs;
+		if ((TIM3->SR & TIM_SR_UIF) && (TIM3->DIER & TIM_DIER_UIE) && nvic_enabled[TIM3_IRQn]) {
+			TIM3->SR &= ~TIM_SR_UIF;
+			eventTick();
+		} else if ((TIM2->SR & TIM_SR_UIF) && (TIM2->DIER & TIM_DIER_UIE) && nvic_enabled[TIM2_IRQn]) {
+			TIM2->SR &= ~TIM_SR_UIF;
+			master_timer_done = true;
+		} else if (exti_pending[0] && nvic_enabled[EXTI0_IRQn]) {
+			exti_pending[0] = false;
+			eventSignalPost(EVENT_SIGNAL_AUDIO, state);
+			++signals_posted;
+		} else {
+			exti_pending[10] = false;
+			eventSignalPost(EVENT_SIGNAL_ROTENC_SWITCH, 0);
+			++signals_posted;
+		}
+	}
+}
+
+// sleeps until an interrupt is pending (PRIMASK set) or one has run
+static void simWait(void) {
+	uint32_t runs = isr_runs;
+
+	while (!simPending() && isr_runs == runs && now_us < end_us) {
+		simStep(simNextChange(end_us));
+	}
+}
+
+/* HAL and core stand-ins */
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim) {
+	htim->Instance->CR1 |= TIM_CR1_CEN;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) {
+	htim->Instance->DIER |= TIM_DIER_UIE;
+	htim->Instance->CR1 |= TIM_CR1_CEN;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim) {
+	htim->Instance->DIER &= ~TIM_DIER_UIE;
+	htim->Instance->CR1 &= ~TIM_CR1_CEN;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel) {
+	(void)Channel;
+	htim->Instance->CR1 |= TIM_CR1_CEN;
+	return HAL_OK;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+	if (PinState == GPIO_PIN_SET) {
+		GPIOx->ODR |= GPIO_Pin;
+	} else {
+		GPIOx->ODR &= ~GPIO_Pin;
+	}
+
+	// the lock solenoid
+	if (GPIOx == GPIOE && GPIO_Pin == GPIO_PIN_15 && lock_engaged != (PinState == GPIO_PIN_SET)) {
+		lock_engaged = PinState == GPIO_PIN_SET;
+		if (lock_engaged) {
+			lock_since_us = now_us;
+			++lock_sessions;
+		} else {
+			lock_us += now_us - lock_since_us;
+		}
+	}
+}
+
+// a blocking send at 115200 baud, 10 bits a byte
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+	(void)huart;
+	(void)Timeout;
+	if (uart_out) fwrite(pData, 1, Size, uart_out);
+	simSpend((uint64_t)Size * 10 * 1000000 / 115200);
+	return HAL_OK;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+	nvic_enabled[IRQn] = true;
+	simService();
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn) {
+	nvic_enabled[IRQn] = false;
+}
+
+void HAL_SuspendTick(void) {}
+void HAL_ResumeTick(void) {}
+
+void __disable_irq(void) {
+	primask = true;
+}
+
+void __enable_irq(void) {
+	primask = false;
+	simService();
+}
+
+// sleeping time is left out of awake_us
+void __WFI(void) {
+	simWait();
+	++wakeups;
+}
+
+DWT_Type *sim_dwt(void) {
+	static DWT_Type dwt;
+
+	dwt.CYCCNT = (uint32_t)(now_us * (SIM_CORE_HZ / 1000000));
+	return &dwt;
+}
+
+/* I2C1 and PN532 model
+ *	The bus is busy until i2c_busy_until_us. Interrupt driven transfers
+ *	only cost their setup, blocking ones hold the core for the whole
+ *	transfer. The PN532 is ready a fixed time after the frame it answers.
+ */
+static uint64_t i2c_busy_until_us;
+
+static bool simI2cIdle(void) {
+	return now_us >= i2c_busy_until_us;
+}
+
+static void simI2cStart(uint32_t bytes) {
+	simSpend(SIM_I2C_START_US);
+	i2c_busy_until_us = now_us + bytes * SIM_I2C_BYTE_US;
+}
+
+static void simI2cBlocking(uint32_t bytes) {
+	simSpend(bytes * SIM_I2C_BYTE_US);
+	i2c_busy_until_us = now_us;
+}
+
+/* Raw samples
+ *	What the accelerometer and magnetometer reads return: made up from
+ *	the world model, or under --replay the newest recorded sample at or
+ *	before now, and the keyframe value before the first.
+ */
+typedef struct {
+	uint64_t time_us;
+	Vector3D v;
+} Sample;
+
+typedef struct {
+	Sample *s;
+	size_t count, cap, next;
+	Vector3D held;
+} SampleTrack;
+
+static bool replaying;
+static SampleTrack acc_track, mag_track;
+static Vector3D acc_world = { 0, 0, SIM_ACC_REST_Z };
+
+static Vector3D simTrackSample(SampleTrack *t) {
+	while (t->next < t->count && t->s[t->next].time_us <= now_us) {
+		t->held = t->s[t->next++].v;
+	}
+	return t->held;
+}
+
+static Vector3D simAccSample(void) {
+	if (replaying) return simTrackSample(&acc_track);
+
+	// every read while moved swings far enough to count, a still box reads the same each time
+	if (now_us < world.moved_until_us) {
+		acc_world.x_componenet = acc_world.x_componenet ? 0 : SIM_ACC_SHAKE_X;
+	}
+	return acc_world;
+}
+
+static Vector3D simMagSample(void) {
+	if (replaying) return simTrackSample(&mag_track);
+	return (Vector3D){ world.lid_open ? SIM_MAG_OPEN : SIM_MAG_CLOSED, 0, 0 };
+}
+
+// low byte first, the way accStore and magStore put it back together
+static void simPutSample(uint8_t *raw, Vector3D v) {
+	int16_t c[3] = { v.x_componenet, v.y_componenet, v.z_componenet };
+
+	for (int i = 0; i < 3; ++i) {
+		raw[2 * i] = (uint16_t)c[i] & 0xFF;
+		raw[2 * i + 1] = (uint16_t)c[i] >> 8;
+	}
+}
+
+/* I2C1 as accelerometer.c drives it */
+static struct {
+	uint8_t *data;  // an interrupt driven read still on the bus, NULL if none
+	uint16_t addr;
+} i2c_read;
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c) {
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c) {
+	i2c_read.data = NULL;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+	simI2cBlocking(1 + Size);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+	simI2cBlocking(1 + Size);
+	if (Size >= 6) simPutSample(pData, DevAddress == ACC_READ ? simAccSample() : simMagSample());
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size) {
+	if (!simI2cIdle()) return HAL_BUSY;
+
+	simI2cStart(3 + Size);
+	i2c_read.data = pData;
+	i2c_read.addr = DevAddress;
+	return HAL_OK;
+}
+
+// the sample is taken as the transfer ends, where the receive interrupt would leave it
+HAL_I2C_StateTypeDef HAL_I2C_GetState(const I2C_HandleTypeDef *hi2c) {
+	if (!simI2cIdle()) return HAL_I2C_STATE_BUSY_RX;
+
+	if (i2c_read.data) {
+		simPutSample(i2c_read.data, i2c_read.addr == ACC_WRITE ? simAccSample() : simMagSample());
+		i2c_read.data = NULL;
+	}
+	return HAL_I2C_STATE_READY;
+}
+
+uint32_t HAL_I2C_GetError(const I2C_HandleTypeDef *hi2c) {
+	return HAL_I2C_ERROR_NONE;
+}
+
+/* NFC stand-in, same shape as the nfc.c coroutine */
+static struct {
+	Coroutine co;
+	bool ready;
+	uint64_t sent_us;  // when the frame the PN532 is answering went out
+} nfc_sim;
+
+// reads the PN532 status byte, true once it has answered, after_us past the last frame
+static bool simPn532Ready(uint64_t after_us, bool answers) {
+	if (!simI2cIdle()) return false;
+
+	simI2cBlocking(2);
+	return answers && now_us - nfc_sim.sent_us >= after_us;
+}
+
+static void simNfcPresent(bool present) {
+	inputLogPhone(present);
+	if (present) {
+		stateRemoveFlag(SFLAG_NFC_PHONE_NOT_PRESENT);
+		stateInsertFlag(SFLAG_NFC_PHONE_PRESENT);
+	} else {
+		stateInsertFlag(SFLAG_NFC_PHONE_NOT_PRESENT);
+		stateRemoveFlag(SFLAG_NFC_PHONE_PRESENT);
+	}
+}
+
+void nfcEventCallbackSlow(void) {
+	Coroutine *co = &nfc_sim.co;
+
+	CO_BEGIN(co);
+
+	CO_WAIT_UNTIL(co, simI2cIdle(), 1);
+	simI2cBlocking(12);  // InListPassiveTarget
+	nfc_sim.sent_us = now_us;
+
+	CO_WAIT_UNTIL_TIMEOUT(co, (nfc_sim.ready = simPn532Ready(SIM_PN532_ACK_US, true)), NFC_POLL_MS, NFC_TIMEOUT_MS);
+	if (!nfc_sim.ready) {
+		simNfcPresent(false);
+		CO_EXIT(co);
+	}
+	simI2cBlocking(7);  // ACK
+	nfc_sim.sent_us = now_us;
+
+	CO_WAIT_UNTIL_TIMEOUT(co, (nfc_sim.ready = simPn532Ready(SIM_PN532_TARGET_US, world.phone)), NFC_POLL_MS, NFC_TIMEOUT_MS);
+	if (!nfc_sim.ready) {
+		simNfcPresent(false);
+		CO_EXIT(co);
+	}
+	simI2cBlocking(21);  // target list
+	simNfcPresent(true);
+
+	CO_END(co);
+}
+
+// a blocking driver from the script, the load it stands for is found by handle
+static void simLoadEvent(void) {
+	EventHandle handle = eventCurrent();
+
+	for (unsigned i = 0; i < load_count; ++i) {
+		if (loads[i].handle == handle) simSpend(loads[i].cost_us);
+	}
+}
+
+// registers the loads whose time has come, as a module starting its event would
+static void simStartLoads(void) {
+	for (unsigned i = 0; i < load_count; ++i) {
+		if (loads[i].started && loads[i].handle == EVENT_HANDLE_NONE) {
+			loads[i].handle = eventRegisterPriority(simLoadEvent, SIM_LOAD_LABEL, EVENT_PERIODIC,
+					loads[i].period_ms, 0, EVENT_PRIORITY_LOW);
+		}
+	}
+}
+
+/* Screen stand-ins: each redraw queues work that Render_Task drains a budget at a time */
+static uint64_t render_left_us;
+
+void screenResolve(void) {
+	render_left_us += SIM_SCREEN_US;
+}
+
+void UEA_Timer_Update(void) {
+	render_left_us += SIM_TIMER_TEXT_US;
+}
+
+void Ring_Update(void) {
+	render_left_us += SIM_RING_US;
+}
+
+void Render_Task(uint32_t budget_ms) {
+	uint64_t spend = budget_ms * SIM_US_PER_MS;
+
+	if (spend > render_left_us) spend = render_left_us;
+	render_left_us -= spend;
+	simSpend(spend);
+}
+
+bool Render_Pending(void) {
+	return render_left_us != 0;
+}
+
+/* Main loop */
+static void simFormatTime(char *out, size_t len, uint64_t us) {
+	uint64_t ms = us / 1000;
+	snprintf(out, len, "%3llud %02llu:%02llu:%02llu.%03llu", (unsigned long long)(ms / 86400000),
+			(unsigned long long)(ms / 3600000 % 24), (unsigned long long)(ms / 60000 % 60),
+			(unsigned long long)(ms / 1000 % 60), (unsigned long long)(ms % 1000));
+}
+
+static void simNoteState(BoxState from) {
+	state_us[from] += now_us - state_since_us;
+	state_since_us = now_us;
+	++state_entries[state];
+
+	if (verbose) {
+		char t[32];
+		simFormatTime(t, sizeof(t), now_us);
+		printf("[%s] %s -> %s\n", t, stateToStr(from), stateToStr(state));
+	}
+}
+
+/* Where a replayed log starts. A log that wrapped starts mid session,
+ * so the dial, the state and the lock timer are picked up from its
+ * oldest keyframe; one that didn't starts at boot like any other run.
+ */
+static bool replay_wrapped;
+static struct {
+	BoxState state;
+	uint8_t flags;
+	uint32_t lock_ms;
+	uint16_t dial;
+} replay_start;
+
+static void simReplayStart(void) {
+	TIM1->CNT = replay_start.dial;
+	prev_cnt = replay_start.dial;
+	state = replay_start.state;
+
+	if (replay_start.flags & INPUT_KEY_LOCK_TIMER) {
+		lockTimerSetTime(replay_start.lock_ms);
+		lockTimerStart();
+	}
+	if (state >= LOCKED_FULL_AWAKE && state <= LOCKED_FULL_NOTIFICATION_FUNC_B) {
+		lockEngage();
+	}
+}
+
+// the initialisation in main() that concerns the simulated modules
+static void simInit(void) {
+	TIM2->ARR = htim2.Init.Period;
+	TIM2->CNT = TIM2->ARR;  // the update HAL_TIM_Base_Init generates loads a down counter from ARR
+	TIM3->ARR = htim3.Init.Period;
+	tick_us = (htim3.Init.Period + 1) * SIM_TIM3_COUNT_US;
+	nvic_enabled[TIM2_IRQn] = true;  // HAL_TIM_Base_MspInit
+	nvic_enabled[TIM3_IRQn] = true;
+
+	accInit();
+	audioInit();
+	magInit();
+	rotencInit();
+	lockTimerInit();
+	stateMachineInit();
+	eventControllerInit();
+	if (replay_wrapped) simReplayStart();
+
+	screenResolve();
+	stateScheduleEvents();
+	inturruptControl();
+
+	state_since_us = now_us;
+	++state_entries[state];
+}
+
+// the while (1) of main(), keep in step with it
+static void simRun(void) {
+	while (now_us < end_us) {
+		BoxState before = state;
+
+		++loop_passes;
+		simSpend(SIM_LOOP_US);
+
+		simStartLoads();
+		stateDrainSignals();
+		runStateMachine();
+		if (state != before) simNoteState(before);
+
+		uint64_t runner_from = now_us;
+		eventRunner();
+		if (now_us - runner_from > runner_max_us) runner_max_us = now_us - runner_from;
+
+		if (state == UNLOCKED_EMPTY_AWAKE) {
+			int32_t delta = rotencGetDelta();
+
+			if (delta) {
+				lockTimerSetTime(lockTimerGetTime() + (delta * 30000));
+				UEA_Timer_Update();
+			}
+		}
+
+		if (state == LOCKED_FULL_AWAKE || state == LOCKED_MONITOR_AWAKE) {
+			if (lockTimerGetTime() % 1500 == 0) {
+				Ring_Update();
+			}
+			if (lockTimerGetTime() % 150 == 0) {
+				UEA_Timer_Update();
+			}
+		}
+
+		Render_Task(RENDER_BUDGET_MS);
+		tracePoll();
+
+		if (!Render_Pending()) {
+			if (state == UNLOCKED_EMPTY_AWAKE) {
+				eventIdle(1, stateWorkPending);
+				continue;
+			} else if (state != LOCKED_FULL_AWAKE && state != LOCKED_MONITOR_AWAKE) {
+				eventIdle(EVENT_IDLE_MAX_MS, stateWorkPending);
+				continue;
+			}
+		}
+
+		// a spinning loop only sees something new once an interrupt has run
+		uint32_t next;
+		if (!Render_Pending() && !(eventNextDeadline(&next) && (int32_t)(time_ms - next) >= 0)) {
+			uint64_t from = now_us;
+			simWait();
+			awake_us += now_us - from;
+		}
+	}
+
+	state_us[state] += now_us - state_since_us;
+	if (lock_engaged) lock_us += now_us - lock_since_us;
+}
+
+/* Stimulus list */
+static void simAdd(uint64_t time_us, StimulusKind kind, int32_t arg) {
+	if (stimulus_count == stimulus_cap) {
+		stimulus_cap = stimulus_cap ? stimulus_cap * 2 : 256;
+		stimuli = realloc(stimuli, stimulus_cap * sizeof(*stimuli));
+		if (stimuli == NULL) {
+			fprintf(stderr, "sim: out of memory\n");
+			exit(1);
+		}
+	}
+	stimuli[stimulus_count] = (Stimulus){ time_us, (uint32_t)stimulus_count, kind, arg };
+	++stimulus_count;
+}
+
+static void simAddClap(uint64_t time_us, int32_t edges, uint32_t period_ms) {
+	for (int32_t i = 0; i < edges; ++i) {
+		simAdd(time_us + (uint64_t)i * period_ms * SIM_US_PER_MS, STIM_EDGE, 0);
+	}
+}
+
+static int simCompare(const void *a, const void *b) {
+	const Stimulus *x = a, *y = b;
+
+	if (x->time_us != y->time_us) return x->time_us < y->time_us ? -1 : 1;
+	return x->order < y->order ? -1 : x->order > y->order;
+}
+
+// "1500", "2s", "+30m": false if it isn't a time
+static bool simParseTime(const char *text, uint64_t prev_us, uint64_t *out) {
+	bool relative = *text == '+';
+	char *end;
+	double value = strtod(text + relative, &end);
+	double scale = SIM_US_PER_MS;
+
+	if (end == text + relative || value < 0) return false;
+	if (*end == 's') scale = 1e6;
+	else if (*end == 'm') scale = 60e6;
+	else if (*end == 'h') scale = 3600e6;
+	else if (*end == 'd') scale = 86400e6;
+	else if (*end != '\0') return false;
+	if (*end != '\0' && end[1] != '\0') return false;
+
+	*out = (relative ? prev_us : 0) + (uint64_t)(value * scale);
+	return true;
+}
+
+static void simLoadScript(const char *path) {
+	FILE *f = fopen(path, "r");
+	char line[256];
+	unsigned lineno = 0;
+	uint64_t t = 0;
+
+	if (f == NULL) {
+		perror(path);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char *hash = strchr(line, '#');
+		char time_s[32], cmd[16], arg[16] = "", arg2[16] = "";
+		++lineno;
+
+		if (hash) *hash = '\0';
+		int n = sscanf(line, "%31s %15s %15s %15s", time_s, cmd, arg, arg2);
+		if (n <= 0) continue;
+
+		bool ok = n >= 2 && simParseTime(time_s, t, &t);
+		if (ok && strcmp(cmd, "move") == 0) {
+			simAdd(t, STIM_MOVE, 0);
+		} else if (ok && strcmp(cmd, "turn") == 0 && n >= 3) {
+			simAdd(t, STIM_TURN, atoi(arg));
+		} else if (ok && strcmp(cmd, "press") == 0) {
+			simAdd(t, STIM_PRESS, 0);
+		} else if (ok && strcmp(cmd, "phone") == 0 && n >= 3 && (!strcmp(arg, "in") || !strcmp(arg, "out"))) {
+			simAdd(t, STIM_PHONE, strcmp(arg, "in") == 0);
+		} else if (ok && strcmp(cmd, "lid") == 0 && n >= 3 && (!strcmp(arg, "open") || !strcmp(arg, "closed"))) {
+			simAdd(t, STIM_LID, strcmp(arg, "open") == 0);
+		} else if (ok && strcmp(cmd, "clap") == 0 && n >= 3) {
+			simAddClap(t, atoi(arg), n >= 4 ? (uint32_t)atoi(arg2) : 30);
+		} else if (ok && strcmp(cmd, "load") == 0 && n >= 4 && load_count < SIM_LOADS_MAX &&
+				atoi(arg) > 0 && atoi(arg2) > 0) {
+			loads[load_count].period_ms = atoi(arg);
+			loads[load_count].cost_us = atoi(arg2);
+			simAdd(t, STIM_LOAD, load_count++);
+		} else if (ok && strcmp(cmd, "end") == 0) {
+			simAdd(t, STIM_END, 0);
+		} else {
+			fprintf(stderr, "%s:%u: can't read stimulus\n", path, lineno);
+			exit(1);
+		}
+	}
+
+	fclose(f);
+}
+
+/* Input log replay */
+static void simTrackAdd(SampleTrack *t, uint64_t time_us, Vector3D v) {
+	if (t->count == t->cap) {
+		t->cap = t->cap ? t->cap * 2 : 1024;
+		t->s = realloc(t->s, t->cap * sizeof(*t->s));
+		if (t->s == NULL) {
+			fprintf(stderr, "sim: out of memory\n");
+			exit(1);
+		}
+	}
+	t->s[t->count++] = (Sample){ time_us, v };
+}
+
+static uint32_t simGet16(const uint8_t *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t simGet32(const uint8_t *p) {
+	return simGet16(p) | (simGet16(p + 2) << 16);
+}
+
+// false if the block ran out first
+static bool simGetVarint(const uint8_t **p, const uint8_t *end, uint32_t *out) {
+	uint32_t v = 0;
+
+	for (int shift = 0; *p < end && shift < 35; shift += 7) {
+		uint8_t b = *(*p)++;
+		v |= (uint32_t)(b & 0x7F) << shift;
+		if (!(b & 0x80)) {
+			*out = v;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool simGetDelta(const uint8_t **p, const uint8_t *end, int32_t *out) {
+	uint32_t v;
+
+	if (!simGetVarint(p, end, &v)) return false;
+	*out = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+	return true;
+}
+
+static bool simGetSample(const uint8_t **p, const uint8_t *end, Vector3D *v) {
+	int32_t dx, dy, dz;
+
+	if (!simGetDelta(p, end, &dx) || !simGetDelta(p, end, &dy) || !simGetDelta(p, end, &dz)) return false;
+	v->x_componenet += dx;
+	v->y_componenet += dy;
+	v->z_componenet += dz;
+	return true;
+}
+
+static void simKeyframeSample(const uint8_t *p, Vector3D *v) {
+	v->x_componenet = (int16_t)simGet16(p);
+	v->y_componenet = (int16_t)simGet16(p + 2);
+	v->z_componenet = (int16_t)simGet16(p + 4);
+}
+
+/* simLoadLog()
+ *	turns a dump from inputLogDump into sample tracks and stimuli on the
+ *	simulator's clock, which starts at the oldest block of a log that
+ *	wrapped and at boot otherwise. See INPUT LOG INFO for the layout.
+ */
+static void simLoadLog(const char *path) {
+	FILE *f = fopen(path, "rb");
+	uint8_t *data;
+	long len;
+
+	if (f == NULL) {
+		perror(path);
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	rewind(f);
+	data = malloc(len > 0 ? len : 1);
+	if (data == NULL || fread(data, 1, len, f) != (size_t)len) {
+		fprintf(stderr, "%s: can't read\n", path);
+		exit(1);
+	}
+	fclose(f);
+
+	// debug output may come before the frame
+	const uint8_t *frame = NULL;
+	for (long i = 0; i + 4 <= len && frame == NULL; ++i) {
+		if (memcmp(data + i, "PLIN", 4) == 0) frame = data + i + 4;
+	}
+	if (frame == NULL || data + len - frame < 14) {
+		fprintf(stderr, "%s: no input log frame\n", path);
+		exit(1);
+	}
+
+	uint32_t block = simGet16(frame + 2), sent = simGet16(frame + 4);
+	uint32_t started = simGet32(frame + 6), dump_ms = simGet32(frame + 10);
+	if (frame[0] != INPUT_LOG_VERSION || frame[1] != INPUT_LOG_KEYFRAME || block <= INPUT_LOG_KEYFRAME) {
+		fprintf(stderr, "%s: log is version %u with %u byte keyframes, expected version %u with %u\n", path,
+				frame[0], frame[1], INPUT_LOG_VERSION, INPUT_LOG_KEYFRAME);
+		exit(1);
+	}
+	if (data + len - frame < 14 + (long)sent * block + 2) {
+		fprintf(stderr, "%s: frame cut short, %u blocks announced\n", path, sent);
+		exit(1);
+	}
+
+	uint16_t sum = 0;
+	for (uint32_t i = 0; i < 14 + sent * block; ++i) {
+		sum += frame[i];
+	}
+	if (sum != simGet16(frame + 14 + sent * block)) {
+		fprintf(stderr, "%s: checksum mismatch, the dump was corrupted on the way\n", path);
+		exit(1);
+	}
+
+	const uint8_t *blocks = frame + 14;
+	replay_wrapped = started != sent;
+	uint32_t t0 = replay_wrapped ? simGet32(blocks) : 0;
+	if (replay_wrapped) {
+		replay_start.lock_ms = simGet32(blocks + 4);
+		replay_start.state = blocks[8] < BOX_STATE_COUNT ? blocks[8] : UNLOCKED_EMPTY_ASLEEP;
+		replay_start.flags = blocks[9];
+		replay_start.dial = simGet16(blocks + 10);
+	}
+
+	bool phone = false;
+	uint32_t nfc_ms = t0;  // when the last NFC result came, a change can't be put before it
+	for (uint32_t b = 0; b < sent; ++b) {
+		const uint8_t *p = blocks + b * block, *end = p + block;
+		uint32_t at = simGet32(p);
+		uint16_t dial = simGet16(p + 10);
+		Vector3D acc, mag;
+
+		simKeyframeSample(p + 12, &acc);
+		simKeyframeSample(p + 18, &mag);
+		if (b == 0) {
+			acc_track.held = acc;
+			mag_track.held = mag;
+		}
+
+		for (p += INPUT_LOG_KEYFRAME; p < end && *p != INPUT_NONE;) {
+			InputKind kind = *p >> 5;
+			uint32_t dt = *p++ & 0x1F;
+			int32_t d;
+			bool ok = true;
+
+			if (dt == 0x1F) ok = simGetVarint(&p, end, &dt);
+			at += dt;
+			uint64_t t = (uint64_t)(at - t0) * SIM_US_PER_MS;
+
+			switch (kind) {
+			case INPUT_ACC:
+				if ((ok = ok && simGetSample(&p, end, &acc))) simTrackAdd(&acc_track, t, acc);
+				break;
+			case INPUT_MAG:
+				if ((ok = ok && simGetSample(&p, end, &mag))) simTrackAdd(&mag_track, t, mag);
+				break;
+			case INPUT_PHONE_OUT:
+			case INPUT_PHONE_IN:
+				if ((kind == INPUT_PHONE_IN) != phone) {
+					// a phone is found a ready poll after it shows up, lost only by a poll that times out
+					uint32_t change = at - (phone ? NFC_TIMEOUT_MS : NFC_POLL_MS);
+
+					if ((int32_t)(change - nfc_ms) <= 0) change = nfc_ms + 1;
+					phone = !phone;
+					simAdd((uint64_t)(change - t0) * SIM_US_PER_MS, STIM_PHONE, phone);
+				}
+				nfc_ms = at;
+				break;
+			case INPUT_DIAL:
+				if ((ok = ok && simGetDelta(&p, end, &d))) simAdd(t, STIM_DIAL, dial += d);
+				break;
+			case INPUT_EDGE_AUDIO:
+				simAdd(t, STIM_EDGE, 0);
+				break;
+			case INPUT_EDGE_BUTTON:
+				simAdd(t, STIM_PRESS, 0);
+				break;
+			default:
+				ok = false;
+				break;
+			}
+			if (!ok) {
+				fprintf(stderr, "%s: block %u has a bad record at byte %ld\n", path, b, (long)(p - (end - block)));
+				exit(1);
+			}
+		}
+	}
+
+	simAdd((uint64_t)(dump_ms - t0) * SIM_US_PER_MS, STIM_END, 0);
+	replaying = true;
+	free(data);
+}
+
+/* Generated sessions */
+static uint64_t rng_state;
+
+static uint64_t simRandom(void) {
+	// xorshift64*
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+// uniform in [lo, hi]
+static uint64_t simUniform(uint64_t lo, uint64_t hi) {
+	return lo + simRandom() % (hi - lo + 1);
+}
+
+/* One session: the box sleeps a while, is picked up, a lock time of
+ * 5 to 90 minutes is dialled in, a phone goes in, the lock is armed and
+ * confirmed. While locked there is some noise, and one session in 20
+ * has the lid forced open. Afterwards the phone comes out.
+ */
+static void simGenerate(unsigned sessions, uint64_t seed) {
+	const uint64_t s = 1000000, m = 60 * s;
+	uint64_t t = 0;
+
+	rng_state = seed * 0x9E3779B97F4A7C15ull + 1;
+	for (unsigned i = 0; i < sessions; ++i) {
+		uint64_t lock_min = simUniform(5, 90);
+
+		t += simUniform(5 * m, 240 * m);
+		simAdd(t, STIM_MOVE, 0);
+		simAdd(t += simUniform(2 * s, 4 * s), STIM_TURN, (int32_t)lock_min * 2);
+		simAdd(t += simUniform(2 * s, 10 * s), STIM_PHONE, 1);
+		simAdd(t += simUniform(3 * s, 6 * s), STIM_TURN, 1);
+		simAdd(t += simUniform(1 * s, 3 * s), STIM_PRESS, 0);
+		t += 5 * s;
+
+		uint64_t unlock = t + lock_min * m;
+		for (uint64_t n = t + simUniform(1 * m, 20 * m); n < unlock; n += simUniform(1 * m, 20 * m)) {
+			simAddClap(n, (int32_t)simUniform(1, 6), (uint32_t)simUniform(20, 200));
+		}
+		if (simUniform(1, 20) == 1) {
+			uint64_t open = t + simUniform(1 * m, lock_min * m);
+			simAdd(open, STIM_LID, 1);
+			simAdd(open + simUniform(5 * s, 60 * s), STIM_LID, 0);
+		}
+
+		t = unlock + simUniform(10 * s, 5 * m);
+		simAdd(t, STIM_PHONE, 0);
+	}
+}
+
+/* Report
+ *	Everything the report shows, gathered into one struct so the boxes
+ *	of a --jobs run can send theirs back to be added up.
+ */
+typedef struct {
+	uint64_t sim_us, awake_us, wakeups, loop_passes;
+	uint64_t signals_posted, signals_dropped, exti_lost;
+	uint64_t lock_us, lock_sessions;
+	uint64_t time_ms, ticks;
+	uint64_t state_us[EMERGENCY_OPEN + 1], state_entries[EMERGENCY_OPEN + 1];
+	EventProfile profile[EVENT_LABEL_COUNT];
+	uint64_t runner_max_us;
+} SimStats;
+
+static void simCollect(SimStats *out) {
+	memset(out, 0, sizeof(*out));
+	out->sim_us = now_us;
+	out->awake_us = awake_us;
+	out->wakeups = wakeups;
+	out->loop_passes = loop_passes;
+	out->signals_posted = signals_posted;
+	out->signals_dropped = eventSignalDropped();
+	out->exti_lost = exti_lost;
+	out->lock_us = lock_us;
+	out->lock_sessions = lock_sessions;
+	out->time_ms = time_ms;
+	out->ticks = now_us / tick_us;
+	memcpy(out->state_us, state_us, sizeof(state_us));
+	memcpy(out->state_entries, state_entries, sizeof(state_entries));
+	for (int l = 0; l < EVENT_LABEL_COUNT; ++l) {
+		out->profile[l] = *eventProfileGet(l);
+	}
+	out->runner_max_us = runner_max_us;
+}
+
+static void simMerge(SimStats *into, const SimStats *from) {
+	uint64_t *a = &into->sim_us;
+	const uint64_t *b = &from->sim_us;
+
+	// every field up to the profiles is a plain count
+	for (size_t i = 0; i < offsetof(SimStats, profile) / sizeof(uint64_t); ++i) {
+		a[i] += b[i];
+	}
+	if (from->runner_max_us > into->runner_max_us) into->runner_max_us = from->runner_max_us;
+
+	for (int l = 0; l < EVENT_LABEL_COUNT; ++l) {
+		EventProfile *p = &into->profile[l];
+		const EventProfile *q = &from->profile[l];
+		if (q->runs == 0) continue;
+
+		if (p->runs == 0 || q->min_cycles < p->min_cycles) p->min_cycles = q->min_cycles;
+		if (q->max_cycles > p->max_cycles) p->max_cycles = q->max_cycles;
+		if (q->max_late_ms > p->max_late_ms) p->max_late_ms = q->max_late_ms;
+		p->runs += q->runs;
+		p->total_cycles += q->total_cycles;
+		p->total_late_ms += q->total_late_ms;
+		for (int b = 0; b < EVENT_PROFILE_BUCKETS; ++b) {
+			p->histogram[b] += q->histogram[b];
+		}
+	}
+}
+
+static void simReport(const SimStats *st, unsigned jobs, double wall_s) {
+	char t[32];
+
+	simFormatTime(t, sizeof(t), st->sim_us);
+	printf("\nsimulated %s on %u box%s in %.2f s (%.0fx real time)\n", t, jobs, jobs == 1 ? "" : "es", wall_s,
+			st->sim_us / 1e6 / (wall_s > 0 ? wall_s : 1e-9));
+	printf("main loop passes %llu, wakeups %llu, awake %.3f%%\n", (unsigned long long)st->loop_passes,
+			(unsigned long long)st->wakeups, st->sim_us ? 100.0 * st->awake_us / st->sim_us : 0.0);
+	printf("signals posted %llu, dropped %llu, edges lost at EXTI %llu\n", (unsigned long long)st->signals_posted,
+			(unsigned long long)st->signals_dropped, (unsigned long long)st->exti_lost);
+	simFormatTime(t, sizeof(t), st->lock_us);
+	printf("lock engaged %llu times, %s in total\n", (unsigned long long)st->lock_sessions, t);
+	printf("time_ms %llu against %llu ticks of real time\n", (unsigned long long)st->time_ms,
+			(unsigned long long)st->ticks);
+	printf("longest eventRunner call %.3f ms\n", st->runner_max_us / 1e3);
+
+	printf("\n%-38s %8s %18s %8s\n", "state", "entries", "residency", "");
+	for (int s = 0; s <= EMERGENCY_OPEN; ++s) {
+		simFormatTime(t, sizeof(t), st->state_us[s]);
+		printf("%-38s %8llu %18s %7.3f%%\n", stateToStr(s), (unsigned long long)st->state_entries[s], t,
+				st->sim_us ? 100.0 * st->state_us[s] / st->sim_us : 0.0);
+	}
+
+	printf("\n%-22s %12s %20s %20s\n", "event", "runs", "late ms mean/max", "cost us mean/max");
+	for (int l = EVENT_EMPTY + 1; l < EVENT_LABEL_COUNT; ++l) {
+		const EventProfile *p = &st->profile[l];
+		if (p->runs == 0) continue;
+
+		uint32_t cycles_per_us = SIM_CORE_HZ / 1000000;
+		printf("%-22s %12lu %13.3f/%-6lu %13.1f/%-6lu\n", EventLabelToStr(l), (unsigned long)p->runs,
+				(double)p->total_late_ms / p->runs, (unsigned long)p->max_late_ms,
+				(double)p->total_cycles / p->runs / cycles_per_us, (unsigned long)(p->max_cycles / cycles_per_us));
+	}
+}
+
+// loads the stimuli, runs one box to the end and collects what it saw
+static void simBox(const char *script, const char *replay, unsigned sessions, uint64_t seed, SimStats *out) {
+	if (replay) {
+		simLoadLog(replay);
+	} else if (script) {
+		simLoadScript(script);
+	} else {
+		simGenerate(sessions, seed);
+	}
+	qsort(stimuli, stimulus_count, sizeof(*stimuli), simCompare);
+
+	// without an end the run settles for a while after the last stimulus
+	bool has_end = false;
+	for (size_t i = 0; i < stimulus_count; ++i) {
+		has_end |= stimuli[i].kind == STIM_END;
+	}
+	if (!has_end) {
+		end_us = (stimulus_count ? stimuli[stimulus_count - 1].time_us : 0) + SIM_SETTLE_US;
+	}
+
+	simInit();
+	simRun();
+	simCollect(out);
+	free(stimuli);
+}
+
+/* simJobs()
+ *	splits the sessions over separate boxes, one process each since the
+ *	firmware modules keep their state in globals, and adds up the stats
+ *	they send back. Box j draws from seed + j.
+ */
+static void simJobs(unsigned jobs, unsigned sessions, uint64_t seed, SimStats *total) {
+	int fds[jobs];
+
+	memset(total, 0, sizeof(*total));
+	fflush(stdout);
+	for (unsigned j = 0; j < jobs; ++j) {
+		int pipe_fds[2];
+		unsigned share = sessions / jobs + (j < sessions % jobs);
+
+		if (pipe(pipe_fds) != 0) {
+			perror("sim: pipe");
+			exit(1);
+		}
+
+		pid_t pid = fork();
+		if (pid < 0) {
+			perror("sim: fork");
+			exit(1);
+		}
+		if (pid == 0) {
+			SimStats st;
+			close(pipe_fds[0]);
+			simBox(NULL, NULL, share, seed + j, &st);
+			fflush(stdout);
+			if (write(pipe_fds[1], &st, sizeof(st)) != (ssize_t)sizeof(st)) _exit(1);
+			_exit(0);
+		}
+		close(pipe_fds[1]);
+		fds[j] = pipe_fds[0];
+	}
+
+	for (unsigned j = 0; j < jobs; ++j) {
+		SimStats st;
+		size_t got = 0;
+		ssize_t n;
+
+		while (got < sizeof(st) && (n = read(fds[j], (char *)&st + got, sizeof(st) - got)) > 0) {
+			got += n;
+		}
+		close(fds[j]);
+		if (got != sizeof(st)) {
+			fprintf(stderr, "sim: box %u failed\n", j);
+			exit(1);
+		}
+		simMerge(total, &st);
+	}
+	while (wait(NULL) > 0) {}
+}
+
+static void simUsage(void) {
+	fprintf(stderr, "usage: sim [-v] [--trace file] [--record file] script\n"
+			"       sim [-v] [--trace file] [--record file] --sessions N [--seed S]\n"
+			"       sim [-v] [--trace file] [--record file] --replay log\n"
+			"       sim [-v] --sessions N [--seed S] [--jobs J]\n");
+	exit(2);
+}
+
+// writes what fn sends on LPUART to path, as if its command arrived once the run is over
+static void simDump(const char *path, void (*fn)(void)) {
+	uart_out = fopen(path, "wb");
+	if (uart_out == NULL) {
+		perror(path);
+		exit(1);
+	}
+	fn();
+	fclose(uart_out);
+	uart_out = NULL;
+}
+
+int main(int argc, char **argv) {
+	const char *script = NULL, *replay = NULL, *trace_path = NULL, *record_path = NULL;
+	unsigned sessions = 0, jobs = 1;
+	uint64_t seed = 1;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-v") == 0) {
+			verbose = true;
+		} else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+			sessions = (unsigned)strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+			jobs = (unsigned)strtoul(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			trace_path = argv[++i];
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			record_path = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replay = argv[++i];
+		} else if (argv[i][0] != '-' && script == NULL) {
+			script = argv[i];
+		} else {
+			simUsage();
+		}
+	}
+	if ((script != NULL) + (replay != NULL) + (sessions != 0) != 1 || jobs == 0 || (jobs > 1 && sessions == 0)) simUsage();
+	if (jobs > sessions && sessions) jobs = sessions;
+	if ((trace_path || record_path) && jobs > 1) simUsage();
+
+	struct timespec start, stop;
+	SimStats st;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (jobs > 1) {
+		simJobs(jobs, sessions, seed, &st);
+	} else {
+		simBox(script, replay, sessions, seed, &st);
+	}
+	if (trace_path) simDump(trace_path, traceDump);
+	if (record_path) simDump(record_path, inputLogDump);
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	simReport(&st, jobs, (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9);
+	return 0;
+}
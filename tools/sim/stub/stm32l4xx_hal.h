@@ -0,0 +1,198 @@
+/*
+ * stm32l4xx_hal.h - host stand-in for the STM32L4 HAL
+ *
+ * Just enough of the HAL and CMSIS for the firmware modules the
+ * simulator builds (see sim.c) to compile unchanged on Linux, and for
+ * the ones tools/explore, tools/evbench and tools/screen link, which
+ * define their own calls. Timer registers are plain structs that sim.c
+ * moves along a virtual clock, the calls that would touch hardware land
+ * in sim.c, and DWT->CYCCNT reads the virtual cycle count so
+ * PROFILE_EVENTS measures simulated time.
+ */
+
+#ifndef SIM_STM32L4XX_HAL_H
+#define SIM_STM32L4XX_HAL_H
+
+#include <stdint.h>
+
+typedef enum {
+	HAL_OK,
+	HAL_ERROR,
+	HAL_BUSY,
+	HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+/* Timers */
+typedef struct {
+	volatile uint32_t CR1;
+	volatile uint32_t DIER;
+	volatile uint32_t SR;
+	volatile uint32_t CNT;
+	volatile uint32_t ARR;
+} TIM_TypeDef;
+
+typedef struct {
+	uint32_t Prescaler;
+	uint32_t Period;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+	TIM_TypeDef *Instance;
+	TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+extern TIM_TypeDef sim_tim1, sim_tim2, sim_tim3;
+#define TIM1 (&sim_tim1)
+#define TIM2 (&sim_tim2)
+#define TIM3 (&sim_tim3)
+
+#define TIM_CR1_CEN 0x1u
+#define TIM_CR1_ARPE 0x80u
+#define TIM_DIER_UIE 0x1u
+#define TIM_SR_UIF 0x1u
+#define TIM_FLAG_UPDATE TIM_SR_UIF
+#define TIM_CHANNEL_ALL 0x3Cu
+
+#define __HAL_TIM_GET_FLAG(h, f) (((h)->Instance->SR & (f)) == (f))
+#define __HAL_TIM_CLEAR_FLAG(h, f) ((h)->Instance->SR &= ~(f))
+/* like the HAL, the new period is written back into Init.Period too */
+#define __HAL_TIM_SET_AUTORELOAD(h, v) do { (h)->Instance->ARR = (v); (h)->Init.Period = (v); } while (0)
+#define __HAL_TIM_GET_COUNTER(h) ((h)->Instance->CNT)
+#define __HAL_TIM_SET_COUNTER(h, v) ((h)->Instance->CNT = (v))
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Encoder_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel);
+
+/* GPIO */
+typedef struct {
+	volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef enum {
+	GPIO_PIN_RESET,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+extern GPIO_TypeDef sim_gpiob, sim_gpiod, sim_gpioe;
+#define GPIOB (&sim_gpiob)
+#define GPIOD (&sim_gpiod)
+#define GPIOE (&sim_gpioe)
+
+#define GPIO_PIN_0 ((uint16_t)0x0001)
+#define GPIO_PIN_1 ((uint16_t)0x0002)
+#define GPIO_PIN_2 ((uint16_t)0x0004)
+#define GPIO_PIN_3 ((uint16_t)0x0008)
+#define GPIO_PIN_4 ((uint16_t)0x0010)
+#define GPIO_PIN_5 ((uint16_t)0x0020)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+
+/* I2C1, the transfers accelerometer.c makes; sim.c answers them from
+   its world model or a replayed log */
+typedef struct {
+	uint32_t Instance;
+} I2C_HandleTypeDef;
+
+typedef enum {
+	HAL_I2C_STATE_READY = 0x20,
+	HAL_I2C_STATE_BUSY_RX = 0x22
+} HAL_I2C_StateTypeDef;
+
+#define HAL_I2C_ERROR_NONE 0x0u
+#define I2C_MEMADD_SIZE_8BIT 0x1u
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(const I2C_HandleTypeDef *hi2c);
+uint32_t HAL_I2C_GetError(const I2C_HandleTypeDef *hi2c);
+
+/* LPUART, polled by trace.c; sim.c keeps the receiver empty and
+   HAL_UART_Transmit writes to the --trace or --record file */
+typedef struct {
+	volatile uint32_t ISR;
+	volatile uint32_t RDR;
+} USART_TypeDef;
+
+typedef struct {
+	USART_TypeDef *Instance;
+} UART_HandleTypeDef;
+
+#define UART_FLAG_RXNE 0x20u
+#define __HAL_UART_GET_FLAG(h, f) (((h)->Instance->ISR & (f)) == (f))
+#define __HAL_UART_CLEAR_OREFLAG(h) ((void)(h))
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+
+/* SPI1, the ILI9341 link Screen_Driver.c drives; tools/screen records
+   the bytes and completes the DMA transfers itself */
+typedef struct {
+	uint32_t Instance;
+	volatile uint32_t ErrorCode;
+} SPI_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi);
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi);
+
+/* NVIC and core */
+typedef enum {
+	EXTI0_IRQn = 6,
+	TIM2_IRQn = 28,
+	TIM3_IRQn = 29,
+	EXTI15_10_IRQn = 40
+} IRQn_Type;
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+void HAL_SuspendTick(void);
+void HAL_ResumeTick(void);
+
+void __disable_irq(void);
+void __enable_irq(void);
+void __WFI(void);
+
+static inline void __DMB(void) {
+	__asm__ volatile("" ::: "memory");
+}
+
+/* the host is single threaded apart from sim.c's interrupts, which only
+   fire at service points, so the exclusive store always succeeds */
+static inline uint32_t __LDREXW(volatile uint32_t *addr) {
+	return *addr;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr) {
+	*addr = value;
+	return 0;
+}
+
+/* Cycle counter */
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+DWT_Type *sim_dwt(void);
+extern CoreDebug_Type sim_core_debug;
+#define DWT (sim_dwt())
+#define CoreDebug (&sim_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk 0x1u
+#define CoreDebug_DEMCR_TRCENA_Msk (1u << 24)
+
+extern uint32_t SystemCoreClock;
+
+#endif /* SIM_STM32L4XX_HAL_H */
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+trace_decode.py - render the transition trace a box sends over LPUART
+
+The firmware keeps its last TRACE_RING state transitions in RAM (see
+Core/Src/trace.c) and sends them when it reads TRACE_DUMP_CMD ('T') on
+LPUART. This reads one such dump, from a serial port or from a file
+captured earlier or written by the simulator, and prints the timeline.
+
+    tools/trace/trace_decode.py --port /dev/ttyACM0
+    tools/trace/trace_decode.py dump.bin
+    tools/sim/sim --trace dump.bin tools/sim/lock_session.txt && tools/trace/trace_decode.py dump.bin
+
+State, flag and event names are read from the firmware headers on every
+run, so the decoder follows BOX_STATES, SFlag and EventLabel as they
+change. --port needs pyserial.
+
+Frame, little-endian:
+
+    "PLTR" version:u8 entry_size:u8 sent:u16 recorded:u32 now_ms:u32
+    sent x { time_ms:u32 flags:u32 from:u8 to:u8 label:u8 cause:u8 }
+    sum:u16     sum of every byte after the magic
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+CORE_INC = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'PhoneLockBox', 'Core', 'Inc')
+
+MAGIC = b'PLTR'
+VERSION = 1
+HEADER = struct.Struct('<BBHII')
+ENTRY = struct.Struct('<IIBBBB')
+CAUSE_MASTER_TIMER = 1
+
+
+def read_header(name):
+    with open(os.path.join(CORE_INC, name)) as f:
+        return f.read()
+
+
+def enum_names(text, typename, prefix):
+    """Identifiers of a typedef'd enum, in order, prefix dropped."""
+    m = re.search(r'typedef enum\s*\{([^{}]*)\}\s*' + typename + r'\s*;', text)
+    if not m:
+        sys.exit(f'trace_decode: no enum {typename} in the headers')
+    body = re.sub(r'//[^\n]*|/\*.*?\*/', '', m.group(1), flags=re.S)
+    names = [n.split('=')[0].strip() for n in body.split(',')]
+    return [n[len(prefix):] if n.startswith(prefix) else n for n in names if n]
+
+
+def load_names():
+    states = re.findall(r'X\((\w+),\s*"([^"]*)"\)', read_header('shared.h'))
+    if not states:
+        sys.exit('trace_decode: no BOX_STATES list in shared.h')
+    flags = enum_names(read_header('state_machine.h'), 'SFlag', 'SFLAG_')
+    labels = enum_names(read_header('event_controller.h'), 'EventLabel', '')
+    return [name for _, name in states], flags, labels
+
+
+def read_port(port, baud, timeout):
+    try:
+        import serial
+    except ImportError:
+        sys.exit('trace_decode: --port needs pyserial (pip install pyserial)')
+
+    with serial.Serial(port, baud, timeout=timeout) as s:
+        s.reset_input_buffer()
+        s.write(b'T')
+        data = bytearray()
+        # debug printf output may come first, the frame starts at the magic
+        while True:
+            chunk = s.read(4096)
+            if not chunk:
+                break
+            data += chunk
+            at = data.find(MAGIC)
+            if at >= 0 and len(data) >= at + 4 + HEADER.size:
+                _, size, sent, _, _ = HEADER.unpack_from(data, at + 4)
+                if len(data) >= at + 4 + HEADER.size + sent * size + 2:
+                    break
+        return bytes(data)
+
+
+def parse(data):
+    at = data.find(MAGIC)
+    if at < 0:
+        sys.exit('trace_decode: no trace frame in the input')
+    body = data[at + 4:]
+    if len(body) < HEADER.size:
+        sys.exit('trace_decode: frame cut short in the header')
+
+    version, size, sent, recorded, now_ms = HEADER.unpack_from(body)
+    if version != VERSION or size != ENTRY.size:
+        sys.exit(f'trace_decode: frame is version {version} with {size} byte entries, '
+                 f'expected version {VERSION} with {ENTRY.size}')
+
+    end = HEADER.size + sent * size
+    if len(body) < end + 2:
+        sys.exit(f'trace_decode: frame cut short, {sent} entries announced')
+    (sum_sent,) = struct.unpack_from('<H', body, end)
+    if sum(body[:end]) & 0xFFFF != sum_sent:
+        sys.exit('trace_decode: checksum mismatch, the dump was corrupted on the way')
+
+    entries = [ENTRY.unpack_from(body, HEADER.size + i * size) for i in range(sent)]
+    return recorded, now_ms, entries
+
+
+def fmt_ms(ms):
+    s, ms = divmod(ms, 1000)
+    m, s = divmod(s, 60)
+    h, m = divmod(m, 60)
+    d, h = divmod(h, 24)
+    return f'{d}d {h:02}:{m:02}:{s:02}.{ms:03}'
+
+
+def name(table, i):
+    return table[i] if i < len(table) else f'#{i}'
+
+
+def flag_list(flags, mask):
+    return '|'.join(name(flags, b) for b in range(32) if mask >> b & 1) or '-'
+
+
+def render(recorded, now_ms, entries, states, flags, labels, out):
+    lost = recorded - len(entries)
+    out.write(f'{len(entries)} transitions, {lost} older ones overwritten, box time {fmt_ms(now_ms)}\n\n')
+    out.write(f'{"time":>16}  {"held ms":>9}  {"from":<36}    {"to":<36}  cause\n')
+
+    prev_ms = None
+    for time_ms, mask, frm, to, label, cause in entries:
+        held = f'{(time_ms - prev_ms) & 0xFFFFFFFF:9}' if prev_ms is not None else f'{"":9}'
+        if cause == CAUSE_MASTER_TIMER:
+            why = 'master timer done'
+        else:
+            source = name(labels, label) if label else 'interrupt'
+            why = f'{flag_list(flags, mask)} from {source}'
+        out.write(f'{fmt_ms(time_ms):>16}  {held}  {name(states, frm):<36} -> {name(states, to):<36}  {why}\n')
+        prev_ms = time_ms
+
+    if entries:
+        out.write(f'{fmt_ms(now_ms):>16}  {(now_ms - prev_ms) & 0xFFFFFFFF:9}  {name(states, entries[-1][3])} (now)\n')
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Render the transition trace a box sends over LPUART.')
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument('dump', nargs='?', help='captured dump file, - for stdin')
+    src.add_argument('--port', help='serial port to request a dump from')
+    ap.add_argument('--baud', type=int, default=115200)
+    ap.add_argument('--timeout', type=float, default=1.0, help='seconds of silence that end a --port read')
+    ap.add_argument('--save', help='also write the raw dump here')
+    args = ap.parse_args()
+
+    if args.port:
+        data = read_port(args.port, args.baud, args.timeout)
+    elif args.dump == '-':
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.dump, 'rb') as f:
+            data = f.read()
+
+    if args.save:
+        with open(args.save, 'wb') as f:
+            f.write(data)
+
+    states, flags, labels = load_names()
+    render(*parse(data), states, flags, labels, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()